@@ -0,0 +1,103 @@
+#version 450
+
+// One workgroup per 16x16 tile of MainCompute.glsl.
+layout(local_size_x = 256) in;
+
+layout(std140, binding = 1) uniform uSimulationConfig
+{
+    vec2 size;              // [m]
+    vec2 stability;         // [1]
+    float windSpeed;        // [m/s]
+    float windDir;          // [rad]
+    float depositionCoeff;  // [1/s]
+
+    ivec2 resolution;       // [1]
+    int emittersCount;
+    float cullingThreshold; // [g/m^3]
+};
+
+// Per-emitter invariants, see MainCompute.glsl.
+layout(std430, binding = 2) readonly buffer uEmitters
+{
+    vec4 emitters[];
+};
+
+// Number of emitters that reach each tile. A count above uBinCapacity means the bin overflowed and the
+// tile has to iterate over all emitters.
+layout(std430, binding = 3) writeonly buffer uEmitterBinCounts
+{
+    uint binCounts[];
+};
+
+layout(std430, binding = 4) writeonly buffer uEmitterBins
+{
+    uint bins[];
+};
+
+layout(location = 0) uniform uint uBinCapacity;
+
+// First row of tiles covered by the dispatch, see MainCompute.glsl.
+layout(location = 1) uniform int uTileRowOffset;
+
+shared uint sBinCount;
+
+vec2 cellPosition(ivec2 gid)
+{
+    return vec2(
+        mix(1.0, size.x, float(gid.x) / float(resolution.x - 1)),
+        mix(-size.y, size.y, float(gid.y) / float(resolution.y - 1)));
+}
+
+// Upper bound of the emitter's contribution to any cell in [lo, hi], see GetMaxEmitterContribution() in
+// src/CPU/TileBinning.cpp. Negative when the whole tile is upwind.
+float maxContribution(vec4 e, vec2 lo, vec2 hi)
+{
+    float c = cos(windDir);
+    float s = sin(windDir);
+
+    vec2 downwindX = vec2(lo.x, hi.x) * c;
+    vec2 downwindY = vec2(lo.y, hi.y) * s;
+    float downwindMax = max(downwindX.x, downwindX.y) + max(downwindY.x, downwindY.y) - e.x;
+    float downwindMin = min(downwindX.x, downwindX.y) + min(downwindY.x, downwindY.y) - e.x;
+    if (downwindMax <= 0.0)
+        return -1.0;
+
+    float lateralMin = lo.y <= 0.0 && hi.y >= 0.0 ? 0.0 : min(lo.y * lo.y, hi.y * hi.y);
+    float a = lateralMin / (2.0 * stability.x * stability.x) + e.z;
+    if (a <= 0.0 && downwindMin <= 0.0)
+        return 3.402823466e38;
+
+    float qMin = 1.0 / (downwindMax * downwindMax);
+    float qMax = downwindMin > 0.0 ? 1.0 / (downwindMin * downwindMin) : 3.402823466e38;
+    float q = a > 0.0 ? clamp(1.0 / a, qMin, qMax) : qMax;
+
+    return abs(e.y) * q * exp(-a * q - depositionCoeff * lo.x / windSpeed);
+}
+
+void main()
+{
+    uvec2 tile = uvec2(gl_WorkGroupID.x, gl_WorkGroupID.y + uint(uTileRowOffset));
+    uint tileIdx = tile.y * gl_NumWorkGroups.x + tile.x;
+    ivec2 first = ivec2(tile) * 16;
+    vec2 lo = cellPosition(first);
+    vec2 hi = cellPosition(min(first + 15, resolution - 1));
+
+    if (gl_LocalInvocationIndex == 0)
+        sBinCount = 0;
+    barrier();
+
+    for (uint i = gl_LocalInvocationIndex; i < uint(emittersCount); i += gl_WorkGroupSize.x)
+    {
+        float bound = maxContribution(emitters[i], lo, hi);
+        if (bound < 0.0 || bound < cullingThreshold)
+            continue;
+
+        uint slot = atomicAdd(sBinCount, 1u);
+        if (slot < uBinCapacity)
+            bins[tileIdx * uBinCapacity + slot] = i;
+    }
+
+    barrier();
+    if (gl_LocalInvocationIndex == 0)
+        binCounts[tileIdx] = sBinCount;
+}
@@ -0,0 +1,83 @@
+#version 450
+
+// Each invocation evaluates one receptor; the workgroup stages emitters in chunks of one per invocation.
+#define RECEPTORS_PER_GROUP 256
+
+layout(local_size_x = RECEPTORS_PER_GROUP) in;
+
+// Invariants of the current chunk of emitters, see uEmitters.
+shared vec3 sEmitters[RECEPTORS_PER_GROUP];
+
+layout(std140, binding = 1) uniform uSimulationConfig
+{
+    vec2 size;              // [m]
+    vec2 stability;         // [1]
+    float windSpeed;        // [m/s]
+    float windDir;          // [rad]
+    float depositionCoeff;  // [1/s]
+
+    ivec2 resolution;       // [1]
+    int emittersCount;
+    float cullingThreshold; // [g/m^3]
+};
+
+// Per-emitter invariants, see MainCompute.glsl.
+layout(std430, binding = 2) readonly buffer uEmitters
+{
+    vec4 emitters[];
+};
+
+// Receptor positions [m] in the grid frame.
+layout(std430, binding = 5) readonly buffer uReceptors
+{
+    vec2 receptors[];
+};
+
+layout(std430, binding = 6) writeonly buffer uReceptorConcentrations
+{
+    float concentrations[];
+};
+
+layout(location = 0) uniform uint uReceptorsCount;
+
+// First receptor covered by the dispatch, for receptor counts above the workgroup count limit.
+layout(location = 1) uniform uint uReceptorOffset;
+
+void main()
+{
+    // Invocations past the last receptor still take part in staging, so they must not return before the loop.
+    uint receptorIdx = uReceptorOffset + gl_GlobalInvocationID.x;
+    bool isValid = receptorIdx < uReceptorsCount;
+    vec2 pos = isValid ? receptors[receptorIdx] : vec2(0.0);
+
+    float windX = pos.x * cos(windDir) + pos.y * sin(windDir);
+    // As in MainCompute.glsl, the lateral offset is measured from the grid centreline.
+    float lateral = (pos.y * pos.y) / (2.0 * stability.x * stability.x);
+    float concentration = 0.0;
+
+    for (uint chunk = 0; chunk < uint(emittersCount); chunk += RECEPTORS_PER_GROUP)
+    {
+        uint j = chunk + gl_LocalInvocationIndex;
+        if (j < uint(emittersCount))
+            sEmitters[gl_LocalInvocationIndex] = emitters[j].xyz;
+        barrier();
+
+        uint chunkSize = min(uint(RECEPTORS_PER_GROUP), uint(emittersCount) - chunk);
+        for (uint i = 0; i < chunkSize; i++)
+        {
+            vec3 e = sEmitters[i];
+            float downwind = windX - e.x;
+            if (downwind <= 0.0)
+                continue;
+
+            float invDownwindSq = 1.0 / (downwind * downwind);
+            concentration += e.y * invDownwindSq * exp(-(lateral + e.z) * invDownwindSq);
+        }
+        barrier();
+    }
+
+    if (!isValid)
+        return;
+
+    concentrations[receptorIdx] = concentration * exp(-depositionCoeff * pos.x / windSpeed);
+}
@@ -1,13 +1,33 @@
 #version 450
 
-struct EmitterInfo
-{
-    vec2 position;
-    float emissionRate;
-    float height;
-};
+// Specializations selected by SimulationController when the config allows them:
+//   WIND_ALIGNED     the wind blows along +x (windDir == 0), so no rotation is needed
+//   NO_DEPOSITION    depositionCoeff == 0, so the deposition factor is always 1
+//   STABILITY        one of the fixed stability classes as a vec2 constant, replacing the uniform
+//   DIRECT_EMITTER_LOADS  every invocation reads each emitter from the SSBO itself instead of the staged loop
+//   EXP_DEGREE       fast variant of the kernel evaluating exp like the CPU one, see c_FastKernelVariants; requires
+//                    EXP2_COEFFICIENTS, the float array of PlumeKernel::GetExp2Coefficients(EXP_DEGREE)
+//   OUTPUT_IMAGE_FORMAT   image format of the output texture, r32f when not set
+//   OUTPUT_LOG_UNORM16    the output is an r16 image holding log-encoded values, see ConcentrationFormat.hpp;
+//                         requires LOG_UNORM16_MIN and LOG_UNORM16_MAX
+
+// Each workgroup covers a 16x16 tile of the output, matching the bins of BinEmitters.glsl.
+#define TILE_SIZE 16
+
+#ifdef DIRECT_EMITTER_LOADS
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+#else
+// Each invocation computes this many cells of its tile column, TILE_SIZE / CELLS_PER_INVOCATION rows apart.
+#define CELLS_PER_INVOCATION 2
+#define TILE_ROWS_PER_PASS (TILE_SIZE / CELLS_PER_INVOCATION)
+// Emitters are staged in chunks of one per invocation.
+#define EMITTER_CHUNK_SIZE (TILE_SIZE * TILE_ROWS_PER_PASS)
 
-layout(local_size_x = 16, local_size_y = 16) in;
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_ROWS_PER_PASS) in;
+
+// Invariants of the current chunk of emitters, see uEmitters.
+shared vec3 sEmitters[EMITTER_CHUNK_SIZE];
+#endif
 
 layout(std140, binding = 1) uniform uSimulationConfig
 {
@@ -19,45 +39,147 @@ layout(std140, binding = 1) uniform uSimulationConfig
 
     ivec2 resolution;       // [1]
     int emittersCount;
+    float cullingThreshold; // [g/m^3]
 };
 
+// Per-emitter invariants prepared by EmitterStore: downwind position in the wind frame,
+// Q / (2 * pi * u * sigmaY * sigmaZ) and H^2 / (2 * sigmaZ^2). w is unused.
 layout(std430, binding = 2) readonly buffer uEmitters
 {
-    EmitterInfo emitters[];
+    vec4 emitters[];
 };
 
-layout(r32f, binding = 1) uniform image2D uConcentrationImage;
+layout(std430, binding = 3) readonly buffer uEmitterBinCounts
+{
+    uint binCounts[];
+};
 
-vec2 rotateToWindFrame(vec2 delta)
+layout(std430, binding = 4) readonly buffer uEmitterBins
 {
-    float c = cos(windDir);
-    float s = sin(windDir);
+    uint bins[];
+};
 
-    return vec2(
-        delta.x * c + delta.y * s,
-        -s * delta.x + delta.y * c);
+#ifndef OUTPUT_IMAGE_FORMAT
+#define OUTPUT_IMAGE_FORMAT r32f
+#endif
+
+layout(OUTPUT_IMAGE_FORMAT, binding = 1) uniform image2D uConcentrationImage;
+
+// When set, the emitters are added on top of the existing image instead of replacing it. Emitters with a
+// negative emission rate then remove a previously added contribution.
+layout(location = 0) uniform bool uAccumulate;
+
+// Capacity of each tile's bin written by BinEmitters.glsl, or 0 when the binning pass did not run.
+layout(location = 1) uniform uint uBinCapacity;
+
+// First row of tiles covered by the dispatch, for grids computed in several slices.
+layout(location = 2) uniform int uTileRowOffset;
+
+#ifdef EXP_DEGREE
+// Exponent below which an emitter is skipped, derived from the accuracy budget by PlumeKernel::GetExpCutoff().
+layout(location = 3) uniform float uExpCutoff;
+#endif
+
+#ifdef OUTPUT_LOG_UNORM16
+// Must match EncodeLogUNorm16() and DecodeLogUNorm16() in ConcentrationFormat.cpp.
+const float kLogUNorm16Step = (log(LOG_UNORM16_MAX) - log(LOG_UNORM16_MIN)) / 65534.0;
+
+float encodeConcentration(float c)
+{
+    if (!(c >= LOG_UNORM16_MIN))
+        return 0.0;
+
+    float code = 1.0 + round(min((log(c) - log(LOG_UNORM16_MIN)) / kLogUNorm16Step, 65534.0));
+    return code / 65535.0;
+}
+
+float decodeConcentration(float value)
+{
+    float code = round(value * 65535.0);
+    return code == 0.0 ? 0.0 : exp(log(LOG_UNORM16_MIN) + (code - 1.0) * kLogUNorm16Step);
+}
+#else
+float encodeConcentration(float c)
+{
+    return c;
 }
 
-float gaussianConcentration(EmitterInfo e, vec2 pos)
+float decodeConcentration(float value)
 {
-    vec2 posRel = rotateToWindFrame(pos - e.position);
+    return value;
+}
+#endif
+
+#ifdef STABILITY
+const vec2 kStability = STABILITY;
+#else
+#define kStability stability
+#endif
+
+#ifdef EXP_DEGREE
+const float kExp2Coefficients[EXP_DEGREE + 1] = EXP2_COEFFICIENTS;
+// See c_Log2E of the CPU kernel.
+const float kLog2E = 1.44269504;
+
+// FastExp2() of the CPU kernel: 2^round(t) times the minimax polynomial of the remainder in [-1/2, 1/2].
+float fastExp2(float t)
+{
+    float n = roundEven(t);
+    float f = t - n;
+
+    float p = kExp2Coefficients[EXP_DEGREE];
+    for (int i = EXP_DEGREE - 1; i >= 0; i--)
+        p = fma(p, f, kExp2Coefficients[i]);
+
+    return ldexp(p, int(n));
+}
+#endif
 
-    if (posRel.x <= 0.0)
+// Position of a cell along the wind axis. The rotation is linear, so the downwind distance to an emitter is the
+// difference of the two positions.
+float windFrameX(vec2 pos)
+{
+#ifdef WIND_ALIGNED
+    return pos.x;
+#else
+    return pos.x * cos(windDir) + pos.y * sin(windDir);
+#endif
+}
+
+// Plume of emitter `e` (see uEmitters) at a cell with the given position along the wind axis and lateral
+// exponent (y^2 / (2 * sigmaY^2), measured from the grid centreline), without the deposition factor. expoY and
+// expoZ of the Gaussian plume are folded into a single exp.
+float gaussianConcentration(vec3 e, float windX, float lateral)
+{
+    float downwind = windX - e.x;
+    if (downwind <= 0.0)
         return 0.0;
 
-    vec2 stabilityRel = stability * posRel.x;
-    float effectiveHeight = e.height;
-    float expoY = exp(-(pos.y * pos.y) / (2.0 * stabilityRel.x * stabilityRel.x));
-    float expoZ = exp(-(effectiveHeight * effectiveHeight) / (2.0 * stabilityRel.y * stabilityRel.y));
-    float base = e.emissionRate / (2.0 * 3.14159265359 * windSpeed * stabilityRel.x * stabilityRel.y);
-    float dep = exp(-depositionCoeff * pos.x / windSpeed);
+    float invDownwindSq = 1.0 / (downwind * downwind);
+#ifdef EXP_DEGREE
+    float exponent = -(lateral + e.z) * invDownwindSq;
+    if (exponent < uExpCutoff)
+        return 0.0;
+
+    return e.y * invDownwindSq * fastExp2(exponent * kLog2E);
+#else
+    return e.y * invDownwindSq * exp(-(lateral + e.z) * invDownwindSq);
+#endif
+}
 
-    return base * expoY * expoZ * dep;
+float depositionFactor(float x)
+{
+#ifdef NO_DEPOSITION
+    return 1.0;
+#else
+    return exp(-depositionCoeff * x / windSpeed);
+#endif
 }
 
+#ifdef DIRECT_EMITTER_LOADS
 void main()
 {
-    ivec2 gid = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 gid = ivec2(gl_GlobalInvocationID.xy) + ivec2(0, uTileRowOffset * TILE_SIZE);
 
     if (gid.x >= resolution.x || gid.y >= resolution.y)
         return;
@@ -65,11 +187,85 @@ void main()
     float x = mix(1.0, size.x, float(gid.x) / float(resolution.x - 1));
     float y = mix(-size.y, size.y, float(gid.y) / float(resolution.y - 1));
 
+    float windX = windFrameX(vec2(x, y));
+    float lateral = (y * y) / (2.0 * kStability.x * kStability.x);
+
     float concentration = 0.0;
-    for (int i = 0; i < emittersCount; i++)
+    uint tileIdx = (gl_WorkGroupID.y + uint(uTileRowOffset)) * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    uint binCount = uBinCapacity != 0 ? binCounts[tileIdx] : uint(emittersCount) + 1;
+    if (binCount <= uBinCapacity)
+    {
+        for (uint i = 0; i < binCount; i++)
+            concentration += gaussianConcentration(emitters[bins[tileIdx * uBinCapacity + i]].xyz, windX, lateral);
+    }
+    else
+    {
+        for (int i = 0; i < emittersCount; i++)
+        {
+            concentration += gaussianConcentration(emitters[i].xyz, windX, lateral);
+        }
+    }
+    concentration *= depositionFactor(x);
+
+    if (uAccumulate)
+        concentration += decodeConcentration(imageLoad(uConcentrationImage, gid).r);
+
+    imageStore(uConcentrationImage, gid, vec4(encodeConcentration(concentration), 0.0, 0.0, 1.0));
+}
+#else
+void main()
+{
+    // Invocations outside the grid still take part in staging, so they must not return before the loop.
+    ivec2 gid[CELLS_PER_INVOCATION];
+    float windX[CELLS_PER_INVOCATION];
+    float lateral[CELLS_PER_INVOCATION];
+    float concentration[CELLS_PER_INVOCATION];
+    for (int c = 0; c < CELLS_PER_INVOCATION; c++)
     {
-        concentration += gaussianConcentration(emitters[i], vec2(x, y));
+        gid[c] = ivec2(
+            gl_GlobalInvocationID.x,
+            (int(gl_WorkGroupID.y) + uTileRowOffset) * TILE_SIZE + int(gl_LocalInvocationID.y) + c * TILE_ROWS_PER_PASS);
+
+        float x = mix(1.0, size.x, float(gid[c].x) / float(resolution.x - 1));
+        float y = mix(-size.y, size.y, float(gid[c].y) / float(resolution.y - 1));
+
+        windX[c] = windFrameX(vec2(x, y));
+        lateral[c] = (y * y) / (2.0 * kStability.x * kStability.x);
+        concentration[c] = 0.0;
     }
 
-    imageStore(uConcentrationImage, gid, vec4(concentration, 0.0, 0.0, 1.0));
-}
\ No newline at end of file
+    uint tileIdx = (gl_WorkGroupID.y + uint(uTileRowOffset)) * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    uint binCount = uBinCapacity != 0 ? binCounts[tileIdx] : uint(emittersCount) + 1;
+    bool useBins = binCount <= uBinCapacity;
+    uint count = useBins ? binCount : uint(emittersCount);
+
+    for (uint chunk = 0; chunk < count; chunk += EMITTER_CHUNK_SIZE)
+    {
+        uint j = chunk + gl_LocalInvocationIndex;
+        if (j < count)
+            sEmitters[gl_LocalInvocationIndex] = emitters[useBins ? bins[tileIdx * uBinCapacity + j] : j].xyz;
+        barrier();
+
+        uint chunkSize = min(uint(EMITTER_CHUNK_SIZE), count - chunk);
+        for (uint i = 0; i < chunkSize; i++)
+        {
+            vec3 e = sEmitters[i];
+            for (int c = 0; c < CELLS_PER_INVOCATION; c++)
+                concentration[c] += gaussianConcentration(e, windX[c], lateral[c]);
+        }
+        barrier();
+    }
+
+    for (int c = 0; c < CELLS_PER_INVOCATION; c++)
+    {
+        if (gid[c].x >= resolution.x || gid[c].y >= resolution.y)
+            continue;
+
+        concentration[c] *= depositionFactor(mix(1.0, size.x, float(gid[c].x) / float(resolution.x - 1)));
+        if (uAccumulate)
+            concentration[c] += decodeConcentration(imageLoad(uConcentrationImage, gid[c]).r);
+
+        imageStore(uConcentrationImage, gid[c], vec4(encodeConcentration(concentration[c]), 0.0, 0.0, 1.0));
+    }
+}
+#endif
@@ -1,4 +1,7 @@
 #include "Application.hpp"
+#include "SimulationIO.hpp"
+#include "GridFile.hpp"
+#include "KernelBenchmark.hpp"
 #include <iostream>
 #include <array>
 #include <format>
@@ -19,6 +22,40 @@ constexpr std::array<std::pair<const char*, glm::vec2>, 6> c_AtmosphericStabilit
     std::make_pair("Moderately stable (F)", AtmosphericStabilityF),
 };
 
+constexpr std::array<std::pair<const char*, ConcentrationFormat>, 3> c_ConcentrationFormats {
+    std::make_pair("32-bit float", ConcentrationFormat::Float32),
+    std::make_pair("16-bit float", ConcentrationFormat::Float16),
+    std::make_pair("16-bit log", ConcentrationFormat::LogUNorm16),
+};
+
+constexpr int c_IdleFramesBeforeWait = 3;
+constexpr glm::ivec2 c_KernelBenchmarkResolution {512, 512};
+constexpr std::array<size_t, 4> c_KernelBenchmarkEmitterCounts {256, 1024, 4096, 16384};
+constexpr size_t c_KernelBenchmarkIterations = 5;
+
+// How often shader sources are checked for changes while hot reload is enabled [s].
+constexpr double c_ShaderWatchInterval = 0.5;
+// How often the loop wakes up while an interaction holds back a pending refinement [s].
+constexpr double c_RefinementWaitInterval = 0.1;
+
+// Per-axis resolution divisors offered for recalculations made while dragging a control.
+constexpr std::array<std::pair<const char*, int>, 3> c_InteractiveLODScales {
+    std::make_pair("Full", 1),
+    std::make_pair("1/4", 2),
+    std::make_pair("1/16", 4),
+};
+
+constexpr std::array<std::pair<const char*, SimulationBackend>, 2> c_SimulationBackends {
+    std::make_pair("GPU (compute shader)", SimulationBackend::GPU),
+    std::make_pair("CPU (multithreaded)", SimulationBackend::CPU),
+};
+
+constexpr std::array<std::pair<const char*, double SimulationTiming::*>, 3> c_ProfiledTimes {
+    std::make_pair("Dispatch (GPU)", &SimulationTiming::DispatchTime),
+    std::make_pair("Upload (GPU)", &SimulationTiming::UploadTime),
+    std::make_pair("Calculate (CPU)", &SimulationTiming::CPUTime),
+};
+
 static void InitializeOpenGL()
 {
     if (!gladLoadGL(glfwGetProcAddress))
@@ -34,40 +71,6 @@ static void InitializeOpenGL()
         nullptr);
 }
 
-static std::pair<SimulationConfig, std::vector<EmitterInfo>> LoadSimulationConfigFromFile(const std::string_view filepath)
-{
-    std::ifstream file(filepath.data());
-    if (!file.is_open())
-        throw std::runtime_error("Failed to open simulation config file.");
-
-    const auto data = nlohmann::json::parse(file);
-    const auto& emittersData = data.at("emitters");
-
-    std::vector<EmitterInfo> emitters;
-    emitters.reserve(emittersData.size());
-
-    for (const auto& x : emittersData)
-        emitters.emplace_back(EmitterInfo::FromJSON(x));
-
-    return std::make_pair(SimulationConfig::FromJSON(data), emitters);
-}
-
-static void SaveSimulationConfigToFile(const std::string_view filepath, const SimulationConfig &config, const std::vector<EmitterInfo> &emitters)
-{
-    std::ofstream file(filepath.data());
-    if (!file.is_open())
-        throw std::runtime_error("Failed to open simulation config save file.");
-
-    auto jsonConfig = config.ToJSON();
-    auto emittersData = nlohmann::json::array();
-
-    for (const auto& x : emitters)
-        emittersData.push_back(x.ToJSON());
-
-    jsonConfig["emitters"] = std::move(emittersData);
-    jsonConfig >> file;
-}
-
 Application::Application()
 {
     window_ = Window(1080, 720, "Emissions simulator", true);
@@ -79,17 +82,56 @@ Application::Application()
     simController_ = SimulationController({1000.0f, 500.0f}, {512, 512});
     gridResolutionNew_ = simController_.GetConfig().Resolution;
     gridSizeNew_ = simController_.GetConfig().Size;
+    cpuThreadCount_ = (int)simController_.GetCPUThreadCount();
+    accuracyBudget_ = simController_.GetAccuracyBudget();
 }
 
 void Application::Run()
 {
     while (!window_.ShouldClose())
     {
+        // Nothing on screen can change until the next input event once the simulation is up to date
+        // and ImGui had a few frames to settle, so block instead of redrawing the same frame.
+        if (!simController_.IsDirty()
+            && !simController_.CanRefine()
+            && !simController_.HasPendingTimings()
+            && !simController_.HasPendingReadbacks()
+            && !IsFileTaskActive()
+            && idleFrames_ >= c_IdleFramesBeforeWait)
+        {
+            // Shader edits do not generate input events, so wake up periodically to look for them. A refinement
+            // held back by an interaction resumes once a frame notices that the interaction ended.
+            if (simController_.IsRefining())
+                window_.WaitEvents(c_RefinementWaitInterval);
+            else if (watchShaders_)
+                window_.WaitEvents(c_ShaderWatchInterval);
+            else
+                window_.WaitEvents();
+            idleFrames_ = 0;
+        }
+        else
+            window_.PollEvents();
+
         const auto start = window_.GetTime();
 
-        window_.PollEvents();
+        if (watchShaders_ && start - lastShaderCheckTime_ >= c_ShaderWatchInterval)
+        {
+            simController_.ReloadShadersIfChanged();
+            lastShaderCheckTime_ = start;
+        }
 
-        simController_.Calculate();
+        if (simController_.Calculate())
+            idleFrames_ = 0;
+        else
+            idleFrames_++;
+
+        SimulationTiming timing;
+        while (simController_.PollTiming(timing))
+            profiler_.Push(timing);
+
+        SimulationReadback readback;
+        while (simController_.PollReadback(readback))
+            SaveGridExport(readback);
 
         RenderUI();
 
@@ -101,6 +143,7 @@ void Application::Run()
 
 void Application::RenderUI()
 {
+    CollectFileTasks();
     imguiContext_.NewFrame();
 
     glClearColor(0.0, 0.0, 0.0, 1.0);
@@ -110,7 +153,7 @@ void Application::RenderUI()
     {
         if (ImGui::BeginMenu("File"))
         {
-            if (ImGui::MenuItem("Open Config...", "Ctrl+O"))
+            if (ImGui::MenuItem("Open Config...", "Ctrl+O", false, !IsFileTaskActive()))
             {
                 const IGFD::FileDialogConfig config {
                     .path = ".",
@@ -120,7 +163,7 @@ void Application::RenderUI()
                 fileOpenDialog_.OpenDialog("ChooseFileDlgKey", "Choose simulation config file...", ".json", config);
                 openFileDialogAction_ = OpenFileDialogAction::Open;
             }
-            if (ImGui::MenuItem("Save Config...", "Ctrl+S"))
+            if (ImGui::MenuItem("Save Config...", "Ctrl+S", false, !IsFileTaskActive()))
             {
                 const IGFD::FileDialogConfig config {
                     .path = ".",
@@ -130,6 +173,16 @@ void Application::RenderUI()
                 fileOpenDialog_.OpenDialog("ChooseFileDlgKey", "Choose simulation config save file...", ".json", config);
                 openFileDialogAction_ = OpenFileDialogAction::Save;
             }
+            if (ImGui::MenuItem("Export Grid..."))
+            {
+                const IGFD::FileDialogConfig config {
+                    .path = ".",
+                    .countSelectionMax = 1,
+                    .flags = ImGuiFileDialogFlags_Modal | ImGuiFileDialogFlags_ConfirmOverwrite,
+                };
+                fileOpenDialog_.OpenDialog("ChooseFileDlgKey", "Choose grid export file...", ".grid", config);
+                openFileDialogAction_ = OpenFileDialogAction::ExportGrid;
+            }
             ImGui::Separator();
             if (ImGui::MenuItem("Close", "Alt+F4"))
                 window_.Close();
@@ -144,12 +197,145 @@ void Application::RenderUI()
     ImGui::Begin("Frame info");
     ImGui::Text("Frametime: %.5lf", frametime_);
     ImGui::Text("FPS: %.2lf", 1.0 / frametime_);
+
+    ImGui::SeparatorText("Simulation");
+    const auto &timings = profiler_.GetHistory();
+    if (!timings.empty())
+    {
+        const auto &lastTiming = timings.back();
+        ImGui::Text("Last: %dx%d, %zu emitters%s",
+            lastTiming.Resolution.x, lastTiming.Resolution.y, lastTiming.EmittersCount,
+            lastTiming.IsIncremental ? " (incremental)" : lastTiming.RowCount < lastTiming.Resolution.y ? " (refinement slice)" : "");
+        ImGui::PlotLines(
+            "GPU dispatch [ms]",
+            [](void *data, int idx)
+            {
+                const auto &timings = *static_cast<const std::deque<SimulationTiming>*>(data);
+                return (float)(timings[idx].DispatchTime * 1.0e3);
+            },
+            (void*)&timings, (int)timings.size());
+    }
+    if (ImGui::BeginTable("Timings", 4, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("[ms]");
+        ImGui::TableSetupColumn("Min");
+        ImGui::TableSetupColumn("Mean");
+        ImGui::TableSetupColumn("P99");
+        ImGui::TableHeadersRow();
+        for (const auto &[name, time] : c_ProfiledTimes)
+        {
+            const auto stats = profiler_.GetStats(time);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3lf", stats.Min * 1.0e3);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3lf", stats.Mean * 1.0e3);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3lf", stats.P99 * 1.0e3);
+        }
+
+        ImGui::EndTable();
+    }
+    ImGui::Text("Samples: %zu/%zu", timings.size(), profiler_.GetHistorySize());
+    if (ImGui::Button("Clear"))
+        profiler_.Clear();
+    ImGui::SameLine();
+    if (ImGui::Button("Export CSV..."))
+    {
+        const IGFD::FileDialogConfig config {
+            .path = ".",
+            .countSelectionMax = 1,
+            .flags = ImGuiFileDialogFlags_Modal | ImGuiFileDialogFlags_ConfirmOverwrite,
+        };
+        fileOpenDialog_.OpenDialog("ChooseFileDlgKey", "Choose profiling export file...", ".csv", config);
+        openFileDialogAction_ = OpenFileDialogAction::ExportProfile;
+    }
+
+    ImGui::SeparatorText("GPU kernel benchmark");
+    if (ImGui::Button("Run"))
+    {
+        kernelBenchmarkResults_ = RunKernelBenchmark(
+            c_KernelBenchmarkResolution,
+            c_KernelBenchmarkEmitterCounts,
+            c_KernelBenchmarkIterations);
+    }
+    // Results cycle through the direct, the staged and the staged fast kernel for each emitter count.
+    if (!kernelBenchmarkResults_.empty() && ImGui::BeginTable("Kernel benchmark", 7, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("Emitters");
+        ImGui::TableSetupColumn("Direct [ms]");
+        ImGui::TableSetupColumn("Staged [ms]");
+        ImGui::TableSetupColumn("Speedup");
+        ImGui::TableSetupColumn("Fast [ms]");
+        ImGui::TableSetupColumn("Speedup");
+        ImGui::TableSetupColumn("Fast error");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i + 2 < kernelBenchmarkResults_.size(); i += 3)
+        {
+            const auto &direct = kernelBenchmarkResults_[i];
+            const auto &staged = kernelBenchmarkResults_[i + 1];
+            const auto &fast = kernelBenchmarkResults_[i + 2];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", direct.EmittersCount);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3lf", direct.DispatchTime * 1.0e3);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3lf", staged.DispatchTime * 1.0e3);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2lfx", staged.Throughput / direct.Throughput);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3lf", fast.DispatchTime * 1.0e3);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2lfx", fast.Throughput / staged.Throughput);
+            ImGui::TableNextColumn();
+            if (fast.ExpDegree != 0)
+                ImGui::Text("%.2e (degree %d)", fast.MaxRelativeError, fast.ExpDegree);
+            else
+                ImGui::TextUnformatted("exact");
+        }
+
+        ImGui::EndTable();
+    }
     ImGui::End();
 
     ImGui::Begin("Simulation settings");
-    ImGui::SliderFloat("Deposition coefficient", &simController_.GetConfig().DepositionCoeff, 0.0001f, 0.1f, "%.4f");
+    const auto backend = simController_.GetBackend();
+    const auto selectedBackendIdx = backend == SimulationBackend::CPU ? 1 : 0;
+    if (ImGui::BeginCombo("Backend", c_SimulationBackends[selectedBackendIdx].first))
+    {
+        for (size_t i = 0; i < c_SimulationBackends.size(); i++)
+        {
+            if (ImGui::Selectable(c_SimulationBackends[i].first, selectedBackendIdx == i))
+                simController_.SetBackend(c_SimulationBackends[i].second);
+        }
 
-    const auto stability = simController_.GetConfig().Stability;
+        ImGui::EndCombo();
+    }
+    if (backend == SimulationBackend::CPU)
+    {
+        ImGui::SliderInt("CPU threads", &cpuThreadCount_, 1, (int)ThreadPool::GetDefaultThreadCount(), "%d", ImGuiSliderFlags_AlwaysClamp);
+        if (ImGui::IsItemDeactivatedAfterEdit())
+            simController_.SetCPUThreadCount((size_t)cpuThreadCount_);
+        ImGui::Text("Kernel: %s", PlumeKernel::GetISAName(simController_.GetCPUKernelISA()));
+    }
+    else
+    {
+        auto sharedEmitterStaging = simController_.GetSharedEmitterStaging();
+        if (ImGui::Checkbox("Shared-memory emitter staging", &sharedEmitterStaging))
+            simController_.SetSharedEmitterStaging(sharedEmitterStaging);
+        ImGui::Checkbox("Reload shaders on change", &watchShaders_);
+    }
+    auto incrementalUpdates = simController_.GetIncrementalUpdates();
+    if (ImGui::Checkbox("Incremental emitter updates", &incrementalUpdates))
+        simController_.SetIncrementalUpdates(incrementalUpdates);
+    // Edits go to a copy so that the controller only sees (and recomputes for) actual changes.
+    auto config = simController_.GetConfig();
+    ImGui::SliderFloat("Deposition coefficient", &config.DepositionCoeff, 0.0001f, 0.1f, "%.4f");
+
+    const auto stability = config.Stability;
     const auto selectedStabilityIdx = std::distance(
         c_AtmosphericStabilityClasses.begin(),
         std::find_if(
@@ -165,19 +351,73 @@ void Application::RenderUI()
         {
             const auto &stability = c_AtmosphericStabilityClasses[i];
             if (ImGui::Selectable(stability.first, selectedStabilityIdx == i))
-                simController_.GetConfig().Stability = stability.second;
+                config.Stability = stability.second;
         }
 
         ImGui::EndCombo();
     }
     ImGui::SeparatorText("Wind");
-    ImGui::SliderFloat("Speed [m/s]", &simController_.GetConfig().WindSpeed, 0.0f, 100.0f, "%.1f");
+    ImGui::SliderFloat("Speed [m/s]", &config.WindSpeed, 0.0f, 100.0f, "%.1f");
 
     // TODO Implement wind direction correctly
     ImGui::BeginDisabled();
-    ImGui::SliderAngle("Direction", &simController_.GetConfig().WindDir);
+    ImGui::SliderAngle("Direction", &config.WindDir);
     ImGui::EndDisabled();
 
+    ImGui::SeparatorText("Performance");
+    ImGui::SliderFloat("Culling threshold [g/m^3]", &config.CullingThreshold, 0.0f, 1.0e-3f, "%.2e", ImGuiSliderFlags_Logarithmic);
+    auto clusterTolerance = simController_.GetClusterTolerance();
+    if (ImGui::SliderFloat("Far-field tolerance", &clusterTolerance, 0.0f, 1.0e-1f, "%.2e", ImGuiSliderFlags_Logarithmic))
+        simController_.SetClusterTolerance(clusterTolerance);
+    // Applied on release only, as every new budget is checked against the exact kernel.
+    ImGui::SliderFloat("Fast-math accuracy budget", &accuracyBudget_, 0.0f, 1.0e-2f, "%.2e", ImGuiSliderFlags_Logarithmic);
+    if (ImGui::IsItemDeactivatedAfterEdit())
+        simController_.SetAccuracyBudget(accuracyBudget_);
+    if (simController_.GetExpDegree() != 0)
+        ImGui::Text("Degree %d exp, measured error %.2e", simController_.GetExpDegree(), simController_.GetKernelError());
+    const auto lodScale = simController_.GetInteractiveLODScale();
+    const auto selectedLODScaleIdx = (size_t)std::distance(
+        c_InteractiveLODScales.begin(),
+        std::ranges::find(c_InteractiveLODScales, lodScale, &std::pair<const char*, int>::second));
+    if (ImGui::BeginCombo("Resolution while editing", selectedLODScaleIdx < c_InteractiveLODScales.size()
+        ? c_InteractiveLODScales[selectedLODScaleIdx].first
+        : "Custom"))
+    {
+        for (size_t i = 0; i < c_InteractiveLODScales.size(); i++)
+        {
+            if (ImGui::Selectable(c_InteractiveLODScales[i].first, selectedLODScaleIdx == i))
+                simController_.SetInteractiveLODScale(c_InteractiveLODScales[i].second);
+        }
+
+        ImGui::EndCombo();
+    }
+    auto refinementBudget = (float)(simController_.GetRefinementBudget() * 1.0e3);
+    if (ImGui::SliderFloat("Refinement budget [ms]", &refinementBudget, 1.0f, 50.0f, "%.1f"))
+        simController_.SetRefinementBudget(refinementBudget * 1.0e-3);
+    if (simController_.IsRefining())
+        ImGui::ProgressBar(simController_.GetRefinementProgress(), ImVec2(-1.0f, 0.0f), "Refining");
+
+    ImGui::SeparatorText("Output");
+    const auto selectedFormatIdx = (size_t)std::distance(
+        c_ConcentrationFormats.begin(),
+        std::ranges::find(c_ConcentrationFormats, config.OutputFormat, &std::pair<const char*, ConcentrationFormat>::second));
+    if (ImGui::BeginCombo("Format", c_ConcentrationFormats[selectedFormatIdx].first))
+    {
+        for (size_t i = 0; i < c_ConcentrationFormats.size(); i++)
+        {
+            if (ImGui::Selectable(c_ConcentrationFormats[i].first, selectedFormatIdx == i))
+                config.OutputFormat = c_ConcentrationFormats[i].second;
+        }
+
+        ImGui::EndCombo();
+    }
+    const auto precision = GetConcentrationPrecision(config.OutputFormat);
+    ImGui::Text("Relative error: %.2e", precision.RelativeError);
+    ImGui::Text("Range: [%.2e, %.2e] g/m^3", precision.MinValue, precision.MaxValue);
+    ImGui::Text("Grid memory: %.1f MiB",
+        (double)config.Resolution.x * (double)config.Resolution.y
+            * (double)GetConcentrationSampleSize(config.OutputFormat) / (1024.0 * 1024.0));
+
     ImGui::SeparatorText("Grid");
     ImGui::TextUnformatted("Resolution");
     ImGui::SliderInt("X", &gridResolutionNew_.x, 0, maxTextureResolution_, "%d", ImGuiSliderFlags_AlwaysClamp);
@@ -186,20 +426,20 @@ void Application::RenderUI()
     ImGui::DragFloat("X [m]", &gridSizeNew_.x, 1.0f);
     ImGui::DragFloat("Y [m]", &gridSizeNew_.y, 1.0f);
     
-    const auto gridResolutionChanged = gridResolutionNew_ != simController_.GetConfig().Resolution;
+    const auto gridResolutionChanged = gridResolutionNew_ != config.Resolution;
     const auto gridSizeChanged = 
-        glm::epsilonNotEqual(gridSizeNew_.x, simController_.GetConfig().Size.x, 1.0e-6f)
-        || glm::epsilonNotEqual(gridSizeNew_.y, simController_.GetConfig().Size.y, 1.0e-6f);
+        glm::epsilonNotEqual(gridSizeNew_.x, config.Size.x, 1.0e-6f)
+        || glm::epsilonNotEqual(gridSizeNew_.y, config.Size.y, 1.0e-6f);
     ImGui::BeginDisabled(!(gridResolutionChanged || gridSizeChanged));
     if (ImGui::Button("Apply"))
     {
-        simController_.GetConfig().Resolution = gridResolutionNew_;
-        simController_.GetConfig().Size = gridSizeNew_;
-
-        simController_.ResizeTexture(gridResolutionNew_);
+        config.Resolution = gridResolutionNew_;
+        config.Size = gridSizeNew_;
     }
     ImGui::EndDisabled();
 
+    simController_.SetConfig(config);
+
     ImGui::End();
 
     ImGui::Begin("Emitters");
@@ -223,7 +463,7 @@ void Application::RenderUI()
     ImGui::Separator();
     if (simController_.GetEmittersCount() > selectedEmitterIdx_)
     {
-        auto &selectedEmitter = simController_.GetEmitter(selectedEmitterIdx_);
+        auto selectedEmitter = simController_.GetEmitter(selectedEmitterIdx_);
         const auto &simConfig = simController_.GetConfig();
         ImGui::Text("Position [m]");
         ImGui::DragFloat("X", &selectedEmitter.Position.x, 0.1f, 0.0f, simConfig.Size.x);
@@ -235,6 +475,8 @@ void Application::RenderUI()
         ImGui::DragFloat("Emission rate [g/s]", &selectedEmitter.EmissionRate, 1.0f, 0.0f, 0.0f, "%.0f");
         ImGui::Separator();
 
+        simController_.UpdateEmitter(selectedEmitterIdx_, selectedEmitter);
+
         if (ImGui::Button("Remove"))
             simController_.RemoveEmitter(selectedEmitterIdx_);
     }
@@ -243,6 +485,7 @@ void Application::RenderUI()
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, {0.0f, 0.0f});
     ImGui::Begin("Simulation output", nullptr, ImGuiWindowFlags_NoTitleBar);
 
+    // The reduced-resolution output of an edit in progress is stretched over the full grid.
     const auto& outputTexture = simController_.GetOutputTexture();
     const auto windowSize = ImGui::GetContentRegionAvail();
     const auto scale = std::min(
@@ -251,7 +494,7 @@ void Application::RenderUI()
     const ImVec2 textureSize{scale * outputTexture.GetWidth(), scale * outputTexture.GetHeight()};
     ImGui::SetCursorPosX((windowSize.x - textureSize.x) / 2);
     ImGui::SetCursorPosY((windowSize.y - textureSize.y) / 2);
-    ImGui::Image((ImTextureRef)outputTexture.GetID(), textureSize);
+    ImGui::Image((ImTextureRef)simController_.GetDisplayTexture().GetID(), textureSize);
     ImGui::End();
     ImGui::PopStyleVar();
 
@@ -261,21 +504,149 @@ void Application::RenderUI()
         {
             if (openFileDialogAction_ == OpenFileDialogAction::Open)
             {
-                auto [config, emitters] = LoadSimulationConfigFromFile(fileOpenDialog_.GetFilePathName());
-                simController_.SetConfig(std::move(config));
-                simController_.SetEmitters(std::move(emitters));
+                loadTask_.Start(
+                    [filepath = fileOpenDialog_.GetFilePathName()](IOProgress &progress)
+                    {
+                        return LoadSimulationConfigFromFile(filepath, &progress);
+                    });
+            }
+            else if (openFileDialogAction_ == OpenFileDialogAction::ExportProfile)
+            {
+                profiler_.SaveToCSV(fileOpenDialog_.GetFilePathName());
+            }
+            else if (openFileDialogAction_ == OpenFileDialogAction::ExportGrid)
+            {
+                // The grid is written once its readback arrives, so exporting does not stall the render loop.
+                try
+                {
+                    simController_.CompleteRefinement();
+                    if (simController_.RequestReadback())
+                        gridExports_.push_back({fileOpenDialog_.GetFilePathName(), simController_.GetConfig(), simController_.GetEmitters()});
+                    else
+                    {
+                        auto config = simController_.GetConfig();
+                        config.Resolution = simController_.GetOutputTexture().GetSize();
+                        SaveGridFile(
+                            fileOpenDialog_.GetFilePathName(),
+                            config,
+                            simController_.GetEmitters(),
+                            simController_.ReadOutput(),
+                            {.Compression = GridCompression::ShuffleRLE});
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    fileError_ = e.what();
+                }
             }
             else
             {
-                SaveSimulationConfigToFile(
-                    fileOpenDialog_.GetFilePathName(),
-                    simController_.GetConfig(),
-                    simController_.GetEmitters());
+                // The worker saves a snapshot, so edits made while it runs do not race with it.
+                saveTask_.Start(
+                    [filepath = fileOpenDialog_.GetFilePathName(), config = simController_.GetConfig(), emitters = simController_.GetEmitters()]
+                    (IOProgress &progress)
+                    {
+                        SaveSimulationConfigToFile(filepath, config, emitters, &progress);
+                    });
             }
         }
 
         fileOpenDialog_.Close();
     }
 
+    RenderFileTasks();
+
+    // Read after every widget had its turn, so an edit made this frame counts as interaction.
+    simController_.SetInteracting(ImGui::IsAnyItemActive());
+
     imguiContext_.Render();
 }
+
+void Application::SaveGridExport(const SimulationReadback &readback)
+{
+    // Grid exports are the only readbacks requested, and PollReadback() returns them in request order.
+    auto gridExport = std::move(gridExports_.front());
+    gridExports_.pop_front();
+
+    gridExport.Config.Resolution = readback.Resolution;
+    gridExport.Config.OutputFormat = readback.Format;
+    try
+    {
+        SaveGridFile(
+            gridExport.Path,
+            gridExport.Config,
+            gridExport.Emitters,
+            readback.Values,
+            {.Compression = GridCompression::ShuffleRLE});
+    }
+    catch (const std::exception &e)
+    {
+        fileError_ = e.what();
+    }
+}
+
+void Application::CollectFileTasks()
+{
+    // Config and emitters are swapped in together, before the next Calculate() sees either of them.
+    try
+    {
+        if (loadTask_.IsReady())
+        {
+            auto [config, emitters] = loadTask_.Get();
+            simController_.SetConfig(config);
+            simController_.SetEmitters(emitters);
+            gridResolutionNew_ = config.Resolution;
+            gridSizeNew_ = config.Size;
+            selectedEmitterIdx_ = 0;
+        }
+        if (saveTask_.IsReady())
+            saveTask_.Get();
+    }
+    catch (const IOCanceledError&)
+    {
+    }
+    catch (const std::exception &e)
+    {
+        fileError_ = e.what();
+    }
+}
+
+void Application::RenderFileTasks()
+{
+    if (IsFileTaskActive())
+    {
+        const auto isLoading = loadTask_.IsActive();
+        const auto progress = isLoading ? loadTask_.GetProgress() : saveTask_.GetProgress();
+        const auto isCanceling = isLoading ? loadTask_.IsCancelRequested() : saveTask_.IsCancelRequested();
+
+        const auto *viewport = ImGui::GetMainViewport();
+        ImGui::SetNextWindowPos(viewport->GetCenter(), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+        ImGui::Begin(
+            "File progress",
+            nullptr,
+            ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings);
+        ImGui::TextUnformatted(isLoading ? "Loading config..." : "Saving config...");
+        ImGui::ProgressBar(progress, ImVec2(ImGui::GetFontSize() * 16.0f, 0.0f));
+        ImGui::BeginDisabled(isCanceling);
+        if (ImGui::Button("Cancel"))
+        {
+            loadTask_.Cancel();
+            saveTask_.Cancel();
+        }
+        ImGui::EndDisabled();
+        ImGui::End();
+    }
+
+    if (!fileError_.empty())
+        ImGui::OpenPopup("File error");
+    if (ImGui::BeginPopupModal("File error", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::TextUnformatted(fileError_.c_str());
+        if (ImGui::Button("OK"))
+        {
+            fileError_.clear();
+            ImGui::CloseCurrentPopup();
+        }
+        ImGui::EndPopup();
+    }
+}
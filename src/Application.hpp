@@ -1,14 +1,30 @@
 #pragma once
 #include <vector>
+#include <deque>
+#include <string>
+#include <utility>
 #include <ImGuiFileDialog.h>
 #include "Window.hpp"
 #include "ImGUIContext.hpp"
 #include "SimulationController.hpp"
+#include "SimulationProfiler.hpp"
+#include "BackgroundTask.hpp"
+#include "KernelBenchmark.hpp"
 
 enum class OpenFileDialogAction
 {
     Open,
     Save,
+    ExportProfile,
+    ExportGrid,
+};
+
+// Grid export waiting for its output readback to arrive.
+struct PendingGridExport
+{
+    std::string Path;
+    SimulationConfig Config;
+    std::vector<EmitterInfo> Emitters;
 };
 
 class Application
@@ -22,13 +38,28 @@ private:
     ImGUIContext imguiContext_;
     IGFD::FileDialog fileOpenDialog_;
     SimulationController simController_;
+    SimulationProfiler profiler_;
+    BackgroundTask<std::pair<SimulationConfig, std::vector<EmitterInfo>>> loadTask_;
+    BackgroundTask<void> saveTask_;
+    std::string fileError_;
+    std::vector<KernelBenchmarkResult> kernelBenchmarkResults_;
+    std::deque<PendingGridExport> gridExports_;
     OpenFileDialogAction openFileDialogAction_;
     GLint maxTextureResolution_;
     glm::ivec2 gridResolutionNew_;
     glm::vec2 gridSizeNew_;
     size_t selectedEmitterIdx_ = 0;
+    int cpuThreadCount_ = 1;
+    float accuracyBudget_ = 0.0f;
+    int idleFrames_ = 0;
+    bool watchShaders_ = false;
+    double lastShaderCheckTime_ = 0.0;
     double frametime_ = 1.0;
 
 
     void RenderUI();
+    void RenderFileTasks();
+    void CollectFileTasks();
+    void SaveGridExport(const SimulationReadback &readback);
+    bool IsFileTaskActive() const noexcept { return loadTask_.IsActive() || saveTask_.IsActive(); }
 };
\ No newline at end of file
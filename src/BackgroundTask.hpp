@@ -0,0 +1,68 @@
+#pragma once
+#include <future>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include "SimulationIO.hpp"
+
+// Runs one job at a time on a worker thread. The UI thread polls IsReady() every frame and collects the
+// result with Get(), so it never blocks on the job.
+template<typename T>
+class BackgroundTask
+{
+public:
+    using Job = std::function<T(IOProgress &progress)>;
+
+    BackgroundTask() = default;
+    BackgroundTask(const BackgroundTask&) = delete;
+    BackgroundTask(BackgroundTask&&) noexcept = default;
+
+    // Waits for a running job, after asking it to stop.
+    ~BackgroundTask() noexcept
+    {
+        Cancel();
+    }
+
+    BackgroundTask& operator=(BackgroundTask&&) noexcept = default;
+
+    void Start(Job job)
+    {
+        Cancel();
+        if (result_.valid())
+            result_.wait();
+
+        // The progress is shared so that it outlives this object if the job is still running when it is moved.
+        progress_ = std::make_shared<IOProgress>();
+        result_ = std::async(
+            std::launch::async,
+            [job = std::move(job), progress = progress_]
+            {
+                return job(*progress);
+            });
+    }
+
+    void Cancel() noexcept
+    {
+        if (progress_)
+            progress_->CancelRequested = true;
+    }
+
+    // Rethrows the exception of a failed job.
+    T Get()
+    {
+        progress_.reset();
+        return result_.get();
+    }
+
+    // True from Start() until the result is collected.
+    bool IsActive() const noexcept { return result_.valid(); }
+    bool IsReady() const noexcept
+    {
+        return result_.valid() && result_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+    float GetProgress() const noexcept { return progress_ ? progress_->Fraction.load() : 0.0f; }
+    bool IsCancelRequested() const noexcept { return progress_ && progress_->CancelRequested.load(); }
+private:
+    std::future<T> result_;
+    std::shared_ptr<IOProgress> progress_;
+};
@@ -0,0 +1,74 @@
+#include "Benchmark.hpp"
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+
+nlohmann::json BenchmarkResult::ToJSON() const
+{
+    nlohmann::json json;
+    json["name"] = Name;
+    json["parameters"] = Parameters;
+    json["iterations"] = Iterations;
+    json["minTimeNs"] = MinTime;
+    json["medianTimeNs"] = MedianTime;
+    json["meanTimeNs"] = MeanTime;
+    json["maxTimeNs"] = MaxTime;
+    json["itemsPerSecond"] = ItemsPerSecond;
+
+    return json;
+}
+
+void BenchmarkRunner::Register(std::string name, nlohmann::json parameters, BenchmarkFunction function)
+{
+    benchmarks_.emplace_back(std::move(name), std::move(parameters), std::move(function));
+}
+
+std::vector<BenchmarkResult> BenchmarkRunner::Run(const std::string_view filter) const
+{
+    std::vector<BenchmarkResult> results;
+    for (const auto &benchmark : benchmarks_)
+    {
+        if (benchmark.Name.find(filter) != std::string::npos)
+            results.emplace_back(Run(benchmark));
+    }
+
+    return results;
+}
+
+BenchmarkResult BenchmarkRunner::Run(const Benchmark &benchmark) const
+{
+    using Clock = std::chrono::steady_clock;
+
+    // The first call warms up caches and lazily created state (thread pools, allocations) and tells how many
+    // iterations fill one repetition.
+    auto start = Clock::now();
+    const auto items = benchmark.Function();
+    const std::chrono::duration<double> warmupTime = Clock::now() - start;
+    const auto iterationsPerRepetition = std::max<size_t>(1, (size_t)(minTime_ / std::max(warmupTime.count(), 1.0e-9)));
+
+    std::vector<double> times;
+    times.reserve(repetitions_);
+    for (size_t i = 0; i < repetitions_; i++)
+    {
+        start = Clock::now();
+        for (size_t j = 0; j < iterationsPerRepetition; j++)
+            benchmark.Function();
+        const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+
+        times.push_back(elapsed.count() / (double)iterationsPerRepetition);
+    }
+
+    std::ranges::sort(times);
+    const auto meanTime = std::accumulate(times.begin(), times.end(), 0.0) / (double)times.size();
+
+    return {
+        .Name = benchmark.Name,
+        .Parameters = benchmark.Parameters,
+        .Iterations = iterationsPerRepetition * repetitions_,
+        .MinTime = times.front(),
+        .MedianTime = times[times.size() / 2],
+        .MeanTime = meanTime,
+        .MaxTime = times.back(),
+        .ItemsPerSecond = (double)items / (times[times.size() / 2] * 1.0e-9),
+    };
+}
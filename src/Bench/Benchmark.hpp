@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+struct BenchmarkResult
+{
+    std::string Name;
+    nlohmann::json Parameters;
+    size_t Iterations;
+    // Per-iteration wall time statistics over all repetitions, in nanoseconds.
+    double MinTime;
+    double MedianTime;
+    double MeanTime;
+    double MaxTime;
+    double ItemsPerSecond;
+
+    nlohmann::json ToJSON() const;
+};
+
+// Runs one iteration of the measured code and returns the number of items it processed (grid cells,
+// emitters, bytes...), which is reported as throughput.
+using BenchmarkFunction = std::function<size_t()>;
+
+struct Benchmark
+{
+    std::string Name;
+    nlohmann::json Parameters;
+    BenchmarkFunction Function;
+};
+
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(double minTime, size_t repetitions) noexcept
+        : minTime_(minTime), repetitions_(repetitions) { }
+
+    void Register(std::string name, nlohmann::json parameters, BenchmarkFunction function);
+    // Runs every registered benchmark whose name contains `filter`, in registration order.
+    std::vector<BenchmarkResult> Run(const std::string_view filter) const;
+
+    constexpr const std::vector<Benchmark>& GetBenchmarks() const noexcept { return benchmarks_; }
+private:
+    std::vector<Benchmark> benchmarks_;
+    // Minimum wall time of a single repetition, in seconds.
+    double minTime_;
+    size_t repetitions_;
+
+    BenchmarkResult Run(const Benchmark &benchmark) const;
+};
+
+// Keeps the compiler from discarding a value computed only for measurement.
+template<typename T>
+inline void DoNotOptimize(const T &value) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    const volatile auto *sink = reinterpret_cast<const volatile char*>(&value);
+    (void)*sink;
+#endif
+}
@@ -0,0 +1,543 @@
+#include <array>
+#include <tuple>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <format>
+#include <cstdlib>
+#include <memory>
+#include <fstream>
+#include <utility>
+#include <iostream>
+#include <optional>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+#include <nlohmann/json.hpp>
+#include "Benchmark.hpp"
+#include "../SimulationIO.hpp"
+#include "../EmitterTable.hpp"
+#include "../EmitterStore.hpp"
+#include "../CPU/CPUBackend.hpp"
+#include "../CPU/ScenarioSweep.hpp"
+
+constexpr std::array<std::pair<const char*, glm::vec2>, 3> c_BenchmarkStabilityClasses {
+    std::make_pair("A", AtmosphericStabilityA),
+    std::make_pair("D", AtmosphericStabilityD),
+    std::make_pair("F", AtmosphericStabilityF),
+};
+constexpr std::array c_BenchmarkResolutions {256, 512, 1024};
+constexpr std::array<size_t, 3> c_BenchmarkEmitterCounts {16, 256, 4096};
+constexpr std::array<size_t, 2> c_BenchmarkInventorySizes {10'000, 100'000};
+// Single-threaded kernel runs use a smaller grid so every ISA finishes in reasonable time.
+constexpr int c_KernelBenchmarkResolution = 256;
+constexpr size_t c_KernelBenchmarkEmitters = 256;
+// Configs hitting each specialization of the CPU kernel: (name, wind direction [rad], deposition coefficient).
+constexpr std::array<std::tuple<const char*, float, float>, 3> c_KernelBenchmarkVariants {
+    std::make_tuple("rotated", 0.3f, 0.0001f),
+    std::make_tuple("aligned", 0.0f, 0.0001f),
+    std::make_tuple("aligned_no_deposition", 0.0f, 0.0f),
+};
+// Tolerances of the adaptive runs, compared against the cpu_backend run of the same grid.
+constexpr std::array c_AdaptiveBenchmarkTolerances {1.0e-3f, 1.0e-4f, 1.0e-5f};
+constexpr int c_AdaptiveBenchmarkResolution = 1024;
+constexpr std::array c_BenchmarkWindSpeeds {2.0f, 5.0f, 10.0f, 20.0f};
+constexpr uint32_t c_BenchmarkSeed = 1234;
+
+struct CommandLineOptions
+{
+    std::string Filter;
+    std::optional<std::filesystem::path> OutputFile;
+    double MinTime = 0.2;
+    size_t Repetitions = 5;
+    size_t ThreadCount = 0;
+    bool ListOnly = false;
+};
+
+static void PrintUsage()
+{
+    std::cout <<
+        "Usage: emissions-bench [options]\n"
+        "Runs the plume kernel, JSON loading and upload microbenchmarks and reports them as JSON.\n"
+        "\n"
+        "Options:\n"
+        "  -f, --filter <text>      Only run benchmarks whose name contains <text>.\n"
+        "  -o, --output <file>      Write the JSON report to <file> instead of stdout.\n"
+        "      --min-time <s>       Minimum duration of each repetition (default: 0.2).\n"
+        "      --repetitions <n>    Number of timed repetitions per benchmark (default: 5).\n"
+        "  -t, --threads <n>        Worker threads for the multithreaded benchmarks (default: all hardware threads).\n"
+        "  -l, --list               List the benchmark names and exit.\n"
+        "  -h, --help               Show this message.\n";
+}
+
+static CommandLineOptions ParseCommandLine(int argc, char **argv)
+{
+    CommandLineOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        const auto nextValue = [&]
+        {
+            if (i + 1 >= argc)
+                throw std::invalid_argument(std::format("Missing value for {}.", arg));
+
+            return std::string{argv[++i]};
+        };
+
+        if (arg == "-h" || arg == "--help")
+        {
+            PrintUsage();
+            std::exit(0);
+        }
+        else if (arg == "-f" || arg == "--filter")
+            options.Filter = nextValue();
+        else if (arg == "-o" || arg == "--output")
+            options.OutputFile = nextValue();
+        else if (arg == "--min-time")
+            options.MinTime = std::stod(nextValue());
+        else if (arg == "--repetitions")
+            options.Repetitions = std::stoul(nextValue());
+        else if (arg == "-t" || arg == "--threads")
+            options.ThreadCount = std::stoul(nextValue());
+        else if (arg == "-l" || arg == "--list")
+            options.ListOnly = true;
+        else
+            throw std::invalid_argument(std::format("Unknown option: {}.", arg));
+    }
+
+    if (options.Repetitions == 0)
+        throw std::invalid_argument("At least one repetition is required.");
+
+    return options;
+}
+
+static SimulationConfig MakeBenchmarkConfig(int resolution, const glm::vec2 &stability)
+{
+    return {
+        .Size = {1000.0f, 500.0f},
+        .Stability = stability,
+        .WindSpeed = 10.0f,
+        .WindDir = 0.0f,
+        .DepositionCoeff = 0.0001f,
+        .OutputFormat = ConcentrationFormat::Float32,
+        .Resolution = {resolution, resolution},
+        .EmittersCount = 0,
+        .CullingThreshold = 0.0f,
+    };
+}
+
+static std::vector<EmitterInfo> MakeBenchmarkEmitters(const SimulationConfig &config, size_t count)
+{
+    std::mt19937 rng(c_BenchmarkSeed);
+    std::uniform_real_distribution<float> x(0.0f, config.Size.x);
+    std::uniform_real_distribution<float> y(-config.Size.y, config.Size.y);
+    std::uniform_real_distribution<float> height(10.0f, 200.0f);
+    std::uniform_real_distribution<float> emissionRate(10.0f, 1000.0f);
+
+    std::vector<EmitterInfo> emitters(count);
+    for (auto &emitter : emitters)
+        emitter = {.Position = {x(rng), y(rng)}, .EmissionRate = emissionRate(rng), .Height = height(rng)};
+
+    return emitters;
+}
+
+static void RegisterKernelBenchmarks(BenchmarkRunner &runner, CPUBackend &backend)
+{
+    for (const auto resolution : c_BenchmarkResolutions)
+    {
+        for (const auto emittersCount : c_BenchmarkEmitterCounts)
+        {
+            for (const auto &[stabilityName, stability] : c_BenchmarkStabilityClasses)
+            {
+                auto config = MakeBenchmarkConfig(resolution, stability);
+                auto emitters = MakeBenchmarkEmitters(config, emittersCount);
+                config.EmittersCount = (int)emittersCount;
+
+                runner.Register(
+                    std::format("cpu_backend/{}x{}/{}/{}", resolution, resolution, emittersCount, stabilityName),
+                    {
+                        {"resolution", resolution},
+                        {"emitters", emittersCount},
+                        {"stability", stabilityName},
+                        {"threads", backend.GetThreadCount()},
+                    },
+                    [&backend, config, emitters = std::move(emitters)]
+                    {
+                        backend.Calculate(config, emitters);
+                        DoNotOptimize(backend.GetOutput().data());
+
+                        return (size_t)config.Resolution.x * (size_t)config.Resolution.y * emitters.size();
+                    });
+            }
+        }
+    }
+
+    for (const auto isa : {KernelISA::Scalar, KernelISA::AVX2, KernelISA::AVX512})
+    {
+        if (!PlumeKernel::IsISASupported(isa))
+            continue;
+
+        for (const auto &[variantName, windDir, depositionCoeff] : c_KernelBenchmarkVariants)
+        {
+            auto config = MakeBenchmarkConfig(c_KernelBenchmarkResolution, AtmosphericStabilityD);
+            config.WindDir = windDir;
+            config.DepositionCoeff = depositionCoeff;
+            auto emitters = MakeBenchmarkEmitters(config, c_KernelBenchmarkEmitters);
+            config.EmittersCount = (int)emitters.size();
+
+            runner.Register(
+                std::format("plume_kernel/{}/{}", PlumeKernel::GetISAName(isa), variantName),
+                {
+                    {"resolution", c_KernelBenchmarkResolution},
+                    {"emitters", c_KernelBenchmarkEmitters},
+                    {"isa", PlumeKernel::GetISAName(isa)},
+                    {"variant", variantName},
+                },
+                [kernel = PlumeKernel(isa), config, emitters,
+                    output = std::vector<float>((size_t)config.Resolution.x * config.Resolution.y)]() mutable
+                {
+                    kernel.Evaluate(config, emitters, output);
+                    DoNotOptimize(output.data());
+
+                    return output.size() * emitters.size();
+                });
+
+            // Every fast variant with the error it actually reaches on this grid, compared against the exact run.
+            const GridRegion grid{{0, 0}, config.Resolution};
+
+            for (const auto &fastVariant : c_FastKernelVariants)
+            {
+                PlumeKernel kernel(isa);
+                kernel.SetAccuracyBudget(fastVariant.MaxRelativeError);
+                const auto maxError = kernel.MeasureRelativeError(
+                    PlumeKernel::PrepareConstants(config),
+                    PlumeKernel::PrepareEmitters(config, emitters),
+                    std::span(&grid, 1));
+
+                runner.Register(
+                    std::format("plume_kernel/{}/{}/exp{}", PlumeKernel::GetISAName(isa), variantName, fastVariant.ExpDegree),
+                    {
+                        {"resolution", c_KernelBenchmarkResolution},
+                        {"emitters", c_KernelBenchmarkEmitters},
+                        {"isa", PlumeKernel::GetISAName(isa)},
+                        {"variant", variantName},
+                        {"exp_degree", fastVariant.ExpDegree},
+                        {"accuracy_budget", fastVariant.MaxRelativeError},
+                        {"max_relative_error", maxError},
+                    },
+                    [kernel, config, emitters,
+                        output = std::vector<float>((size_t)config.Resolution.x * config.Resolution.y)]() mutable
+                    {
+                        kernel.Evaluate(config, emitters, output);
+                        DoNotOptimize(output.data());
+
+                        return output.size() * emitters.size();
+                    });
+            }
+        }
+    }
+}
+
+static void RegisterSweepBenchmarks(BenchmarkRunner &runner, CPUBackend &backend)
+{
+    auto config = MakeBenchmarkConfig(c_KernelBenchmarkResolution, AtmosphericStabilityD);
+    auto emitters = MakeBenchmarkEmitters(config, c_KernelBenchmarkEmitters);
+    config.EmittersCount = (int)emitters.size();
+
+    std::vector<glm::vec2> stabilities;
+    for (const auto &[stabilityName, stability] : c_BenchmarkStabilityClasses)
+        stabilities.emplace_back(stability);
+    const auto variants = MakeSweepVariants(config, stabilities, c_BenchmarkWindSpeeds, std::span{&config.WindDir, 1});
+    const auto cellCount = (size_t)config.Resolution.x * (size_t)config.Resolution.y;
+    const nlohmann::json parameters{
+        {"resolution", c_KernelBenchmarkResolution},
+        {"emitters", c_KernelBenchmarkEmitters},
+        {"variants", variants.size()},
+        {"threads", backend.GetThreadCount()},
+    };
+
+    runner.Register(
+        std::format("sweep/batched/{}", variants.size()),
+        parameters,
+        [&backend, variants, emitters, output = std::vector<float>(variants.size() * cellCount)]() mutable
+        {
+            backend.CalculateSweep(variants, emitters, output);
+            DoNotOptimize(output.data());
+
+            return output.size() * emitters.size();
+        });
+    // The same variants computed one Calculate call at a time, as the baseline for the batched sweep.
+    runner.Register(
+        std::format("sweep/separate/{}", variants.size()),
+        parameters,
+        [&backend, variants, emitters, cellCount]
+        {
+            for (const auto &variant : variants)
+            {
+                backend.Calculate(variant, emitters);
+                DoNotOptimize(backend.GetOutput().data());
+            }
+
+            return variants.size() * cellCount * emitters.size();
+        });
+}
+
+static void RegisterAdaptiveBenchmarks(BenchmarkRunner &runner, CPUBackend &backend)
+{
+    auto config = MakeBenchmarkConfig(c_AdaptiveBenchmarkResolution, AtmosphericStabilityD);
+    auto emitters = MakeBenchmarkEmitters(config, c_KernelBenchmarkEmitters);
+    config.EmittersCount = (int)emitters.size();
+    const auto cellCount = (size_t)config.Resolution.x * (size_t)config.Resolution.y;
+
+    backend.Calculate(config, emitters);
+    const std::vector<float> reference(backend.GetOutput().begin(), backend.GetOutput().end());
+    const auto peak = *std::ranges::max_element(reference);
+
+    for (const auto tolerance : c_AdaptiveBenchmarkTolerances)
+    {
+        // Run once up front to report how much of the grid was evaluated and how far it is from the full grid.
+        const AdaptiveOptions options{.Tolerance = tolerance};
+        const auto evaluatedCount = backend.CalculateAdaptive(config, emitters, options);
+        float maxError = 0.0f;
+        for (size_t i = 0; i < cellCount; i++)
+            maxError = std::max(maxError, std::abs(backend.GetOutput()[i] - reference[i]));
+
+        // Throughput counts every cell of the grid, so it compares directly with cpu_backend.
+        runner.Register(
+            std::format("adaptive/{}x{}/{}/{:g}", config.Resolution.x, config.Resolution.y, emitters.size(), tolerance),
+            {
+                {"resolution", c_AdaptiveBenchmarkResolution},
+                {"emitters", emitters.size()},
+                {"tolerance", tolerance},
+                {"evaluated_fraction", (double)evaluatedCount / (double)cellCount},
+                {"max_relative_error", peak > 0.0f ? maxError / peak : 0.0f},
+                {"threads", backend.GetThreadCount()},
+            },
+            [&backend, config, emitters, options, cellCount]
+            {
+                backend.CalculateAdaptive(config, emitters, options);
+                DoNotOptimize(backend.GetOutput().data());
+
+                return cellCount * emitters.size();
+            });
+    }
+}
+
+// Input file of the loading benchmarks. It is written by the first run of a benchmark reading it and removed with
+// the last benchmark holding it, so that listing or filtering the benchmarks leaves no files behind.
+class BenchmarkFile
+{
+public:
+    using WriteFunction = std::function<void(const std::filesystem::path&)>;
+
+    BenchmarkFile(std::filesystem::path path, WriteFunction write) noexcept
+        : path_(std::move(path)), write_(std::move(write)) { }
+    BenchmarkFile(const BenchmarkFile&) = delete;
+
+    ~BenchmarkFile() noexcept
+    {
+        std::error_code error;
+        if (isWritten_)
+            std::filesystem::remove(path_, error);
+    }
+
+    const std::filesystem::path& GetPath()
+    {
+        if (!isWritten_)
+        {
+            write_(path_);
+            isWritten_ = true;
+        }
+
+        return path_;
+    }
+
+private:
+    std::filesystem::path path_;
+    WriteFunction write_;
+    bool isWritten_ = false;
+};
+
+static void RegisterJSONBenchmarks(BenchmarkRunner &runner)
+{
+    const auto config = MakeBenchmarkConfig(512, AtmosphericStabilityD);
+    const auto configData = config.ToJSON().dump();
+    runner.Register(
+        "json/simulation_config",
+        {},
+        [configData]
+        {
+            DoNotOptimize(SimulationConfig::FromJSON(std::string_view{configData}));
+            return (size_t)1;
+        });
+
+    for (const auto inventorySize : c_BenchmarkInventorySizes)
+    {
+        const auto emitters = MakeBenchmarkEmitters(config, inventorySize);
+        auto emittersData = nlohmann::json::array();
+        for (const auto &emitter : emitters)
+            emittersData.push_back(emitter.ToJSON());
+
+        // Conversion from an already parsed document, which is what LoadSimulationConfigFromFile does per emitter.
+        runner.Register(
+            std::format("json/emitter_info/{}", inventorySize),
+            {{"emitters", inventorySize}},
+            [emittersData]
+            {
+                std::vector<EmitterInfo> parsed;
+                parsed.reserve(emittersData.size());
+                for (const auto &x : emittersData)
+                    parsed.emplace_back(EmitterInfo::FromJSON(x));
+                DoNotOptimize(parsed.data());
+
+                return parsed.size();
+            });
+
+        const auto file = std::make_shared<BenchmarkFile>(
+            std::filesystem::temp_directory_path() / std::format("emissions-bench-{}.json", inventorySize),
+            [config, emitters](const std::filesystem::path &path)
+            {
+                SaveSimulationConfigToFile(path.string(), config, emitters);
+            });
+        // Full DOM parse followed by per-emitter conversion, the loader used before the streaming one.
+        runner.Register(
+            std::format("json/load_config_file_dom/{}", inventorySize),
+            {{"emitters", inventorySize}},
+            [file]
+            {
+                std::ifstream stream(file->GetPath());
+                const auto data = nlohmann::json::parse(stream);
+                std::vector<EmitterInfo> emitters;
+                emitters.reserve(data.at("emitters").size());
+                for (const auto &x : data.at("emitters"))
+                    emitters.emplace_back(EmitterInfo::FromJSON(x));
+                DoNotOptimize(SimulationConfig::FromJSON(data));
+                DoNotOptimize(emitters.data());
+
+                return emitters.size();
+            });
+        runner.Register(
+            std::format("json/load_config_file/{}", inventorySize),
+            {{"emitters", inventorySize}},
+            [file]
+            {
+                const auto [config, emitters] = LoadSimulationConfigFromFile(file->GetPath().string());
+                DoNotOptimize(emitters.data());
+
+                return emitters.size();
+            });
+
+        const auto tableFile = std::make_shared<BenchmarkFile>(
+            std::filesystem::temp_directory_path() / std::format("emissions-bench-{}.emitters", inventorySize),
+            [emitters](const std::filesystem::path &path)
+            {
+                SaveEmitterTable(path, emitters);
+            });
+        runner.Register(
+            std::format("emitter_table/load/{}", inventorySize),
+            {{"emitters", inventorySize}},
+            [tableFile]
+            {
+                const EmitterTable table(tableFile->GetPath());
+                const auto emitters = table.GetEmitters();
+                std::vector<EmitterInfo> copy(emitters.begin(), emitters.end());
+                DoNotOptimize(copy.data());
+
+                return copy.size();
+            });
+    }
+}
+
+// There is no GL context here, so this covers the host side of the emitter upload: regenerating the packed
+// invariants written to the emitters buffer, as after every change of the wind.
+static void RegisterUploadBenchmarks(BenchmarkRunner &runner)
+{
+    const auto config = MakeBenchmarkConfig(512, AtmosphericStabilityD);
+    for (const auto inventorySize : c_BenchmarkInventorySizes)
+    {
+        runner.Register(
+            std::format("upload/invariants/{}", inventorySize),
+            {{"emitters", inventorySize}, {"bytes", inventorySize * sizeof(glm::vec4)}},
+            [variant = config, store = EmitterStore(MakeBenchmarkEmitters(config, inventorySize))]() mutable
+            {
+                variant.WindDir = variant.WindDir == 0.0f ? 0.3f : 0.0f;
+                const auto invariants = store.GetPackedInvariants(variant);
+                DoNotOptimize(invariants.data());
+
+                return invariants.size_bytes();
+            });
+    }
+}
+
+int main(int argc, char **argv)
+{
+    CommandLineOptions options;
+    try
+    {
+        options = ParseCommandLine(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        PrintUsage();
+        return 2;
+    }
+
+    CPUBackend backend(options.ThreadCount);
+    BenchmarkRunner runner(options.MinTime, options.Repetitions);
+    RegisterKernelBenchmarks(runner, backend);
+    RegisterSweepBenchmarks(runner, backend);
+    RegisterAdaptiveBenchmarks(runner, backend);
+    RegisterJSONBenchmarks(runner);
+    RegisterUploadBenchmarks(runner);
+
+    if (options.ListOnly)
+    {
+        for (const auto &benchmark : runner.GetBenchmarks())
+        {
+            if (benchmark.Name.find(options.Filter) != std::string::npos)
+                std::cout << benchmark.Name << '\n';
+        }
+
+        return 0;
+    }
+
+    auto results = nlohmann::json::array();
+    for (const auto &result : runner.Run(options.Filter))
+    {
+        std::cerr << std::format("{:<40} {:>14.0f} ns {:>12.3e} items/s\n", result.Name, result.MedianTime, result.ItemsPerSecond);
+        results.push_back(result.ToJSON());
+    }
+
+    const auto timestamp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    nlohmann::json report;
+    report["context"] = {
+        {"timestamp", (int64_t)timestamp},
+        {"threads", backend.GetThreadCount()},
+        {"isa", PlumeKernel::GetISAName(backend.GetKernel().GetISA())},
+        {"minTime", options.MinTime},
+        {"repetitions", options.Repetitions},
+    };
+    report["benchmarks"] = std::move(results);
+
+    if (options.OutputFile)
+    {
+        std::ofstream file(*options.OutputFile);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to open benchmark output file.\n";
+            return 1;
+        }
+
+        file << report.dump(4) << '\n';
+    }
+    else
+        std::cout << report.dump(4) << '\n';
+
+    return 0;
+}
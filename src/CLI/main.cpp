@@ -0,0 +1,473 @@
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <array>
+#include <vector>
+#include <string>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+#include "../SimulationIO.hpp"
+#include "../GridFile.hpp"
+#include "../EmitterTable.hpp"
+#include <glm/glm.hpp>
+#include "../CPU/CPUBackend.hpp"
+#include "../CPU/ScenarioSweep.hpp"
+
+constexpr std::array<std::pair<char, glm::vec2>, 6> c_AtmosphericStabilityClasses {
+    std::make_pair('A', AtmosphericStabilityA),
+    std::make_pair('B', AtmosphericStabilityB),
+    std::make_pair('C', AtmosphericStabilityC),
+    std::make_pair('D', AtmosphericStabilityD),
+    std::make_pair('E', AtmosphericStabilityE),
+    std::make_pair('F', AtmosphericStabilityF),
+};
+
+constexpr int c_DefaultBandHeight = 256;
+
+struct CommandLineOptions
+{
+    std::vector<std::filesystem::path> Inputs;
+    std::optional<std::filesystem::path> OutputDirectory;
+    size_t ThreadCount = 0;
+    KernelISA ISA = PlumeKernel::GetBestSupportedISA();
+    std::optional<glm::ivec2> Resolution;
+    // Write tiled grid files (GridFile.hpp) instead of PFM.
+    bool GridFormat = false;
+    GridFileOptions GridOptions;
+    // Overrides the sample format of every config; only grid files store packed samples.
+    std::optional<ConcentrationFormat> Precision;
+    // Write <name>.emitters binary tables instead of computing grids.
+    bool ConvertEmitters = false;
+    // Rows per band in out-of-core mode; 0 computes the whole grid in memory.
+    int BandHeight = 0;
+    // Refine the grid adaptively instead of evaluating every cell.
+    std::optional<AdaptiveOptions> Adaptive;
+    // Relative error allowed for approximating distant emitter clusters; 0 evaluates every emitter exactly.
+    float ClusterTolerance = 0.0f;
+    // Relative error allowed for a fast kernel variant; 0 keeps the exact kernel.
+    float AccuracyBudget = 0.0f;
+    // Sweep dimensions; an empty one keeps the value of each config.
+    std::vector<glm::vec2> Stabilities;
+    std::vector<float> WindSpeeds;
+    std::vector<float> WindDirs;
+
+    constexpr bool IsSweep() const noexcept { return !Stabilities.empty() || !WindSpeeds.empty() || !WindDirs.empty(); }
+};
+
+static void PrintUsage()
+{
+    std::cout <<
+        "Usage: emissions-cli [options] <config.json | directory>...\n"
+        "Computes the concentration grid of every simulation config without opening a window.\n"
+        "Directories are searched (non-recursively) for .json configs.\n"
+        "\n"
+        "Options:\n"
+        "  -o, --output <dir>        Directory for the results (default: next to each config).\n"
+        "  -t, --threads <n>         Number of worker threads (default: all hardware threads).\n"
+        "      --isa <name>          Kernel instruction set: scalar, avx2 or avx512 (default: best supported).\n"
+        "  -r, --resolution <WxH>    Override the grid resolution of every config, e.g. 100000x100000.\n"
+        "      --out-of-core [rows]  Stream the grid to the output file in bands of [rows] rows (default: 256)\n"
+        "                            instead of keeping it in memory, for grids larger than RAM.\n"
+        "      --adaptive [tol]      Only evaluate the cells where interpolating a coarser grid is off by more\n"
+        "                            than [tol] times the highest emitter peak (default: 1e-4).\n"
+        "      --far-field <tol>     Approximate distant emitter clusters by one source each while the error\n"
+        "                            per cell stays within <tol> times its value (default: 0, exact).\n"
+        "      --accuracy <budget>   Use the fastest approximate kernel whose error per cell stays within\n"
+        "                            <budget> times its value, falling back to more accurate ones where the error\n"
+        "                            measured against the exact kernel exceeds it (default: 0, exact).\n"
+        "      --format <pfm|grid>   Output format (default: pfm). grid files are tiled and can be read partially.\n"
+        "      --compress            Compress the tiles of grid files.\n"
+        "      --precision <format>  Sample format of grid files: float32, float16 or log16 (default: from the\n"
+        "                            config, else float32). PFM output is always float32.\n"
+        "      --convert-emitters    Write the emitters of each config to a binary <name>.emitters table instead\n"
+        "                            of computing it. Configs reference tables with \"emitterTable\": \"<file>\".\n"
+        "  -h, --help                Show this message.\n"
+        "\n"
+        "Sweep options (every combination is computed in one pass, results go to <name>_<index>.<format>):\n"
+        "      --stabilities <list>  Stability classes, e.g. A,D,F or all.\n"
+        "      --wind-speeds <list>  Wind speeds [m/s], e.g. 2,5,10.\n"
+        "      --wind-dirs <list>    Wind directions [deg], e.g. 0,45,90.\n";
+}
+
+static KernelISA ParseISA(const std::string_view name)
+{
+    if (name == "scalar")
+        return KernelISA::Scalar;
+    if (name == "avx2")
+        return KernelISA::AVX2;
+    if (name == "avx512")
+        return KernelISA::AVX512;
+
+    throw std::invalid_argument(std::format("Unknown kernel instruction set: {}.", name));
+}
+
+static glm::ivec2 ParseResolution(const std::string_view resolution)
+{
+    const auto separator = resolution.find('x');
+    if (separator == std::string_view::npos)
+        throw std::invalid_argument(std::format("Invalid resolution: {}.", resolution));
+
+    const glm::ivec2 size{
+        std::stoi(std::string{resolution.substr(0, separator)}),
+        std::stoi(std::string{resolution.substr(separator + 1)})};
+    if (size.x < 2 || size.y < 2)
+        throw std::invalid_argument(std::format("Invalid resolution: {}.", resolution));
+
+    return size;
+}
+
+static std::vector<std::string_view> SplitList(const std::string_view list)
+{
+    std::vector<std::string_view> items;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        const auto end = std::min(list.find(',', start), list.size());
+        if (end > start)
+            items.emplace_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+
+    return items;
+}
+
+static std::vector<glm::vec2> ParseStabilities(const std::string_view list)
+{
+    std::vector<glm::vec2> stabilities;
+    if (list == "all")
+    {
+        for (const auto &[name, stability] : c_AtmosphericStabilityClasses)
+            stabilities.emplace_back(stability);
+
+        return stabilities;
+    }
+
+    for (const auto item : SplitList(list))
+    {
+        const auto stabilityClass = std::ranges::find_if(
+            c_AtmosphericStabilityClasses,
+            [&](const auto &x)
+            {
+                return item.size() == 1 && std::toupper(item[0]) == x.first;
+            });
+        if (stabilityClass == c_AtmosphericStabilityClasses.end())
+            throw std::invalid_argument(std::format("Unknown stability class: {}.", item));
+
+        stabilities.emplace_back(stabilityClass->second);
+    }
+
+    return stabilities;
+}
+
+static std::vector<float> ParseFloatList(const std::string_view list, float scale = 1.0f)
+{
+    std::vector<float> values;
+    for (const auto item : SplitList(list))
+        values.emplace_back(std::stof(std::string{item}) * scale);
+
+    return values;
+}
+
+static CommandLineOptions ParseCommandLine(int argc, char **argv)
+{
+    CommandLineOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        const auto nextValue = [&]
+        {
+            if (i + 1 >= argc)
+                throw std::invalid_argument(std::format("Missing value for {}.", arg));
+
+            return std::string_view{argv[++i]};
+        };
+
+        if (arg == "-h" || arg == "--help")
+        {
+            PrintUsage();
+            std::exit(0);
+        }
+        else if (arg == "-o" || arg == "--output")
+            options.OutputDirectory = nextValue();
+        else if (arg == "-t" || arg == "--threads")
+            options.ThreadCount = std::stoul(std::string{nextValue()});
+        else if (arg == "--isa")
+            options.ISA = ParseISA(nextValue());
+        else if (arg == "-r" || arg == "--resolution")
+            options.Resolution = ParseResolution(nextValue());
+        else if (arg == "--out-of-core")
+        {
+            options.BandHeight = c_DefaultBandHeight;
+            if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0]))
+                options.BandHeight = std::stoi(std::string{nextValue()});
+        }
+        else if (arg == "--adaptive")
+        {
+            options.Adaptive = AdaptiveOptions{};
+            if (i + 1 < argc && (std::isdigit((unsigned char)argv[i + 1][0]) || argv[i + 1][0] == '.'))
+                options.Adaptive->Tolerance = std::stof(std::string{nextValue()});
+        }
+        else if (arg == "--far-field")
+            options.ClusterTolerance = std::stof(std::string{nextValue()});
+        else if (arg == "--accuracy")
+            options.AccuracyBudget = std::stof(std::string{nextValue()});
+        else if (arg == "--format")
+        {
+            const auto format = nextValue();
+            if (format != "pfm" && format != "grid")
+                throw std::invalid_argument(std::format("Unknown output format: {}.", format));
+            options.GridFormat = format == "grid";
+        }
+        else if (arg == "--convert-emitters")
+            options.ConvertEmitters = true;
+        else if (arg == "--compress")
+            options.GridOptions.Compression = GridCompression::ShuffleRLE;
+        else if (arg == "--precision")
+            options.Precision = ParseConcentrationFormat(nextValue());
+        else if (arg == "--stabilities")
+            options.Stabilities = ParseStabilities(nextValue());
+        else if (arg == "--wind-speeds")
+            options.WindSpeeds = ParseFloatList(nextValue());
+        else if (arg == "--wind-dirs")
+            options.WindDirs = ParseFloatList(nextValue(), glm::radians(1.0f));
+        else if (arg.starts_with('-'))
+            throw std::invalid_argument(std::format("Unknown option: {}.", arg));
+        else
+            options.Inputs.emplace_back(arg);
+    }
+
+    if (options.Inputs.empty())
+        throw std::invalid_argument("No simulation config given.");
+    if (options.BandHeight > 0 && options.IsSweep())
+        throw std::invalid_argument("Sweeps cannot be combined with --out-of-core.");
+    if (options.Adaptive && (options.BandHeight > 0 || options.IsSweep()))
+        throw std::invalid_argument("--adaptive cannot be combined with --out-of-core or sweeps.");
+    if (options.BandHeight > 0 && options.GridFormat)
+        throw std::invalid_argument("Out-of-core runs can only write PFM files.");
+
+    return options;
+}
+
+static std::vector<std::filesystem::path> CollectConfigFiles(const std::vector<std::filesystem::path> &inputs)
+{
+    std::vector<std::filesystem::path> files;
+    for (const auto &input : inputs)
+    {
+        if (!std::filesystem::is_directory(input))
+        {
+            files.emplace_back(input);
+            continue;
+        }
+
+        std::vector<std::filesystem::path> directoryFiles;
+        for (const auto &entry : std::filesystem::directory_iterator(input))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".json")
+                directoryFiles.emplace_back(entry.path());
+        }
+
+        std::ranges::sort(directoryFiles);
+        files.insert(files.end(), directoryFiles.begin(), directoryFiles.end());
+    }
+
+    return files;
+}
+
+static std::filesystem::path GetOutputPath(
+    const CommandLineOptions &options,
+    const std::filesystem::path &configPath,
+    std::optional<size_t> variantIdx = std::nullopt)
+{
+    auto outputPath = options.OutputDirectory.value_or(configPath.parent_path()) / configPath.filename();
+    if (variantIdx)
+        outputPath.replace_filename(std::format("{}_{}", configPath.stem().string(), *variantIdx));
+    outputPath.replace_extension(options.GridFormat ? ".grid" : ".pfm");
+
+    return outputPath;
+}
+
+static void SaveOutput(
+    const CommandLineOptions &options,
+    const std::filesystem::path &outputPath,
+    const SimulationConfig &config,
+    const std::vector<EmitterInfo> &emitters,
+    std::span<const float> grid)
+{
+    if (options.GridFormat)
+        SaveGridFile(outputPath, config, emitters, grid, options.GridOptions);
+    else
+        SaveConcentrationGridToFile(outputPath.string(), grid, config.Resolution);
+}
+
+// Returns the number of variants written.
+static size_t RunSweep(
+    const CommandLineOptions &options,
+    CPUBackend &backend,
+    const std::filesystem::path &configPath,
+    const SimulationConfig &config,
+    const std::vector<EmitterInfo> &emitters)
+{
+    const auto variants = MakeSweepVariants(
+        config,
+        options.Stabilities.empty() ? std::span{&config.Stability, 1} : std::span<const glm::vec2>{options.Stabilities},
+        options.WindSpeeds.empty() ? std::span{&config.WindSpeed, 1} : std::span<const float>{options.WindSpeeds},
+        options.WindDirs.empty() ? std::span{&config.WindDir, 1} : std::span<const float>{options.WindDirs});
+
+    const auto cellCount = (size_t)config.Resolution.x * (size_t)config.Resolution.y;
+    std::vector<float> output(variants.size() * cellCount);
+    backend.CalculateSweep(variants, emitters, output);
+
+    for (size_t i = 0; i < variants.size(); i++)
+    {
+        const auto outputPath = GetOutputPath(options, configPath, i);
+        SaveOutput(options, outputPath, variants[i], emitters, std::span{output}.subspan(i * cellCount, cellCount));
+        std::cout << std::format(
+            "  [{}] stability ({:.3f}, {:.3f}), wind {:.1f} m/s at {:.1f} deg -> {}\n",
+            i,
+            variants[i].Stability.x,
+            variants[i].Stability.y,
+            variants[i].WindSpeed,
+            glm::degrees(variants[i].WindDir),
+            outputPath.string());
+    }
+
+    return variants.size();
+}
+
+int main(int argc, char **argv)
+{
+    CommandLineOptions options;
+    try
+    {
+        options = ParseCommandLine(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        PrintUsage();
+        return 2;
+    }
+
+    // The backend, and with it the thread pool, is shared by every run of the batch.
+    CPUBackend backend;
+    std::vector<std::filesystem::path> configFiles;
+    try
+    {
+        if (options.OutputDirectory)
+            std::filesystem::create_directories(*options.OutputDirectory);
+
+        backend = CPUBackend(options.ThreadCount, options.ISA);
+        configFiles = CollectConfigFiles(options.Inputs);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    backend.SetClusterTolerance(options.ClusterTolerance);
+    backend.SetAccuracyBudget(options.AccuracyBudget);
+    std::cout << std::format(
+        "Using {} threads, {} kernel{}.\n",
+        backend.GetThreadCount(),
+        PlumeKernel::GetISAName(backend.GetKernel().GetISA()),
+        backend.GetKernel().GetExpDegree() != 0
+            ? std::format(" with degree {} exp", backend.GetKernel().GetExpDegree())
+            : "");
+
+    int failedCount = 0;
+    for (const auto &configPath : configFiles)
+    {
+        try
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            auto [config, emitters] = LoadSimulationConfigFromFile(configPath.string());
+            config.EmittersCount = (int)emitters.size();
+            if (options.Resolution)
+                config.Resolution = *options.Resolution;
+            if (options.Precision)
+                config.OutputFormat = *options.Precision;
+            if (options.GridFormat && config.OutputFormat != ConcentrationFormat::Float32)
+            {
+                const auto precision = GetConcentrationPrecision(config.OutputFormat);
+                std::cout << std::format(
+                    "{}: storing {} samples, relative error up to {:.2e} for values in [{:.2e}, {:.2e}] g/m^3\n",
+                    configPath.string(),
+                    GetConcentrationFormatName(config.OutputFormat),
+                    precision.RelativeError,
+                    precision.MinValue,
+                    precision.MaxValue);
+            }
+            // A previous config may have made the check fall back to a more accurate variant.
+            backend.SetAccuracyBudget(options.AccuracyBudget);
+            if (!options.ConvertEmitters && backend.GetKernel().GetExpDegree() != 0)
+            {
+                const auto error = backend.CheckAccuracyBudget(config, PlumeKernel::PrepareEmitters(config, emitters));
+                std::cout << std::format(
+                    "{}: degree {} exp off by up to {:.2e} relative to the exact kernel (budget {:.2e})\n",
+                    configPath.string(),
+                    backend.GetKernel().GetExpDegree(),
+                    error,
+                    options.AccuracyBudget);
+            }
+            std::string result;
+            if (options.ConvertEmitters)
+            {
+                auto outputPath = GetOutputPath(options, configPath);
+                outputPath.replace_extension(".emitters");
+                SaveEmitterTable(outputPath, emitters);
+                result = outputPath.string();
+            }
+            else if (options.IsSweep())
+            {
+                std::cout << std::format("{}:\n", configPath.string());
+                result = std::format("{} variants", RunSweep(options, backend, configPath, config, emitters));
+            }
+            else if (options.BandHeight > 0)
+            {
+                result = GetOutputPath(options, configPath).string();
+                backend.CalculateToFile(config, emitters, result, options.BandHeight);
+            }
+            else if (options.Adaptive)
+            {
+                result = GetOutputPath(options, configPath).string();
+                const auto evaluatedCount = backend.CalculateAdaptive(config, emitters, *options.Adaptive);
+                SaveOutput(options, result, config, emitters, backend.GetOutput());
+                std::cout << std::format(
+                    "{}: evaluated {:.1f}% of the cells\n",
+                    configPath.string(),
+                    100.0 * (double)evaluatedCount / ((double)config.Resolution.x * (double)config.Resolution.y));
+            }
+            else
+            {
+                result = GetOutputPath(options, configPath).string();
+                backend.Calculate(config, emitters);
+                SaveOutput(options, result, config, emitters, backend.GetOutput());
+            }
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << std::format(
+                "{}: {}x{} grid, {} emitters, {:.3f} s -> {}\n",
+                configPath.string(),
+                config.Resolution.x,
+                config.Resolution.y,
+                emitters.size(),
+                elapsed.count(),
+                result);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << std::format("{}: {}\n", configPath.string(), e.what());
+            failedCount++;
+        }
+    }
+
+    return failedCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+#include "AdaptiveRefinement.hpp"
+#include "TileBinning.hpp"
+#include "PlumeKernelISA.hpp"
+#include <cmath>
+#include <algorithm>
+
+// Lattice point of the region nearest to the given position. Inverse of GetCellPositionX/Y.
+static glm::ivec2 GetLatticePoint(const KernelConstants &constants, const GridRegion &region, float x, float y) noexcept
+{
+    const auto cellX = (x - 1.0f) / (constants.Size.x - 1.0f) * (float)(constants.Resolution.x - 1);
+    const auto cellY = (y + constants.Size.y) / (2.0f * constants.Size.y) * (float)(constants.Resolution.y - 1);
+
+    return glm::ivec2{(int)std::lround(cellX), (int)std::lround(cellY)} - region.Offset;
+}
+
+size_t EvaluateRegionAdaptive(
+    const PlumeKernel &kernel,
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    int baseStep,
+    float tolerance,
+    AdaptiveScratch &scratch,
+    float *output,
+    size_t outputStride)
+{
+    const auto maxError = std::max(tolerance, constants.CullingThreshold);
+    const glm::ivec2 latticeEnd = (region.Size + baseStep - 1) / baseStep * baseStep;
+    const auto width = (size_t)latticeEnd.x + 1;
+
+    BinEmitters(constants, emitters, GridRegion{region.Offset, latticeEnd + 1}, scratch.RegionEmitters);
+    if (scratch.RegionEmitters.GetCount() == 0)
+    {
+        for (int y = 0; y < region.Size.y; y++)
+            std::fill_n(output + (size_t)y * outputStride, region.Size.x, 0.0f);
+
+        return 0;
+    }
+
+    auto &values = scratch.Values;
+    auto &isEvaluated = scratch.IsEvaluated;
+    values.assign(width * (size_t)(latticeEnd.y + 1), 0.0f);
+    isEvaluated.assign(values.size(), 0);
+
+    // Sources are counted on a lattice extended by one base block on every side, so that a block bordering
+    // a source of the neighbouring region is refined too.
+    const auto sourcesWidth = (size_t)(latticeEnd.x + 2 * baseStep + 2);
+    const auto sourcesHeight = (size_t)(latticeEnd.y + 2 * baseStep + 2);
+    auto &sourceCounts = scratch.SourceCounts;
+    sourceCounts.assign(sourcesWidth * sourcesHeight, 0);
+    for (size_t i = 0; i < scratch.RegionEmitters.GetCount(); i++)
+    {
+        const auto point = GetLatticePoint(constants, region, scratch.RegionEmitters.X[i], scratch.RegionEmitters.Y[i]) + baseStep;
+        if (point.x >= 0 && point.y >= 0 && point.x <= latticeEnd.x + 2 * baseStep && point.y <= latticeEnd.y + 2 * baseStep)
+            sourceCounts[(size_t)(point.y + 1) * sourcesWidth + (size_t)(point.x + 1)]++;
+    }
+    for (size_t y = 1; y < sourcesHeight; y++)
+    {
+        for (size_t x = 1; x < sourcesWidth; x++)
+        {
+            sourceCounts[y * sourcesWidth + x] += sourceCounts[y * sourcesWidth + x - 1]
+                + sourceCounts[(y - 1) * sourcesWidth + x]
+                - sourceCounts[(y - 1) * sourcesWidth + x - 1];
+        }
+    }
+
+    // Whether an emitter lies within one block of the block at `origin`.
+    const auto isNearSource = [&](const glm::ivec2 &origin, int step)
+    {
+        const auto lo = glm::max(origin - step + baseStep, glm::ivec2(0));
+        const auto hi = glm::min(origin + 2 * step + baseStep, latticeEnd + 2 * baseStep) + 1;
+        const auto sum = sourceCounts[(size_t)hi.y * sourcesWidth + (size_t)hi.x]
+            - sourceCounts[(size_t)lo.y * sourcesWidth + (size_t)hi.x]
+            - sourceCounts[(size_t)hi.y * sourcesWidth + (size_t)lo.x]
+            + sourceCounts[(size_t)lo.y * sourcesWidth + (size_t)lo.x];
+        return sum > 0;
+    };
+
+    const auto getIndex = [&](int x, int y)
+    {
+        return (size_t)y * width + (size_t)x;
+    };
+
+    size_t evaluatedCount = 0;
+    auto &cells = scratch.Cells;
+    const auto queueCell = [&](int x, int y)
+    {
+        if (isEvaluated[getIndex(x, y)])
+            return;
+
+        isEvaluated[getIndex(x, y)] = 1;
+        cells.emplace_back(region.Offset + glm::ivec2(x, y));
+    };
+    const auto evaluateQueuedCells = [&]
+    {
+        scratch.CellValues.resize(cells.size());
+        kernel.EvaluatePoints(constants, scratch.RegionEmitters, cells, scratch.CellValues.data());
+        for (size_t i = 0; i < cells.size(); i++)
+        {
+            const auto point = cells[i] - region.Offset;
+            values[getIndex(point.x, point.y)] = scratch.CellValues[i];
+        }
+
+        evaluatedCount += cells.size();
+        cells.clear();
+    };
+
+    // Fills the cells of the block that were not evaluated from its corners, leaving its far edges to the
+    // neighbouring blocks.
+    const auto interpolateBlock = [&](const glm::ivec2 &origin, int step)
+    {
+        const auto c00 = values[getIndex(origin.x, origin.y)];
+        const auto c10 = values[getIndex(origin.x + step, origin.y)];
+        const auto c01 = values[getIndex(origin.x, origin.y + step)];
+        const auto c11 = values[getIndex(origin.x + step, origin.y + step)];
+        const auto invStep = 1.0f / (float)step;
+        for (int j = 0; j < step; j++)
+        {
+            const auto v = (float)j * invStep;
+            const auto left = c00 + (c01 - c00) * v;
+            const auto right = c10 + (c11 - c10) * v;
+            for (int i = 0; i < step; i++)
+            {
+                const auto index = getIndex(origin.x + i, origin.y + j);
+                if (!isEvaluated[index])
+                    values[index] = left + (right - left) * ((float)i * invStep);
+            }
+        }
+    };
+
+    auto &blocks = scratch.Blocks;
+    auto &nextBlocks = scratch.NextBlocks;
+    blocks.clear();
+    for (int y = 0; y <= latticeEnd.y; y += baseStep)
+    {
+        for (int x = 0; x <= latticeEnd.x; x += baseStep)
+        {
+            queueCell(x, y);
+            if (x < latticeEnd.x && y < latticeEnd.y)
+                blocks.emplace_back(x, y);
+        }
+    }
+    evaluateQueuedCells();
+
+    for (int step = baseStep; !blocks.empty(); step /= 2)
+    {
+        const auto half = step / 2;
+        for (const auto &block : blocks)
+        {
+            queueCell(block.x + half, block.y);
+            queueCell(block.x, block.y + half);
+            queueCell(block.x + half, block.y + half);
+            queueCell(block.x + step, block.y + half);
+            queueCell(block.x + half, block.y + step);
+        }
+        evaluateQueuedCells();
+
+        nextBlocks.clear();
+        for (const auto &block : blocks)
+        {
+            // Every cell of a block with a step of 2 has been evaluated by now.
+            if (half == 1)
+                continue;
+
+            const auto sample = [&](int x, int y)
+            {
+                return values[getIndex(block.x + x, block.y + y)];
+            };
+            const auto c00 = sample(0, 0);
+            const auto c10 = sample(step, 0);
+            const auto c01 = sample(0, step);
+            const auto c11 = sample(step, step);
+            const float midpoints[] = {sample(half, 0), sample(0, half), sample(half, half), sample(step, half), sample(half, step)};
+            const float predictions[] = {
+                0.5f * (c00 + c10),
+                0.5f * (c00 + c01),
+                0.25f * (c00 + c10 + c01 + c11),
+                0.5f * (c10 + c11),
+                0.5f * (c01 + c11)};
+
+            float error = 0.0f;
+            for (size_t i = 0; i < std::size(midpoints); i++)
+                error = std::max(error, std::abs(midpoints[i] - predictions[i]));
+
+            if (error <= maxError && !isNearSource(block, step))
+            {
+                // The midpoints are known already, so each quarter is interpolated from its own corners.
+                interpolateBlock(block, half);
+                interpolateBlock(block + glm::ivec2(half, 0), half);
+                interpolateBlock(block + glm::ivec2(0, half), half);
+                interpolateBlock(block + glm::ivec2(half, half), half);
+                continue;
+            }
+
+            // Quarters past the end of the region would only be evaluated to be thrown away.
+            for (const auto &offset : {glm::ivec2(0, 0), glm::ivec2(half, 0), glm::ivec2(0, half), glm::ivec2(half, half)})
+            {
+                if (block.x + offset.x < region.Size.x && block.y + offset.y < region.Size.y)
+                    nextBlocks.emplace_back(block + offset);
+            }
+        }
+        std::swap(blocks, nextBlocks);
+    }
+
+    for (int y = 0; y < region.Size.y; y++)
+        std::copy_n(values.data() + getIndex(0, y), region.Size.x, output + (size_t)y * outputStride);
+
+    return evaluatedCount;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include "PlumeKernel.hpp"
+
+// Controls how far CPUBackend::CalculateAdaptive refines the grid.
+struct AdaptiveOptions
+{
+    // Spacing in cells of the coarsest lattice. A power of two, at least 2.
+    int BaseStep = 16;
+    // Interpolation error allowed per cell, relative to the highest concentration a single emitter reaches on
+    // the grid. Ground-level emitters, whose peak is unbounded, do not count towards that reference.
+    float Tolerance = 1.0e-4f;
+};
+
+struct AdaptiveScratch
+{
+    PreparedEmitters RegionEmitters;
+    // Lattice samples of the region, including one row and column past its end.
+    std::vector<float> Values;
+    std::vector<uint8_t> IsEvaluated;
+    // Summed-area table of the emitters located at each lattice point.
+    std::vector<int> SourceCounts;
+    std::vector<glm::ivec2> Blocks;
+    std::vector<glm::ivec2> NextBlocks;
+    std::vector<glm::ivec2> Cells;
+    std::vector<float> CellValues;
+};
+
+// Evaluates `region` on a lattice of `baseStep`-sized blocks. A block whose edge midpoints and centre are
+// predicted by bilinear interpolation of its corners within max(tolerance, CullingThreshold) is interpolated,
+// any other block is split into four, down to single cells. Blocks containing or bordering an emitter are
+// always split, since the plume switches on abruptly just downwind of its source. Returns the number of cells
+// evaluated with the kernel, which includes the lattice points past the end of the region.
+size_t EvaluateRegionAdaptive(
+    const PlumeKernel &kernel,
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    int baseStep,
+    float tolerance,
+    AdaptiveScratch &scratch,
+    float *output,
+    size_t outputStride);
@@ -0,0 +1,443 @@
+#include "CPUBackend.hpp"
+#include "TileBinning.hpp"
+#include "ScenarioSweep.hpp"
+#include "PlumeKernelISA.hpp"
+#include "../MappedFile.hpp"
+#include "../SimulationIO.hpp"
+#include <bit>
+#include <cmath>
+#include <array>
+#include <future>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+CPUBackend::CPUBackend(size_t threadCount, KernelISA isa)
+    : threadPool_(std::make_unique<ThreadPool>(threadCount)),
+      kernel_(isa)
+{
+}
+
+void CPUBackend::Calculate(const SimulationConfig &config, std::span<const EmitterInfo> emitters)
+{
+    Calculate(config, PlumeKernel::PrepareEmitters(config, emitters));
+}
+
+void CPUBackend::Calculate(const SimulationConfig &config, const PreparedEmitters &emitters)
+{
+    outputSize_ = config.Resolution;
+    output_.resize((size_t)outputSize_.x * (size_t)outputSize_.y);
+    Calculate(config, emitters, output_);
+}
+
+void CPUBackend::Calculate(const SimulationConfig &config, const PreparedEmitters &emitters, std::span<float> output)
+{
+    const auto gridSize = config.Resolution;
+    if (output.size() < (size_t)gridSize.x * (size_t)gridSize.y)
+        throw std::out_of_range("Output is smaller than the simulation resolution.");
+
+    const auto constants = PlumeKernel::PrepareConstants(config);
+    const EmitterClusterTree clusters(emitters, clusterTolerance_);
+    const auto &sources = clusters.IsEnabled() ? clusters.GetSources() : emitters;
+    const auto *tileClusters = clusters.IsEnabled() ? &clusters : nullptr;
+    std::vector<TileScratch> scratch(GetThreadPool().GetThreadCount());
+
+    GetThreadPool().ParallelFor(
+        GetTileCount(gridSize),
+        [&](size_t tileIdx, size_t participantIdx)
+        {
+            const auto region = GetTileRegion(tileIdx, gridSize);
+            EvaluateTile(
+                constants,
+                sources,
+                region,
+                scratch[participantIdx],
+                output.data() + (size_t)region.Offset.y * (size_t)gridSize.x + (size_t)region.Offset.x,
+                (size_t)gridSize.x,
+                tileClusters);
+        });
+}
+
+void CPUBackend::CalculateRows(
+    const SimulationConfig &config,
+    std::span<const EmitterInfo> emitters,
+    int firstRow,
+    int rowCount)
+{
+    CalculateRows(config, PlumeKernel::PrepareEmitters(config, emitters), firstRow, rowCount);
+}
+
+void CPUBackend::CalculateRows(
+    const SimulationConfig &config,
+    const PreparedEmitters &emitters,
+    int firstRow,
+    int rowCount)
+{
+    if (firstRow < 0 || rowCount < 0 || firstRow + rowCount > config.Resolution.y)
+        throw std::out_of_range("Row range exceeds the simulation resolution.");
+
+    outputSize_ = config.Resolution;
+    output_.resize((size_t)outputSize_.x * (size_t)outputSize_.y);
+
+    const auto constants = PlumeKernel::PrepareConstants(config);
+    const EmitterClusterTree clusters(emitters, clusterTolerance_);
+    const auto &sources = clusters.IsEnabled() ? clusters.GetSources() : emitters;
+    const auto *tileClusters = clusters.IsEnabled() ? &clusters : nullptr;
+    std::vector<TileScratch> scratch(GetThreadPool().GetThreadCount());
+
+    const glm::ivec2 bandSize{outputSize_.x, rowCount};
+    GetThreadPool().ParallelFor(
+        GetTileCount(bandSize),
+        [&](size_t tileIdx, size_t participantIdx)
+        {
+            auto region = GetTileRegion(tileIdx, bandSize);
+            region.Offset.y += firstRow;
+            EvaluateTile(
+                constants,
+                sources,
+                region,
+                scratch[participantIdx],
+                GetTileOutput(region),
+                (size_t)outputSize_.x,
+                tileClusters);
+        });
+}
+
+size_t CPUBackend::CalculateAdaptive(
+    const SimulationConfig &config,
+    std::span<const EmitterInfo> emitters,
+    const AdaptiveOptions &options)
+{
+    if (options.BaseStep < 2 || !std::has_single_bit((unsigned)options.BaseStep))
+        throw std::invalid_argument("Adaptive base step must be a power of two of at least 2.");
+
+    outputSize_ = config.Resolution;
+    output_.resize((size_t)outputSize_.x * (size_t)outputSize_.y);
+
+    const auto constants = PlumeKernel::PrepareConstants(config);
+    const auto prepared = PlumeKernel::PrepareEmitters(config, emitters);
+
+    float peak = 0.0f;
+    for (size_t i = 0; i < prepared.GetCount(); i++)
+    {
+        const auto emitterPeak = GetMaxEmitterContribution(constants, prepared, i, GridRegion{{0, 0}, outputSize_});
+        if (emitterPeak < std::numeric_limits<float>::max())
+            peak = std::max(peak, emitterPeak);
+    }
+    const auto tolerance = options.Tolerance * peak;
+
+    std::vector<AdaptiveScratch> scratch(GetThreadPool().GetThreadCount());
+    std::vector<size_t> evaluatedCounts(scratch.size(), 0);
+
+    GetThreadPool().ParallelFor(
+        GetTileCount(),
+        [&](size_t tileIdx, size_t participantIdx)
+        {
+            const auto region = GetTileRegion(tileIdx);
+            evaluatedCounts[participantIdx] += EvaluateRegionAdaptive(
+                kernel_,
+                constants,
+                prepared,
+                region,
+                options.BaseStep,
+                tolerance,
+                scratch[participantIdx],
+                GetTileOutput(region),
+                (size_t)outputSize_.x);
+        });
+
+    return std::accumulate(evaluatedCounts.begin(), evaluatedCounts.end(), (size_t)0);
+}
+
+void CPUBackend::CalculateSweep(
+    std::span<const SimulationConfig> variants,
+    std::span<const EmitterInfo> emitters,
+    std::span<float> output)
+{
+    if (variants.empty())
+        return;
+
+    const auto gridSize = variants.front().Resolution;
+    const auto cellCount = (size_t)gridSize.x * (size_t)gridSize.y;
+    if (output.size() < variants.size() * cellCount)
+        throw std::out_of_range("Sweep output is smaller than the variant count times the simulation resolution.");
+
+    const auto groups = GroupSweepVariants(variants, emitters);
+
+    // Per-column factor turning the shared sum into variant i: 1 / u * exp(-k / u * x).
+    std::vector<float> columnFactors(variants.size() * (size_t)gridSize.x);
+    for (size_t i = 0; i < variants.size(); i++)
+    {
+        const auto constants = PlumeKernel::PrepareConstants(variants[i]);
+        for (int x = 0; x < gridSize.x; x++)
+        {
+            const auto factor = std::exp(-constants.DepositionCoeff * GetCellPositionX(constants, x)) / variants[i].WindSpeed;
+            columnFactors[i * (size_t)gridSize.x + (size_t)x] = factor;
+        }
+    }
+
+    struct SweepScratch
+    {
+        TileScratch Tile;
+        std::array<float, c_CPUTileSize * c_CPUTileSize> Sum;
+    };
+    std::vector<SweepScratch> scratch(GetThreadPool().GetThreadCount());
+
+    const auto tileCount = GetTileCount(gridSize);
+    GetThreadPool().ParallelFor(
+        groups.size() * tileCount,
+        [&](size_t taskIdx, size_t participantIdx)
+        {
+            const auto &group = groups[taskIdx / tileCount];
+            const auto region = GetTileRegion(taskIdx % tileCount, gridSize);
+            auto &[tileScratch, sum] = scratch[participantIdx];
+            EvaluateTile(group.Constants, group.Emitters, region, tileScratch, sum.data(), c_CPUTileSize);
+
+            for (const auto variantIdx : group.Variants)
+            {
+                float *variantOutput = output.data() + variantIdx * cellCount;
+                const float *factors = columnFactors.data() + variantIdx * (size_t)gridSize.x + (size_t)region.Offset.x;
+                for (int y = 0; y < region.Size.y; y++)
+                {
+                    float *outputRow = variantOutput + (size_t)(region.Offset.y + y) * (size_t)gridSize.x + (size_t)region.Offset.x;
+                    const float *sumRow = sum.data() + (size_t)y * c_CPUTileSize;
+                    for (int x = 0; x < region.Size.x; x++)
+                        outputRow[x] = sumRow[x] * factors[x];
+                }
+            }
+        });
+}
+
+void CPUBackend::CalculateToFile(
+    const SimulationConfig &config,
+    std::span<const EmitterInfo> emitters,
+    const std::string_view filepath,
+    int bandHeight)
+{
+    if (bandHeight <= 0)
+        throw std::invalid_argument("Out-of-core band height must be positive.");
+
+    const auto gridSize = config.Resolution;
+    const auto rowSize = (uint64_t)gridSize.x * sizeof(float);
+    const auto header = GetConcentrationGridHeader(gridSize);
+    MappedFile file(std::filesystem::path(filepath), header.size() + rowSize * (uint64_t)gridSize.y);
+
+    {
+        auto headerView = file.Map(0, header.size());
+        std::memcpy(headerView.GetData(), header.data(), header.size());
+    }
+
+    const auto constants = PlumeKernel::PrepareConstants(config);
+    const auto prepared = PlumeKernel::PrepareEmitters(config, emitters);
+    const EmitterClusterTree clusters(prepared, clusterTolerance_);
+    const auto &sources = clusters.IsEnabled() ? clusters.GetSources() : prepared;
+    const auto *tileClusters = clusters.IsEnabled() ? &clusters : nullptr;
+    std::vector<TileScratch> scratch(GetThreadPool().GetThreadCount());
+
+    std::future<void> writeBack;
+    for (int bandY = 0; bandY < gridSize.y; bandY += bandHeight)
+    {
+        const glm::ivec2 bandSize{gridSize.x, std::min(bandHeight, gridSize.y - bandY)};
+        auto view = file.Map(header.size() + rowSize * (uint64_t)bandY, (size_t)(rowSize * (uint64_t)bandSize.y));
+        // The header is padded to a multiple of sizeof(float), so the band starts float-aligned.
+        auto *bandOutput = reinterpret_cast<float*>(view.GetData());
+
+        GetThreadPool().ParallelFor(
+            GetTileCount(bandSize),
+            [&](size_t tileIdx, size_t participantIdx)
+            {
+                auto region = GetTileRegion(tileIdx, bandSize);
+                float *output = bandOutput + (size_t)region.Offset.y * (size_t)gridSize.x + (size_t)region.Offset.x;
+                region.Offset.y += bandY;
+                EvaluateTile(constants, sources, region, scratch[participantIdx], output, (size_t)gridSize.x, tileClusters);
+            });
+
+        // Waiting here keeps at most one band in flight, which bounds the dirty pages held by the OS.
+        if (writeBack.valid())
+            writeBack.get();
+        writeBack = std::async(
+            std::launch::async,
+            [view = std::move(view)]() mutable
+            {
+                view.Flush();
+            });
+    }
+
+    if (writeBack.valid())
+        writeBack.get();
+}
+
+void CPUBackend::EvaluateReceptors(
+    const SimulationConfig &config,
+    std::span<const EmitterInfo> emitters,
+    std::span<const glm::vec2> positions,
+    std::span<float> output)
+{
+    EvaluateReceptors(config, PlumeKernel::PrepareEmitters(config, emitters), positions, output);
+}
+
+void CPUBackend::EvaluateReceptors(
+    const SimulationConfig &config,
+    const PreparedEmitters &emitters,
+    std::span<const glm::vec2> positions,
+    std::span<float> output)
+{
+    if (output.size() < positions.size())
+        throw std::out_of_range("Receptor output is smaller than the receptor count.");
+
+    const auto constants = PlumeKernel::PrepareConstants(config);
+
+    GetThreadPool().ParallelFor(
+        (positions.size() + c_ReceptorBatchSize - 1) / c_ReceptorBatchSize,
+        [&](size_t batchIdx, size_t)
+        {
+            const auto first = batchIdx * c_ReceptorBatchSize;
+            const auto batch = positions.subspan(first, std::min(c_ReceptorBatchSize, positions.size() - first));
+            kernel_.EvaluateReceptors(constants, emitters, batch, output.data() + first);
+        });
+}
+
+float CPUBackend::MeasureKernelError(const SimulationConfig &config, const PreparedEmitters &emitters, size_t sampleCount)
+{
+    const auto tileCount = GetTileCount(config.Resolution);
+    if (tileCount == 0 || sampleCount == 0)
+        return 0.0f;
+
+    // Whole tiles go through the same region kernel as Calculate. Strided rather than random, so that repeated
+    // checks of the same scene report the same error.
+    constexpr auto cellsPerTile = (size_t)c_CPUTileSize * (size_t)c_CPUTileSize;
+    const auto sampledTiles = std::min((sampleCount + cellsPerTile - 1) / cellsPerTile, tileCount);
+    const auto stride = tileCount / sampledTiles;
+    std::vector<GridRegion> regions;
+    regions.reserve(sampledTiles);
+    for (size_t i = 0; i < sampledTiles; i++)
+        regions.emplace_back(GetTileRegion(i * stride, config.Resolution));
+
+    const auto constants = PlumeKernel::PrepareConstants(config);
+    std::vector<float> errors(regions.size());
+    GetThreadPool().ParallelFor(
+        regions.size(),
+        [&](size_t regionIdx, size_t)
+        {
+            errors[regionIdx] = kernel_.MeasureRelativeError(constants, emitters, std::span(&regions[regionIdx], 1));
+        });
+
+    return std::ranges::max(errors);
+}
+
+float CPUBackend::CheckAccuracyBudget(const SimulationConfig &config, const PreparedEmitters &emitters, size_t sampleCount)
+{
+    auto error = MeasureKernelError(config, emitters, sampleCount);
+    while (error > kernel_.GetAccuracyBudget() && kernel_.GetExpDegree() != 0)
+    {
+        kernel_.SelectMoreAccurateVariant();
+        error = MeasureKernelError(config, emitters, sampleCount);
+    }
+
+    return error;
+}
+
+void CPUBackend::EvaluateTile(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    TileScratch &scratch,
+    float *output,
+    size_t outputStride,
+    const EmitterClusterTree *clusters) const
+{
+    // Binning runs in two levels: the whole tile against every emitter, then each bin-sized block
+    // against the emitters that survived the first level. With clusters, `emitters` holds their sources and
+    // every block selects its own, as the smaller the block, the more distant clusters it can approximate.
+    auto &[tileEmitters, blockEmitters, sources] = scratch;
+    if (!clusters)
+        BinEmitters(constants, emitters, region, tileEmitters);
+
+    for (int y = 0; y < region.Size.y; y += c_EmitterBinSize)
+    {
+        for (int x = 0; x < region.Size.x; x += c_EmitterBinSize)
+        {
+            const GridRegion block{
+                region.Offset + glm::ivec2(x, y),
+                glm::min(glm::ivec2(c_EmitterBinSize), region.Size - glm::ivec2(x, y))};
+            if (clusters)
+            {
+                clusters->SelectSources(constants, block, sources);
+                BinEmitters(constants, emitters, sources, block, blockEmitters);
+            }
+            else
+                BinEmitters(constants, tileEmitters, block, blockEmitters);
+            kernel_.Evaluate(constants, blockEmitters, block, output + (size_t)y * outputStride + (size_t)x, outputStride);
+        }
+    }
+}
+
+void CPUBackend::Accumulate(const SimulationConfig &config, std::span<const EmitterInfo> emitters)
+{
+    if (outputSize_ != config.Resolution)
+        throw std::logic_error("Cannot accumulate into an output computed for a different resolution.");
+
+    const auto constants = PlumeKernel::PrepareConstants(config);
+    const auto prepared = PlumeKernel::PrepareEmitters(config, emitters);
+    std::vector<std::array<float, c_CPUTileSize * c_CPUTileSize>> tileScratch(GetThreadPool().GetThreadCount());
+
+    GetThreadPool().ParallelFor(
+        GetTileCount(),
+        [&](size_t tileIdx, size_t participantIdx)
+        {
+            const auto region = GetTileRegion(tileIdx);
+            auto &scratch = tileScratch[participantIdx];
+            kernel_.Evaluate(constants, prepared, region, scratch.data(), c_CPUTileSize);
+
+            float *output = GetTileOutput(region);
+            for (int y = 0; y < region.Size.y; y++)
+            {
+                for (int x = 0; x < region.Size.x; x++)
+                    output[(size_t)y * (size_t)outputSize_.x + x] += scratch[y * c_CPUTileSize + x];
+            }
+        });
+}
+
+void CPUBackend::SetThreadCount(size_t threadCount)
+{
+    if (threadPool_ && threadPool_->GetThreadCount() == threadCount)
+        return;
+
+    threadPool_ = std::make_unique<ThreadPool>(threadCount);
+}
+
+size_t CPUBackend::GetThreadCount() const noexcept
+{
+    return threadPool_ ? threadPool_->GetThreadCount() : ThreadPool::GetDefaultThreadCount();
+}
+
+size_t CPUBackend::GetTileCount(const glm::ivec2 &gridSize) noexcept
+{
+    const auto tilesX = (gridSize.x + c_CPUTileSize - 1) / c_CPUTileSize;
+    const auto tilesY = (gridSize.y + c_CPUTileSize - 1) / c_CPUTileSize;
+
+    return (size_t)tilesX * (size_t)tilesY;
+}
+
+GridRegion CPUBackend::GetTileRegion(size_t tileIdx, const glm::ivec2 &gridSize) noexcept
+{
+    const auto tilesX = (size_t)(gridSize.x + c_CPUTileSize - 1) / c_CPUTileSize;
+    const glm::ivec2 offset{(int)(tileIdx % tilesX) * c_CPUTileSize, (int)(tileIdx / tilesX) * c_CPUTileSize};
+
+    return GridRegion{offset, glm::min(glm::ivec2(c_CPUTileSize), gridSize - offset)};
+}
+
+float* CPUBackend::GetTileOutput(const GridRegion &region) noexcept
+{
+    return output_.data() + (size_t)region.Offset.y * (size_t)outputSize_.x + (size_t)region.Offset.x;
+}
+
+ThreadPool& CPUBackend::GetThreadPool()
+{
+    if (!threadPool_)
+        threadPool_ = std::make_unique<ThreadPool>(0);
+
+    return *threadPool_;
+}
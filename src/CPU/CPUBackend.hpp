@@ -0,0 +1,128 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <glm/vec2.hpp>
+#include "PlumeKernel.hpp"
+#include "AdaptiveRefinement.hpp"
+#include "EmitterClusters.hpp"
+#include "ThreadPool.hpp"
+
+// Edge of the square tiles the grid is split into. A 64x64 float tile (16 KiB) stays in L1/L2 while
+// the emitter loop runs over it.
+constexpr int c_CPUTileSize = 64;
+// Receptors evaluated per task of EvaluateReceptors. Large enough to amortize the scheduling, small enough to
+// balance millions of receptors over the threads.
+constexpr size_t c_ReceptorBatchSize = 4096;
+
+class CPUBackend
+{
+public:
+    CPUBackend() = default;
+    explicit CPUBackend(size_t threadCount, KernelISA isa = PlumeKernel::GetBestSupportedISA());
+    CPUBackend(const CPUBackend&) = delete;
+    CPUBackend(CPUBackend&&) noexcept = default;
+
+    CPUBackend& operator=(CPUBackend&&) noexcept = default;
+
+    void Calculate(const SimulationConfig &config, std::span<const EmitterInfo> emitters);
+    // Like Calculate, but with the emitters already prepared for `config`, e.g. kept up to date by an EmitterStore.
+    void Calculate(const SimulationConfig &config, const PreparedEmitters &emitters);
+    // Like Calculate, but writes the row-major grid to `output`. Leaves GetOutput() untouched.
+    void Calculate(const SimulationConfig &config, const PreparedEmitters &emitters, std::span<float> output);
+    // Computes only rows [firstRow, firstRow + rowCount) of the grid, so that a full calculation can be spread
+    // over several calls. The other rows keep their values, unless the resolution differs from the previous
+    // output, in which case they are undefined until computed.
+    void CalculateRows(const SimulationConfig &config, std::span<const EmitterInfo> emitters, int firstRow, int rowCount);
+    void CalculateRows(const SimulationConfig &config, const PreparedEmitters &emitters, int firstRow, int rowCount);
+    // Adds the contribution of the given emitters to the previous output, which must have been computed for
+    // the same config. Emitters with a negative emission rate remove a contribution added earlier.
+    void Accumulate(const SimulationConfig &config, std::span<const EmitterInfo> emitters);
+    // Like Calculate, but only evaluates the kernel where bilinear interpolation of a coarser lattice is not
+    // accurate enough, see AdaptiveOptions and EvaluateRegionAdaptive. Returns the number of kernel evaluations.
+    size_t CalculateAdaptive(
+        const SimulationConfig &config,
+        std::span<const EmitterInfo> emitters,
+        const AdaptiveOptions &options = {});
+    // Computes every variant in one pass over the grid, writing variant i to
+    // output[i * resolution.x * resolution.y]. Variants must share Size and Resolution; emitter preparation and
+    // tile binning are shared between variants that only differ in WindSpeed or DepositionCoeff.
+    // Leaves GetOutput() untouched.
+    void CalculateSweep(
+        std::span<const SimulationConfig> variants,
+        std::span<const EmitterInfo> emitters,
+        std::span<float> output);
+    // Evaluates the grid in bands of `bandHeight` rows straight into a memory-mapped PFM file, for grids that
+    // do not fit in memory. While one band is computed, the previous one is flushed to disk in the background,
+    // so at most two bands are resident. Leaves GetOutput() untouched.
+    void CalculateToFile(
+        const SimulationConfig &config,
+        std::span<const EmitterInfo> emitters,
+        const std::string_view filepath,
+        int bandHeight = c_CPUTileSize * 4);
+    // Evaluates the plume sum directly at arbitrary positions [m], writing the value at positions[i] to output[i].
+    // Leaves GetOutput() untouched.
+    void EvaluateReceptors(
+        const SimulationConfig &config,
+        std::span<const EmitterInfo> emitters,
+        std::span<const glm::vec2> positions,
+        std::span<float> output);
+    void EvaluateReceptors(
+        const SimulationConfig &config,
+        const PreparedEmitters &emitters,
+        std::span<const glm::vec2> positions,
+        std::span<float> output);
+    void SetThreadCount(size_t threadCount);
+    // Relative error per cell allowed when Calculate, CalculateRows and CalculateToFile approximate distant emitter
+    // clusters, see EmitterClusterTree. 0 evaluates every emitter exactly.
+    void SetClusterTolerance(float tolerance) noexcept { clusterTolerance_ = tolerance; }
+    // Relative error per cell allowed for a fast kernel variant, see PlumeKernel::SetAccuracyBudget(). 0 keeps the
+    // exact kernel.
+    void SetAccuracyBudget(float budget) noexcept { kernel_.SetAccuracyBudget(budget); }
+    // Largest error of the kernel selected by SetAccuracyBudget() relative to the exact one, over whole tiles
+    // spread evenly over the grid of `config` that hold at least `sampleCount` cells together.
+    float MeasureKernelError(const SimulationConfig &config, const PreparedEmitters &emitters, size_t sampleCount = 65536);
+    // Measures the selected kernel like MeasureKernelError() and falls back to more accurate variants, down to the
+    // exact kernel, until the error fits the budget. The declared errors of c_FastKernelVariants hold for typical
+    // scenes only. Returns the error of the kernel kept.
+    float CheckAccuracyBudget(const SimulationConfig &config, const PreparedEmitters &emitters, size_t sampleCount = 65536);
+
+    size_t GetThreadCount() const noexcept;
+    // Also runs host work of the GPU path, so that it does not start a second set of threads.
+    ThreadPool& GetThreadPool();
+    constexpr const PlumeKernel& GetKernel() const noexcept { return kernel_; }
+    constexpr float GetClusterTolerance() const noexcept { return clusterTolerance_; }
+    constexpr float GetAccuracyBudget() const noexcept { return kernel_.GetAccuracyBudget(); }
+    constexpr std::span<const float> GetOutput() const noexcept { return output_; }
+    constexpr glm::ivec2 GetOutputSize() const noexcept { return outputSize_; }
+
+private:
+    struct TileScratch
+    {
+        PreparedEmitters TileEmitters;
+        PreparedEmitters BlockEmitters;
+        std::vector<uint32_t> Sources;
+    };
+
+    std::unique_ptr<ThreadPool> threadPool_;
+    PlumeKernel kernel_;
+    std::vector<float> output_;
+    glm::ivec2 outputSize_ = {0, 0};
+    float clusterTolerance_ = 0.0f;
+
+    size_t GetTileCount() const noexcept { return GetTileCount(outputSize_); }
+    GridRegion GetTileRegion(size_t tileIdx) const noexcept { return GetTileRegion(tileIdx, outputSize_); }
+    float* GetTileOutput(const GridRegion &region) noexcept;
+    void EvaluateTile(
+        const KernelConstants &constants,
+        const PreparedEmitters &emitters,
+        const GridRegion &region,
+        TileScratch &scratch,
+        float *output,
+        size_t outputStride,
+        const EmitterClusterTree *clusters = nullptr) const;
+
+    static size_t GetTileCount(const glm::ivec2 &gridSize) noexcept;
+    static GridRegion GetTileRegion(size_t tileIdx, const glm::ivec2 &gridSize) noexcept;
+};
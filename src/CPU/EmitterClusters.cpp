@@ -0,0 +1,172 @@
+#include "EmitterClusters.hpp"
+#include "PlumeKernelISA.hpp"
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+EmitterClusterTree::EmitterClusterTree(const PreparedEmitters &emitters, float tolerance)
+    : emittersCount_(emitters.GetCount()),
+      maxError_(8.0f * std::max(tolerance, 0.0f))
+{
+    if (emittersCount_ == 0 || maxError_ <= 0.0f)
+        return;
+
+    order_.resize(emittersCount_);
+    std::iota(order_.begin(), order_.end(), 0u);
+
+    // A tree over n emitters split in halves has fewer than 2 * n / (c_ClusterLeafSize / 2) nodes.
+    nodes_.reserve(4 * emittersCount_ / c_ClusterLeafSize + 1);
+    nodes_.emplace_back();
+    Build(emitters, 0, 0, (uint32_t)emittersCount_);
+
+    sources_ = emitters;
+    sources_.Reserve(emittersCount_ + nodes_.size());
+    for (const auto &node : nodes_)
+    {
+        // Weighting by |Q| keeps the centroid inside the cluster when it also holds removed (negative) emitters.
+        // Every invariant but the scale is linear in the position or in H^2, so the centroid carries their mean.
+        double weightSum = 0.0;
+        double scaleSum = 0.0;
+        glm::dvec2 position{0.0};
+        double downwind = 0.0;
+        double heightTerm = 0.0;
+        for (auto i = node.Begin; i < node.End; i++)
+        {
+            const auto emitterIdx = order_[i];
+            const auto weight = (double)std::abs(emitters.Scale[emitterIdx]);
+            weightSum += weight;
+            scaleSum += emitters.Scale[emitterIdx];
+            position += weight * glm::dvec2(emitters.X[emitterIdx], emitters.Y[emitterIdx]);
+            downwind += weight * emitters.Downwind[emitterIdx];
+            heightTerm += weight * emitters.HeightTerm[emitterIdx];
+        }
+
+        if (weightSum > 0.0)
+        {
+            sources_.X.emplace_back((float)(position.x / weightSum));
+            sources_.Y.emplace_back((float)(position.y / weightSum));
+            sources_.Downwind.emplace_back((float)(downwind / weightSum));
+            sources_.Scale.emplace_back((float)scaleSum);
+            sources_.HeightTerm.emplace_back((float)(heightTerm / weightSum));
+        }
+        else
+        {
+            sources_.Append(emitters, order_[node.Begin]);
+            sources_.Scale.back() = 0.0f;
+        }
+    }
+}
+
+void EmitterClusterTree::Build(const PreparedEmitters &emitters, uint32_t nodeIdx, uint32_t begin, uint32_t end)
+{
+    const auto &downwind = emitters.Downwind;
+    const auto &heightTerms = emitters.HeightTerm;
+    Node node{
+        .DownwindMin = downwind[order_[begin]],
+        .DownwindMax = downwind[order_[begin]],
+        .HeightTermMin = heightTerms[order_[begin]],
+        .HeightTermMax = heightTerms[order_[begin]],
+        .Begin = begin,
+        .End = end,
+        .FirstChild = 0,
+    };
+    for (auto i = begin; i < end; i++)
+    {
+        node.DownwindMin = std::min(node.DownwindMin, downwind[order_[i]]);
+        node.DownwindMax = std::max(node.DownwindMax, downwind[order_[i]]);
+        node.HeightTermMin = std::min(node.HeightTermMin, heightTerms[order_[i]]);
+        node.HeightTermMax = std::max(node.HeightTermMax, heightTerms[order_[i]]);
+    }
+
+    if (end - begin > c_ClusterLeafSize)
+    {
+        // A node only passes SelectSources() once both its extents are small for the distance, so it is split
+        // along the one that dominates the error at the distance where the downwind extent alone would pass.
+        const auto downwindExtent = node.DownwindMax - node.DownwindMin;
+        const auto heightTermExtent = node.HeightTermMax - node.HeightTermMin;
+        const auto passDistance = downwindExtent * std::sqrt(6.0f / maxError_);
+        const auto &keys = heightTermExtent > std::sqrt(6.0f) * downwindExtent * passDistance ? heightTerms : downwind;
+
+        const auto mid = begin + (end - begin) / 2;
+        std::nth_element(
+            order_.begin() + begin,
+            order_.begin() + mid,
+            order_.begin() + end,
+            [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+        // Children are stored next to each other, so a node only needs the index of the first one.
+        node.FirstChild = (uint32_t)nodes_.size();
+        nodes_.resize(nodes_.size() + 2);
+        Build(emitters, node.FirstChild, begin, mid);
+        Build(emitters, node.FirstChild + 1, mid, end);
+    }
+
+    nodes_[nodeIdx] = node;
+}
+
+void EmitterClusterTree::SelectSources(const KernelConstants &constants, const GridRegion &region, std::vector<uint32_t> &sources) const
+{
+    sources.clear();
+    if (nodes_.empty())
+        return;
+
+    const glm::vec2 lo{
+        GetCellPositionX(constants, region.Offset.x),
+        GetCellPositionY(constants, region.Offset.y)};
+    const glm::vec2 hi{
+        GetCellPositionX(constants, region.Offset.x + region.Size.x - 1),
+        GetCellPositionY(constants, region.Offset.y + region.Size.y - 1)};
+
+    // Position of the region cells along the wind axis; as in GetMaxEmitterContribution() its extremes lie on
+    // the corners.
+    const auto cellDownwindMin = std::min(lo.x * constants.CosWindDir, hi.x * constants.CosWindDir)
+        + std::min(lo.y * constants.SinWindDir, hi.y * constants.SinWindDir);
+    const auto cellDownwindMax = std::max(lo.x * constants.CosWindDir, hi.x * constants.CosWindDir)
+        + std::max(lo.y * constants.SinWindDir, hi.y * constants.SinWindDir);
+    const auto lateralMin = lo.y <= 0.0f && hi.y >= 0.0f ? 0.0f : std::min(lo.y * lo.y, hi.y * hi.y) * constants.LateralCoeff;
+    const auto lateralMax = std::max(lo.y * lo.y, hi.y * hi.y) * constants.LateralCoeff;
+
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize != 0)
+    {
+        const auto nodeIdx = stack[--stackSize];
+        const auto &node = nodes_[nodeIdx];
+        if (node.DownwindMin >= cellDownwindMax)
+            continue;
+
+        // Far off the centreline the exponent of every emitter underflows, which the SIMD kernels and the shader
+        // turn into exactly 0.
+        const auto farthest = cellDownwindMax - node.DownwindMin;
+        if (lateralMin + node.HeightTermMin > -c_KernelUnderflowExponent * farthest * farthest)
+            continue;
+
+        if (node.DownwindMax < cellDownwindMin)
+        {
+            // With g(d) = exp(-A / d^2) / d^2 and a = A / d^2, |g'' / g| <= (6 + 14a + 4a^2) / d^2, so replacing
+            // the emitters by their centroid is off by at most (6 + 14a + 4a^2) * extent^2 / (8 * d^2) relative
+            // to the sum, and the mean height term by (heightTermExtent / d^2)^2 / 8. Both are combined
+            // conservatively and bounded over the region by the nearest cell and the largest lateral offset.
+            const auto distance = cellDownwindMin - node.DownwindMax;
+            const auto invDistanceSq = 1.0f / (distance * distance);
+            const auto a = (lateralMax + node.HeightTermMax) * invDistanceSq;
+            const auto error = std::sqrt(6.0f + 14.0f * a + 4.0f * a * a) * (node.DownwindMax - node.DownwindMin) / distance
+                + (node.HeightTermMax - node.HeightTermMin) * invDistanceSq;
+            if (error * error <= maxError_)
+            {
+                sources.emplace_back((uint32_t)emittersCount_ + nodeIdx);
+                continue;
+            }
+        }
+
+        if (node.FirstChild == 0)
+        {
+            sources.insert(sources.end(), order_.begin() + node.Begin, order_.begin() + node.End);
+            continue;
+        }
+
+        stack[stackSize++] = node.FirstChild;
+        stack[stackSize++] = node.FirstChild + 1;
+    }
+}
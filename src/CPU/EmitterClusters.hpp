@@ -0,0 +1,59 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstdint>
+#include "PlumeKernel.hpp"
+
+// Largest number of emitters in a leaf of EmitterClusterTree; leaves are always evaluated exactly.
+constexpr uint32_t c_ClusterLeafSize = 8;
+
+// Hierarchy of emitter clusters for a Barnes-Hut style far-field approximation of the plume sum.
+//
+// The lateral term of the kernel is measured from the grid centreline, so an emitter only enters the sum of a
+// cell through its position along the wind axis, its scale and its height term. The tree is therefore a k-d tree
+// over those two coordinates, and every node carries an aggregate pseudo-emitter placed at the rate-weighted
+// centroid of its emitters, with their total scale and the rate-weighted mean of their height terms.
+class EmitterClusterTree
+{
+public:
+    EmitterClusterTree() = default;
+    // `tolerance` is the relative error of the plume sum allowed per cell, 0 disables the approximation.
+    EmitterClusterTree(const PreparedEmitters &emitters, float tolerance);
+
+    // Replaces `sources` with indices into GetSources() whose sum approximates every emitter for all cells of
+    // `region`. Distant clusters are taken as their pseudo-emitter when a second-order estimate of the error
+    // stays within the tolerance, nearby ones are opened down to the exact emitters. Clusters the whole region
+    // is upwind of, or whose exponent underflows everywhere in it, are left out, as they contribute exactly 0.
+    void SelectSources(const KernelConstants &constants, const GridRegion &region, std::vector<uint32_t> &sources) const;
+
+    // The exact emitters in their original order, followed by one pseudo-emitter per cluster.
+    constexpr const PreparedEmitters& GetSources() const noexcept { return sources_; }
+    constexpr size_t GetEmittersCount() const noexcept { return emittersCount_; }
+    constexpr bool IsEnabled() const noexcept { return maxError_ > 0.0f && !nodes_.empty(); }
+
+private:
+    struct Node
+    {
+        // Extent of the emitters along the wind axis [m].
+        float DownwindMin;
+        float DownwindMax;
+        // Extent of H^2 / (2 * sigmaZ^2) of the emitters.
+        float HeightTermMin;
+        float HeightTermMax;
+        // Range of order_ covered by the node.
+        uint32_t Begin;
+        uint32_t End;
+        // Index of the first of the two children, 0 for leaves.
+        uint32_t FirstChild;
+    };
+
+    std::vector<Node> nodes_;
+    // Emitter indices, partitioned so that every node covers a contiguous range.
+    std::vector<uint32_t> order_;
+    PreparedEmitters sources_;
+    size_t emittersCount_ = 0;
+    // 8 * tolerance, see SelectSources().
+    float maxError_ = 0.0f;
+
+    void Build(const PreparedEmitters &emitters, uint32_t nodeIdx, uint32_t begin, uint32_t end);
+};
@@ -0,0 +1,398 @@
+#include "PlumeKernel.hpp"
+#include "PlumeKernelISA.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <numbers>
+#include <format>
+#include <algorithm>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+static bool HasCPUFeatures(bool avx512) noexcept
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osxsave || !fma)
+        return false;
+
+    const auto xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if (!avx512)
+        return (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+
+    return (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+}
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+static bool HasCPUFeatures(bool avx512) noexcept
+{
+    __builtin_cpu_init();
+    if (!avx512)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+    return __builtin_cpu_supports("avx512f");
+}
+#else
+static bool HasCPUFeatures(bool) noexcept
+{
+    return false;
+}
+#endif
+
+KernelConstants PlumeKernel::PrepareConstants(const SimulationConfig &config) noexcept
+{
+    return KernelConstants{
+        .Size = config.Size,
+        .Resolution = config.Resolution,
+        .CosWindDir = std::cos(config.WindDir),
+        .SinWindDir = std::sin(config.WindDir),
+        .LateralCoeff = 1.0f / (2.0f * config.Stability.x * config.Stability.x),
+        .DepositionCoeff = config.DepositionCoeff / config.WindSpeed,
+        .CullingThreshold = config.CullingThreshold,
+        .ExpDegree = 0,
+        .ExpCutoff = c_KernelUnderflowExponent,
+    };
+}
+
+EmitterFactors PlumeKernel::PrepareEmitterFactors(const SimulationConfig &config) noexcept
+{
+    return EmitterFactors{
+        .CosWindDir = std::cos(config.WindDir),
+        .SinWindDir = std::sin(config.WindDir),
+        .ScaleDenominator = 2.0f * std::numbers::pi_v<float> * config.WindSpeed * config.Stability.x * config.Stability.y,
+        .HeightDenominator = 2.0f * config.Stability.y * config.Stability.y,
+    };
+}
+
+PreparedEmitters PlumeKernel::PrepareEmitters(const SimulationConfig &config, std::span<const EmitterInfo> emitters)
+{
+    PreparedEmitters prepared;
+    prepared.Reserve(emitters.size());
+
+    const auto factors = PrepareEmitterFactors(config);
+    for (const auto &emitter : emitters)
+        prepared.Append(factors, emitter.Position, emitter.EmissionRate, emitter.Height);
+
+    return prepared;
+}
+
+void PreparedEmitters::Clear() noexcept
+{
+    X.clear();
+    Y.clear();
+    Downwind.clear();
+    Scale.clear();
+    HeightTerm.clear();
+}
+
+void PreparedEmitters::Reserve(size_t count)
+{
+    X.reserve(count);
+    Y.reserve(count);
+    Downwind.reserve(count);
+    Scale.reserve(count);
+    HeightTerm.reserve(count);
+}
+
+void PreparedEmitters::Append(const EmitterFactors &factors, const glm::vec2 &position, float emissionRate, float height)
+{
+    X.emplace_back(position.x);
+    Y.emplace_back(position.y);
+    Downwind.emplace_back(position.x * factors.CosWindDir + position.y * factors.SinWindDir);
+    Scale.emplace_back(emissionRate / factors.ScaleDenominator);
+    HeightTerm.emplace_back(height * height / factors.HeightDenominator);
+}
+
+void PreparedEmitters::Append(const PreparedEmitters &other, size_t emitterIdx)
+{
+    X.emplace_back(other.X[emitterIdx]);
+    Y.emplace_back(other.Y[emitterIdx]);
+    Downwind.emplace_back(other.Downwind[emitterIdx]);
+    Scale.emplace_back(other.Scale[emitterIdx]);
+    HeightTerm.emplace_back(other.HeightTerm[emitterIdx]);
+}
+
+void PreparedEmitters::Set(
+    size_t emitterIdx,
+    const EmitterFactors &factors,
+    const glm::vec2 &position,
+    float emissionRate,
+    float height) noexcept
+{
+    X[emitterIdx] = position.x;
+    Y[emitterIdx] = position.y;
+    Downwind[emitterIdx] = position.x * factors.CosWindDir + position.y * factors.SinWindDir;
+    Scale[emitterIdx] = emissionRate / factors.ScaleDenominator;
+    HeightTerm[emitterIdx] = height * height / factors.HeightDenominator;
+}
+
+void PreparedEmitters::Erase(size_t emitterIdx)
+{
+    X.erase(X.begin() + emitterIdx);
+    Y.erase(Y.begin() + emitterIdx);
+    Downwind.erase(Downwind.begin() + emitterIdx);
+    Scale.erase(Scale.begin() + emitterIdx);
+    HeightTerm.erase(HeightTerm.begin() + emitterIdx);
+}
+
+PlumeKernel::PlumeKernel(KernelISA isa)
+    : isa_(isa)
+{
+    if (!IsISASupported(isa))
+        throw std::runtime_error(std::format("Kernel ISA {} is not supported on this CPU.", GetISAName(isa)));
+}
+
+void PlumeKernel::Evaluate(const SimulationConfig &config, std::span<const EmitterInfo> emitters, std::span<float> output) const
+{
+    if (output.size() < (size_t)config.Resolution.x * (size_t)config.Resolution.y)
+        throw std::out_of_range("Output grid is smaller than the simulation resolution.");
+
+    Evaluate(config, emitters, GridRegion{{0, 0}, config.Resolution}, output.data(), (size_t)config.Resolution.x);
+}
+
+void PlumeKernel::Evaluate(
+    const SimulationConfig &config,
+    std::span<const EmitterInfo> emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) const
+{
+    Evaluate(PrepareConstants(config), PrepareEmitters(config, emitters), region, output, outputStride);
+}
+
+// Flushes denormal operands and results to zero on the calling thread while a fast variant runs. Contributions
+// that small are far below c_KernelAbsoluteTolerance, but every one of them costs a microcode assist on x86,
+// enough to cancel the gain of the cheaper exp. The exact kernel keeps the floating-point mode of the caller.
+class DenormalFlushScope
+{
+public:
+    explicit DenormalFlushScope(bool enable) noexcept
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        if (!enable)
+            return;
+
+        // FTZ (bit 15) and DAZ (bit 6) of MXCSR.
+        csr_ = _mm_getcsr();
+        _mm_setcsr(csr_ | 0x8040u);
+        isEnabled_ = true;
+#endif
+    }
+    DenormalFlushScope(const DenormalFlushScope&) = delete;
+
+    ~DenormalFlushScope() noexcept
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        if (isEnabled_)
+            _mm_setcsr(csr_);
+#endif
+    }
+
+private:
+    unsigned int csr_ = 0;
+    bool isEnabled_ = false;
+};
+
+void PlumeKernel::Evaluate(
+    const KernelConstants &constants,
+    const PreparedEmitters &prepared,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) const noexcept
+{
+    const DenormalFlushScope flushDenormals(expDegree_ != 0);
+    switch (isa_)
+    {
+    case KernelISA::AVX512:
+        EvaluateRegionAVX512(WithExpDegree(constants), prepared, region, output, outputStride);
+        break;
+    case KernelISA::AVX2:
+        EvaluateRegionAVX2(WithExpDegree(constants), prepared, region, output, outputStride);
+        break;
+    default:
+        EvaluateRegionScalar(WithExpDegree(constants), prepared, region, output, outputStride);
+        break;
+    }
+}
+
+void PlumeKernel::EvaluatePoints(
+    const KernelConstants &constants,
+    const PreparedEmitters &prepared,
+    std::span<const glm::ivec2> cells,
+    float *output) const noexcept
+{
+    const DenormalFlushScope flushDenormals(expDegree_ != 0);
+    switch (isa_)
+    {
+    case KernelISA::AVX512:
+        EvaluatePointsAVX512(WithExpDegree(constants), prepared, cells, output);
+        break;
+    case KernelISA::AVX2:
+        EvaluatePointsAVX2(WithExpDegree(constants), prepared, cells, output);
+        break;
+    default:
+        EvaluatePointsScalar(WithExpDegree(constants), prepared, cells, output);
+        break;
+    }
+}
+
+void PlumeKernel::EvaluateReceptors(
+    const KernelConstants &constants,
+    const PreparedEmitters &prepared,
+    std::span<const glm::vec2> positions,
+    float *output) const noexcept
+{
+    const DenormalFlushScope flushDenormals(expDegree_ != 0);
+    switch (isa_)
+    {
+    case KernelISA::AVX512:
+        EvaluateReceptorsAVX512(WithExpDegree(constants), prepared, positions, output);
+        break;
+    case KernelISA::AVX2:
+        EvaluateReceptorsAVX2(WithExpDegree(constants), prepared, positions, output);
+        break;
+    default:
+        EvaluateReceptorsScalar(WithExpDegree(constants), prepared, positions, output);
+        break;
+    }
+}
+
+void PlumeKernel::SetAccuracyBudget(float budget) noexcept
+{
+    accuracyBudget_ = budget;
+    expDegree_ = SelectExpDegree(budget);
+}
+
+float PlumeKernel::MeasureRelativeError(
+    const KernelConstants &constants,
+    const PreparedEmitters &prepared,
+    std::span<const GridRegion> regions) const
+{
+    if (expDegree_ == 0)
+        return 0.0f;
+
+    const PlumeKernel exact(isa_);
+    std::vector<float> expected;
+    std::vector<float> actual;
+    float maxError = 0.0f;
+    for (const auto &region : regions)
+    {
+        const auto cellsCount = (size_t)region.Size.x * (size_t)region.Size.y;
+        expected.resize(cellsCount);
+        actual.resize(cellsCount);
+        exact.Evaluate(constants, prepared, region, expected.data(), (size_t)region.Size.x);
+        Evaluate(constants, prepared, region, actual.data(), (size_t)region.Size.x);
+
+        for (size_t i = 0; i < cellsCount; i++)
+        {
+            if (std::abs(expected[i]) >= c_KernelAbsoluteTolerance)
+                maxError = std::max(maxError, std::abs(actual[i] - expected[i]) / std::abs(expected[i]));
+        }
+    }
+
+    return maxError;
+}
+
+int PlumeKernel::SelectExpDegree(float budget) noexcept
+{
+    // The variants are ordered from the fastest, least accurate one.
+    for (const auto &variant : c_FastKernelVariants)
+    {
+        if (variant.MaxRelativeError <= budget)
+            return variant.ExpDegree;
+    }
+
+    return 0;
+}
+
+float PlumeKernel::GetExpCutoff(float budget) noexcept
+{
+    if (!(budget > 0.0f))
+        return c_KernelUnderflowExponent;
+
+    return std::max(c_KernelUnderflowExponent, std::log(budget * c_KernelAbsoluteTolerance));
+}
+
+int PlumeKernel::GetMoreAccurateExpDegree(int expDegree) noexcept
+{
+    const auto variant = std::ranges::find(c_FastKernelVariants, expDegree, &FastKernelVariant::ExpDegree);
+    return variant != c_FastKernelVariants.end() && variant + 1 != c_FastKernelVariants.end()
+        ? (variant + 1)->ExpDegree
+        : 0;
+}
+
+std::span<const float> PlumeKernel::GetExp2Coefficients(int expDegree) noexcept
+{
+    switch (expDegree)
+    {
+    case 2:
+        return c_Exp2Coefficients<2>;
+    case 3:
+        return c_Exp2Coefficients<3>;
+    case 4:
+        return c_Exp2Coefficients<4>;
+    default:
+        return {};
+    }
+}
+
+KernelConstants PlumeKernel::WithExpDegree(const KernelConstants &constants) const noexcept
+{
+    auto result = constants;
+    result.ExpDegree = expDegree_;
+    result.ExpCutoff = GetExpCutoff(accuracyBudget_);
+
+    return result;
+}
+
+KernelISA PlumeKernel::GetBestSupportedISA() noexcept
+{
+    if (IsISASupported(KernelISA::AVX512))
+        return KernelISA::AVX512;
+    if (IsISASupported(KernelISA::AVX2))
+        return KernelISA::AVX2;
+
+    return KernelISA::Scalar;
+}
+
+bool PlumeKernel::IsISASupported(KernelISA isa) noexcept
+{
+    switch (isa)
+    {
+    case KernelISA::Scalar:
+        return true;
+#ifdef EMISSIONS_KERNEL_AVX2
+    case KernelISA::AVX2:
+        return HasCPUFeatures(false);
+#endif
+#ifdef EMISSIONS_KERNEL_AVX512
+    case KernelISA::AVX512:
+        return HasCPUFeatures(true);
+#endif
+    default:
+        return false;
+    }
+}
+
+const char *PlumeKernel::GetISAName(KernelISA isa) noexcept
+{
+    switch (isa)
+    {
+    case KernelISA::AVX2:
+        return "AVX2";
+    case KernelISA::AVX512:
+        return "AVX-512";
+    default:
+        return "Scalar";
+    }
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include <span>
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <glm/vec2.hpp>
+#include "../SimulationConfig.hpp"
+#include "../EmitterInfo.hpp"
+
+// Largest per-cell difference between the CPU kernel and MainCompute.glsl, relative to the cell value.
+// Cells whose value is below c_KernelAbsoluteTolerance are only compared absolutely, as both
+// implementations lose precision once the exponent approaches float underflow.
+constexpr float c_KernelRelativeTolerance = 1.0e-4f;
+constexpr float c_KernelAbsoluteTolerance = 1.0e-30f;
+// Exponent of the plume kernel below which exp() underflows to 0 in single precision.
+constexpr float c_KernelUnderflowExponent = -87.33654f;
+
+// Fast variants of the kernel, see PlumeKernel::SetAccuracyBudget(). They evaluate exp as 2^n times a minimax
+// polynomial of degree ExpDegree on [-1/2, 1/2], skip emitters whose exponent is below KernelConstants::ExpCutoff
+// for every lane, apply the deposition factor once per cell instead of per emitter and flush denormals to zero.
+// MaxRelativeError is the declared per-cell error relative to the exact kernel, for cells above
+// c_KernelAbsoluteTolerance: the polynomial error plus the rounding of the approximate reciprocal, which
+// the exponent amplifies up to ExpCutoff times.
+struct FastKernelVariant
+{
+    int ExpDegree;
+    float MaxRelativeError;
+};
+
+constexpr std::array<FastKernelVariant, 3> c_FastKernelVariants{{
+    {2, 2.0e-3f},
+    {3, 1.5e-4f},
+    {4, 5.0e-5f},
+}};
+
+enum class KernelISA
+{
+    Scalar,
+    AVX2,
+    AVX512,
+};
+
+struct GridRegion
+{
+    glm::ivec2 Offset;
+    glm::ivec2 Size;
+};
+
+// Config-dependent factors of PreparedEmitters, see PlumeKernel::PrepareEmitterFactors().
+struct EmitterFactors
+{
+    float CosWindDir;
+    float SinWindDir;
+    float ScaleDenominator;  // 2 * pi * u * sigmaY * sigmaZ
+    float HeightDenominator; // 2 * sigmaZ^2
+
+    bool operator==(const EmitterFactors &other) const noexcept = default;
+};
+
+// Emitter constants of the plume equation, precomputed once per evaluation in SoA layout so that
+// the inner loop of every ISA only needs broadcasts and fused multiply-adds.
+struct PreparedEmitters
+{
+    std::vector<float> X;
+    std::vector<float> Y;
+    std::vector<float> Downwind;   // Position along the wind axis, X * cos(windDir) + Y * sin(windDir)
+    std::vector<float> Scale;      // Q / (2 * pi * u * sigmaY * sigmaZ)
+    std::vector<float> HeightTerm; // H^2 / (2 * sigmaZ^2)
+
+    constexpr size_t GetCount() const noexcept { return X.size(); }
+
+    void Clear() noexcept;
+    void Reserve(size_t count);
+    void Append(const EmitterFactors &factors, const glm::vec2 &position, float emissionRate, float height);
+    // Copies emitter `emitterIdx` of `other` to the end.
+    void Append(const PreparedEmitters &other, size_t emitterIdx);
+    void Set(size_t emitterIdx, const EmitterFactors &factors, const glm::vec2 &position, float emissionRate, float height) noexcept;
+    void Erase(size_t emitterIdx);
+};
+
+struct KernelConstants
+{
+    glm::vec2 Size;
+    glm::ivec2 Resolution;
+    float CosWindDir;
+    float SinWindDir;
+    float LateralCoeff;    // 1 / (2 * sigmaY^2)
+    float DepositionCoeff; // k / u
+    float CullingThreshold;
+    // Degree of the exp polynomial of a fast variant, 0 for the exact kernel. Set by PlumeKernel from its budget.
+    int ExpDegree;
+    // Exponent below which a fast variant skips an emitter, see PlumeKernel::GetExpCutoff(). Unused by the exact kernel.
+    float ExpCutoff;
+};
+
+class PlumeKernel
+{
+public:
+    PlumeKernel() noexcept
+        : PlumeKernel(GetBestSupportedISA()) { }
+    PlumeKernel(KernelISA isa);
+
+    void Evaluate(const SimulationConfig &config, std::span<const EmitterInfo> emitters, std::span<float> output) const;
+    void Evaluate(
+        const SimulationConfig &config,
+        std::span<const EmitterInfo> emitters,
+        const GridRegion &region,
+        float *output,
+        size_t outputStride) const;
+    void Evaluate(
+        const KernelConstants &constants,
+        const PreparedEmitters &emitters,
+        const GridRegion &region,
+        float *output,
+        size_t outputStride) const noexcept;
+    // Evaluates scattered cells, writing the value of cells[i] to output[i].
+    void EvaluatePoints(
+        const KernelConstants &constants,
+        const PreparedEmitters &emitters,
+        std::span<const glm::ivec2> cells,
+        float *output) const noexcept;
+    // Evaluates arbitrary positions [m] in the grid frame, writing the value at positions[i] to output[i].
+    void EvaluateReceptors(
+        const KernelConstants &constants,
+        const PreparedEmitters &emitters,
+        std::span<const glm::vec2> positions,
+        float *output) const noexcept;
+
+    // Selects the fastest variant of c_FastKernelVariants whose declared error is within `budget`, relative to the
+    // exact kernel. A budget below every declared error, such as 0, selects the exact kernel.
+    void SetAccuracyBudget(float budget) noexcept;
+    // Replaces the selected variant by the next more accurate one, see GetMoreAccurateExpDegree(), keeping the
+    // budget. For scenes where MeasureRelativeError() exceeds the budget.
+    void SelectMoreAccurateVariant() noexcept { expDegree_ = GetMoreAccurateExpDegree(expDegree_); }
+    // Largest error of the selected variant relative to the exact kernel over every cell of `regions`, ignoring
+    // cells below c_KernelAbsoluteTolerance. The regions are evaluated like grids are, so this checks the declared
+    // error of the variant against the actual config and emitters.
+    float MeasureRelativeError(
+        const KernelConstants &constants,
+        const PreparedEmitters &emitters,
+        std::span<const GridRegion> regions) const;
+
+    constexpr KernelISA GetISA() const noexcept { return isa_; }
+    constexpr float GetAccuracyBudget() const noexcept { return accuracyBudget_; }
+    constexpr int GetExpDegree() const noexcept { return expDegree_; }
+
+    static KernelConstants PrepareConstants(const SimulationConfig &config) noexcept;
+    static EmitterFactors PrepareEmitterFactors(const SimulationConfig &config) noexcept;
+    static PreparedEmitters PrepareEmitters(const SimulationConfig &config, std::span<const EmitterInfo> emitters);
+    static KernelISA GetBestSupportedISA() noexcept;
+    // Degree of the exp polynomial of the variant SetAccuracyBudget(budget) selects, 0 for the exact kernel.
+    static int SelectExpDegree(float budget) noexcept;
+    // Exponent below which the fast variants skip an emitter under `budget`: the plume factor exp(exponent) is then
+    // below budget * c_KernelAbsoluteTolerance, so a larger budget skips more of the far tail of each plume. Never
+    // below c_KernelUnderflowExponent, where exp() underflows anyway.
+    static float GetExpCutoff(float budget) noexcept;
+    // Degree of the variant following the one of degree `expDegree` in c_FastKernelVariants, 0 for the exact kernel
+    // after the last one.
+    static int GetMoreAccurateExpDegree(int expDegree) noexcept;
+    // Coefficients of the exp2 polynomial of degree `expDegree`, constant term first, so that MainCompute.glsl
+    // evaluates the same polynomial as the CPU. Empty for degrees without a fast variant.
+    static std::span<const float> GetExp2Coefficients(int expDegree) noexcept;
+    static bool IsISASupported(KernelISA isa) noexcept;
+    static const char *GetISAName(KernelISA isa) noexcept;
+
+private:
+    KernelISA isa_;
+    float accuracyBudget_ = 0.0f;
+    int expDegree_ = 0;
+
+    KernelConstants WithExpDegree(const KernelConstants &constants) const noexcept;
+};
@@ -0,0 +1,283 @@
+#include "PlumeKernelISA.hpp"
+#ifdef EMISSIONS_KERNEL_AVX2
+#include <immintrin.h>
+#include <algorithm>
+
+// Only the functions marked with this are compiled for AVX2 and FMA. Building the whole file with the wider instruction
+// set would also encode the inline functions it shares with the rest of the program (glm, std::vector and
+// PlumeKernelISA.hpp) with it, and the linker is free to keep that copy for every caller. MSVC accepts the
+// intrinsics without /arch, so it needs no marking.
+#if defined(__GNUC__)
+#define EMISSIONS_AVX2_TARGET __attribute__((target("avx2,fma")))
+#else
+#define EMISSIONS_AVX2_TARGET
+#endif
+
+// Cephes-style single precision exp, accurate to about 2 ULP over the range used by the kernel.
+// Inputs below the float underflow threshold produce exactly 0, as on the GPU.
+EMISSIONS_AVX2_TARGET static inline __m256 Exp(__m256 x) noexcept
+{
+    const auto underflow = _mm256_cmp_ps(x, _mm256_set1_ps(c_KernelUnderflowExponent), _CMP_LT_OQ);
+    x = _mm256_min_ps(x, _mm256_set1_ps(88.0f));
+
+    const auto n = _mm256_round_ps(
+        _mm256_mul_ps(x, _mm256_set1_ps(c_Log2E)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    auto r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+
+    auto p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+    const auto exponent = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+    const auto scale = _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+
+    return _mm256_andnot_ps(underflow, _mm256_mul_ps(p, scale));
+}
+
+// 2^t as 2^round(t) times the minimax polynomial of the remainder, for t above the exponent cutoff.
+template<int ExpDegree>
+EMISSIONS_AVX2_TARGET static inline __m256 FastExp2(__m256 t) noexcept
+{
+    const auto &coefficients = c_Exp2Coefficients<ExpDegree>;
+    const auto n = _mm256_round_ps(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const auto f = _mm256_sub_ps(t, n);
+
+    auto p = _mm256_set1_ps(coefficients[ExpDegree]);
+    for (int i = ExpDegree - 1; i >= 0; i--)
+        p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(coefficients[i]));
+
+    // Adding n to the biased exponent field scales by 2^n without building the power separately.
+    return _mm256_castsi256_ps(_mm256_add_epi32(
+        _mm256_castps_si256(p),
+        _mm256_slli_epi32(_mm256_cvtps_epi32(n), 23)));
+}
+
+// Sum of the contributions of every emitter to the lanes at windX, lateral offset term `lateral` and deposition
+// exponent `deposition`. The fast variants skip emitters whose exponent is below `expCutoff` for every lane.
+template<bool HasDeposition, int ExpDegree>
+EMISSIONS_AVX2_TARGET static inline __m256 SumEmitters(
+    const PreparedEmitters &emitters,
+    __m256 windX,
+    __m256 lateral,
+    __m256 deposition,
+    float expCutoff) noexcept
+{
+    const auto emittersCount = emitters.GetCount();
+    const auto one = _mm256_set1_ps(1.0f);
+    const auto zero = _mm256_setzero_ps();
+
+    auto concentration = _mm256_setzero_ps();
+    if constexpr (ExpDegree != 0)
+    {
+        const auto two = _mm256_set1_ps(2.0f);
+        const auto cutoff = _mm256_set1_ps(expCutoff);
+        const auto log2e = _mm256_set1_ps(c_Log2E);
+        for (size_t i = 0; i < emittersCount; i++)
+        {
+            const auto downwind = _mm256_sub_ps(windX, _mm256_set1_ps(emitters.Downwind[i]));
+            const auto isDownwind = _mm256_cmp_ps(downwind, zero, _CMP_GT_OQ);
+            if (_mm256_movemask_ps(isDownwind) == 0)
+                continue;
+
+            // Approximate reciprocal refined by one Newton step, about 23 bits instead of a division.
+            const auto downwindSq = _mm256_mul_ps(downwind, downwind);
+            const auto estimate = _mm256_rcp_ps(downwindSq);
+            const auto invDownwindSq = _mm256_mul_ps(estimate, _mm256_fnmadd_ps(downwindSq, estimate, two));
+            const auto exponent = _mm256_mul_ps(
+                _mm256_add_ps(lateral, _mm256_set1_ps(emitters.HeightTerm[i])),
+                _mm256_sub_ps(zero, invDownwindSq));
+            const auto isValid = _mm256_and_ps(isDownwind, _mm256_cmp_ps(exponent, cutoff, _CMP_GE_OQ));
+            if (_mm256_movemask_ps(isValid) == 0)
+                continue;
+
+            const auto contribution = _mm256_mul_ps(
+                _mm256_mul_ps(_mm256_set1_ps(emitters.Scale[i]), invDownwindSq),
+                FastExp2<ExpDegree>(_mm256_mul_ps(exponent, log2e)));
+            concentration = _mm256_add_ps(concentration, _mm256_and_ps(isValid, contribution));
+        }
+
+        // The deposition term only depends on the cell, so it is applied once after the sum.
+        return HasDeposition ? _mm256_mul_ps(concentration, Exp(_mm256_sub_ps(zero, deposition))) : concentration;
+    }
+
+    for (size_t i = 0; i < emittersCount; i++)
+    {
+        const auto downwind = _mm256_sub_ps(windX, _mm256_set1_ps(emitters.Downwind[i]));
+        const auto isDownwind = _mm256_cmp_ps(downwind, zero, _CMP_GT_OQ);
+        if (_mm256_movemask_ps(isDownwind) == 0)
+            continue;
+
+        const auto invDownwind = _mm256_div_ps(one, downwind);
+        const auto invDownwindSq = _mm256_mul_ps(invDownwind, invDownwind);
+        const auto exponent = _mm256_fnmsub_ps(
+            _mm256_add_ps(lateral, _mm256_set1_ps(emitters.HeightTerm[i])),
+            invDownwindSq,
+            deposition);
+        const auto contribution = _mm256_mul_ps(
+            _mm256_mul_ps(_mm256_set1_ps(emitters.Scale[i]), invDownwindSq),
+            Exp(exponent));
+        concentration = _mm256_add_ps(concentration, _mm256_and_ps(isDownwind, contribution));
+    }
+
+    return concentration;
+}
+
+template<bool IsRotated, bool HasDeposition, int ExpDegree>
+EMISSIONS_AVX2_TARGET static void EvaluateRegion(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept
+{
+    constexpr int laneCount = 8;
+
+    const auto laneOffsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const auto laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const auto denominatorX = _mm256_set1_ps((float)(constants.Resolution.x - 1));
+    const auto sizeX = _mm256_set1_ps(constants.Size.x);
+    const auto one = _mm256_set1_ps(1.0f);
+    const auto zero = _mm256_setzero_ps();
+    const auto cosWindDir = _mm256_set1_ps(constants.CosWindDir);
+    const auto depositionCoeff = _mm256_set1_ps(constants.DepositionCoeff);
+
+    for (int row = 0; row < region.Size.y; row++)
+    {
+        const auto yScalar = GetCellPositionY(constants, region.Offset.y + row);
+        const auto lateral = _mm256_set1_ps(yScalar * yScalar * constants.LateralCoeff);
+        const auto crosswind = _mm256_set1_ps(yScalar * constants.SinWindDir);
+        float *outputRow = output + (size_t)row * outputStride;
+
+        for (int column = 0; column < region.Size.x; column += laneCount)
+        {
+            const auto t = _mm256_div_ps(
+                _mm256_add_ps(_mm256_set1_ps((float)(region.Offset.x + column)), laneOffsets),
+                denominatorX);
+            const auto x = _mm256_fmadd_ps(sizeX, t, _mm256_sub_ps(one, t));
+            const auto deposition = HasDeposition ? _mm256_mul_ps(depositionCoeff, x) : zero;
+            // The rotation is linear, so the downwind distance is the difference of the positions along the wind axis.
+            const auto windX = IsRotated ? _mm256_fmadd_ps(x, cosWindDir, crosswind) : x;
+
+            const auto concentration = SumEmitters<HasDeposition, ExpDegree>(
+            emitters, windX, lateral, deposition, constants.ExpCutoff);
+
+            const auto remaining = region.Size.x - column;
+            if (remaining >= laneCount)
+                _mm256_storeu_ps(outputRow + column, concentration);
+            else
+                _mm256_maskstore_ps(outputRow + column, _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), laneIndices), concentration);
+        }
+    }
+}
+
+// Evaluates `positionCount` arbitrary positions, getPosition(i) returning the position written to output[i].
+template<bool IsRotated, bool HasDeposition, int ExpDegree, typename GetPosition>
+EMISSIONS_AVX2_TARGET static void EvaluatePositions(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    size_t positionCount,
+    GetPosition &&getPosition,
+    float *output) noexcept
+{
+    constexpr size_t laneCount = 8;
+
+    const auto zero = _mm256_setzero_ps();
+    const auto cosWindDir = _mm256_set1_ps(constants.CosWindDir);
+    const auto sinWindDir = _mm256_set1_ps(constants.SinWindDir);
+    const auto lateralCoeff = _mm256_set1_ps(constants.LateralCoeff);
+    const auto depositionCoeff = _mm256_set1_ps(constants.DepositionCoeff);
+
+    for (size_t first = 0; first < positionCount; first += laneCount)
+    {
+        // The last batch repeats its final position in the unused lanes.
+        const auto count = std::min(laneCount, positionCount - first);
+        alignas(32) float xs[laneCount];
+        alignas(32) float ys[laneCount];
+        for (size_t lane = 0; lane < laneCount; lane++)
+        {
+            const glm::vec2 position = getPosition(first + std::min(lane, count - 1));
+            xs[lane] = position.x;
+            ys[lane] = position.y;
+        }
+
+        const auto x = _mm256_load_ps(xs);
+        const auto y = _mm256_load_ps(ys);
+        const auto lateral = _mm256_mul_ps(_mm256_mul_ps(y, y), lateralCoeff);
+        const auto deposition = HasDeposition ? _mm256_mul_ps(depositionCoeff, x) : zero;
+        const auto windX = IsRotated ? _mm256_fmadd_ps(x, cosWindDir, _mm256_mul_ps(y, sinWindDir)) : x;
+
+        const auto concentration = SumEmitters<HasDeposition, ExpDegree>(
+            emitters, windX, lateral, deposition, constants.ExpCutoff);
+
+        alignas(32) float results[laneCount];
+        _mm256_store_ps(results, concentration);
+        std::copy_n(results, count, output + first);
+    }
+}
+
+void EvaluateRegionAVX2(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            EvaluateRegion<IsRotated, HasDeposition, ExpDegree>(constants, emitters, region, output, outputStride);
+        });
+}
+
+void EvaluatePointsAVX2(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::ivec2> cells,
+    float *output) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            EvaluatePositions<IsRotated, HasDeposition, ExpDegree>(
+                constants,
+                emitters,
+                cells.size(),
+                [&](size_t i)
+                {
+                    return glm::vec2(GetCellPositionX(constants, cells[i].x), GetCellPositionY(constants, cells[i].y));
+                },
+                output);
+        });
+}
+
+void EvaluateReceptorsAVX2(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::vec2> positions,
+    float *output) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            EvaluatePositions<IsRotated, HasDeposition, ExpDegree>(
+                constants,
+                emitters,
+                positions.size(),
+                [&](size_t i) { return positions[i]; },
+                output);
+        });
+}
+#else
+void EvaluateRegionAVX2(const KernelConstants&, const PreparedEmitters&, const GridRegion&, float*, size_t) noexcept { }
+void EvaluatePointsAVX2(const KernelConstants&, const PreparedEmitters&, std::span<const glm::ivec2>, float*) noexcept { }
+void EvaluateReceptorsAVX2(const KernelConstants&, const PreparedEmitters&, std::span<const glm::vec2>, float*) noexcept { }
+#endif
@@ -0,0 +1,269 @@
+#include "PlumeKernelISA.hpp"
+#ifdef EMISSIONS_KERNEL_AVX512
+#include <immintrin.h>
+#include <algorithm>
+
+// Marks the functions compiled for AVX-512, see EMISSIONS_AVX2_TARGET in PlumeKernelAVX2.cpp.
+#if defined(__GNUC__)
+#define EMISSIONS_AVX512_TARGET __attribute__((target("avx512f,avx2,fma")))
+#else
+#define EMISSIONS_AVX512_TARGET
+#endif
+
+// 16-lane version of the exp in PlumeKernelAVX2.cpp.
+EMISSIONS_AVX512_TARGET static inline __m512 Exp(__m512 x) noexcept
+{
+    const auto notUnderflow = _mm512_cmp_ps_mask(x, _mm512_set1_ps(c_KernelUnderflowExponent), _CMP_GE_OQ);
+    x = _mm512_min_ps(x, _mm512_set1_ps(88.0f));
+
+    const auto n = _mm512_roundscale_ps(
+        _mm512_mul_ps(x, _mm512_set1_ps(c_Log2E)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    auto r = _mm512_fnmadd_ps(n, _mm512_set1_ps(0.693359375f), x);
+    r = _mm512_fnmadd_ps(n, _mm512_set1_ps(-2.12194440e-4f), r);
+
+    auto p = _mm512_set1_ps(1.9875691500e-4f);
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.3981999507e-3f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(8.3334519073e-3f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(4.1665795894e-2f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.6666665459e-1f));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(5.0000001201e-1f));
+    p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+
+    return _mm512_maskz_mul_ps(notUnderflow, p, _mm512_scalef_ps(_mm512_set1_ps(1.0f), n));
+}
+
+// 16-lane version of the fast exp2 in PlumeKernelAVX2.cpp, scaling by 2^n with scalef.
+template<int ExpDegree>
+EMISSIONS_AVX512_TARGET static inline __m512 FastExp2(__m512 t) noexcept
+{
+    const auto &coefficients = c_Exp2Coefficients<ExpDegree>;
+    const auto n = _mm512_roundscale_ps(t, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const auto f = _mm512_sub_ps(t, n);
+
+    auto p = _mm512_set1_ps(coefficients[ExpDegree]);
+    for (int i = ExpDegree - 1; i >= 0; i--)
+        p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(coefficients[i]));
+
+    return _mm512_scalef_ps(p, n);
+}
+
+// 16-lane version of SumEmitters() in PlumeKernelAVX2.cpp.
+template<bool HasDeposition, int ExpDegree>
+EMISSIONS_AVX512_TARGET static inline __m512 SumEmitters(
+    const PreparedEmitters &emitters,
+    __m512 windX,
+    __m512 lateral,
+    __m512 deposition,
+    float expCutoff) noexcept
+{
+    const auto emittersCount = emitters.GetCount();
+    const auto one = _mm512_set1_ps(1.0f);
+    const auto zero = _mm512_setzero_ps();
+
+    auto concentration = _mm512_setzero_ps();
+    if constexpr (ExpDegree != 0)
+    {
+        const auto two = _mm512_set1_ps(2.0f);
+        const auto cutoff = _mm512_set1_ps(expCutoff);
+        const auto log2e = _mm512_set1_ps(c_Log2E);
+        for (size_t i = 0; i < emittersCount; i++)
+        {
+            const auto downwind = _mm512_sub_ps(windX, _mm512_set1_ps(emitters.Downwind[i]));
+            const auto isDownwind = _mm512_cmp_ps_mask(downwind, zero, _CMP_GT_OQ);
+            if (isDownwind == 0)
+                continue;
+
+            const auto downwindSq = _mm512_mul_ps(downwind, downwind);
+            const auto estimate = _mm512_rcp14_ps(downwindSq);
+            const auto invDownwindSq = _mm512_mul_ps(estimate, _mm512_fnmadd_ps(downwindSq, estimate, two));
+            const auto exponent = _mm512_mul_ps(
+                _mm512_add_ps(lateral, _mm512_set1_ps(emitters.HeightTerm[i])),
+                _mm512_sub_ps(zero, invDownwindSq));
+            const auto isValid = _mm512_mask_cmp_ps_mask(isDownwind, exponent, cutoff, _CMP_GE_OQ);
+            if (isValid == 0)
+                continue;
+
+            const auto contribution = _mm512_mul_ps(
+                _mm512_mul_ps(_mm512_set1_ps(emitters.Scale[i]), invDownwindSq),
+                FastExp2<ExpDegree>(_mm512_mul_ps(exponent, log2e)));
+            concentration = _mm512_mask_add_ps(concentration, isValid, concentration, contribution);
+        }
+
+        return HasDeposition ? _mm512_mul_ps(concentration, Exp(_mm512_sub_ps(zero, deposition))) : concentration;
+    }
+
+    for (size_t i = 0; i < emittersCount; i++)
+    {
+        const auto downwind = _mm512_sub_ps(windX, _mm512_set1_ps(emitters.Downwind[i]));
+        const auto isDownwind = _mm512_cmp_ps_mask(downwind, zero, _CMP_GT_OQ);
+        if (isDownwind == 0)
+            continue;
+
+        const auto invDownwind = _mm512_div_ps(one, downwind);
+        const auto invDownwindSq = _mm512_mul_ps(invDownwind, invDownwind);
+        const auto exponent = _mm512_fnmsub_ps(
+            _mm512_add_ps(lateral, _mm512_set1_ps(emitters.HeightTerm[i])),
+            invDownwindSq,
+            deposition);
+        const auto contribution = _mm512_mul_ps(
+            _mm512_mul_ps(_mm512_set1_ps(emitters.Scale[i]), invDownwindSq),
+            Exp(exponent));
+        concentration = _mm512_mask_add_ps(concentration, isDownwind, concentration, contribution);
+    }
+
+    return concentration;
+}
+
+template<bool IsRotated, bool HasDeposition, int ExpDegree>
+EMISSIONS_AVX512_TARGET static void EvaluateRegion(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept
+{
+    constexpr int laneCount = 16;
+
+    const auto laneOffsets = _mm512_setr_ps(
+        0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+        8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    const auto denominatorX = _mm512_set1_ps((float)(constants.Resolution.x - 1));
+    const auto sizeX = _mm512_set1_ps(constants.Size.x);
+    const auto one = _mm512_set1_ps(1.0f);
+    const auto zero = _mm512_setzero_ps();
+    const auto cosWindDir = _mm512_set1_ps(constants.CosWindDir);
+    const auto depositionCoeff = _mm512_set1_ps(constants.DepositionCoeff);
+
+    for (int row = 0; row < region.Size.y; row++)
+    {
+        const auto yScalar = GetCellPositionY(constants, region.Offset.y + row);
+        const auto lateral = _mm512_set1_ps(yScalar * yScalar * constants.LateralCoeff);
+        const auto crosswind = _mm512_set1_ps(yScalar * constants.SinWindDir);
+        float *outputRow = output + (size_t)row * outputStride;
+
+        for (int column = 0; column < region.Size.x; column += laneCount)
+        {
+            const auto t = _mm512_div_ps(
+                _mm512_add_ps(_mm512_set1_ps((float)(region.Offset.x + column)), laneOffsets),
+                denominatorX);
+            const auto x = _mm512_fmadd_ps(sizeX, t, _mm512_sub_ps(one, t));
+            const auto deposition = HasDeposition ? _mm512_mul_ps(depositionCoeff, x) : zero;
+            // The rotation is linear, so the downwind distance is the difference of the positions along the wind axis.
+            const auto windX = IsRotated ? _mm512_fmadd_ps(x, cosWindDir, crosswind) : x;
+
+            const auto concentration = SumEmitters<HasDeposition, ExpDegree>(
+            emitters, windX, lateral, deposition, constants.ExpCutoff);
+
+            const auto remaining = region.Size.x - column;
+            const __mmask16 storeMask = remaining >= laneCount ? 0xffff : (__mmask16)((1u << remaining) - 1u);
+            _mm512_mask_storeu_ps(outputRow + column, storeMask, concentration);
+        }
+    }
+}
+
+// Evaluates `positionCount` arbitrary positions, getPosition(i) returning the position written to output[i].
+template<bool IsRotated, bool HasDeposition, int ExpDegree, typename GetPosition>
+EMISSIONS_AVX512_TARGET static void EvaluatePositions(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    size_t positionCount,
+    GetPosition &&getPosition,
+    float *output) noexcept
+{
+    constexpr size_t laneCount = 16;
+
+    const auto zero = _mm512_setzero_ps();
+    const auto cosWindDir = _mm512_set1_ps(constants.CosWindDir);
+    const auto sinWindDir = _mm512_set1_ps(constants.SinWindDir);
+    const auto lateralCoeff = _mm512_set1_ps(constants.LateralCoeff);
+    const auto depositionCoeff = _mm512_set1_ps(constants.DepositionCoeff);
+
+    for (size_t first = 0; first < positionCount; first += laneCount)
+    {
+        // The last batch repeats its final position in the unused lanes.
+        const auto count = std::min(laneCount, positionCount - first);
+        alignas(64) float xs[laneCount];
+        alignas(64) float ys[laneCount];
+        for (size_t lane = 0; lane < laneCount; lane++)
+        {
+            const glm::vec2 position = getPosition(first + std::min(lane, count - 1));
+            xs[lane] = position.x;
+            ys[lane] = position.y;
+        }
+
+        const auto x = _mm512_load_ps(xs);
+        const auto y = _mm512_load_ps(ys);
+        const auto lateral = _mm512_mul_ps(_mm512_mul_ps(y, y), lateralCoeff);
+        const auto deposition = HasDeposition ? _mm512_mul_ps(depositionCoeff, x) : zero;
+        const auto windX = IsRotated ? _mm512_fmadd_ps(x, cosWindDir, _mm512_mul_ps(y, sinWindDir)) : x;
+
+        const auto concentration = SumEmitters<HasDeposition, ExpDegree>(
+            emitters, windX, lateral, deposition, constants.ExpCutoff);
+
+        alignas(64) float results[laneCount];
+        _mm512_store_ps(results, concentration);
+        std::copy_n(results, count, output + first);
+    }
+}
+
+void EvaluateRegionAVX512(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            EvaluateRegion<IsRotated, HasDeposition, ExpDegree>(constants, emitters, region, output, outputStride);
+        });
+}
+
+void EvaluatePointsAVX512(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::ivec2> cells,
+    float *output) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            EvaluatePositions<IsRotated, HasDeposition, ExpDegree>(
+                constants,
+                emitters,
+                cells.size(),
+                [&](size_t i)
+                {
+                    return glm::vec2(GetCellPositionX(constants, cells[i].x), GetCellPositionY(constants, cells[i].y));
+                },
+                output);
+        });
+}
+
+void EvaluateReceptorsAVX512(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::vec2> positions,
+    float *output) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            EvaluatePositions<IsRotated, HasDeposition, ExpDegree>(
+                constants,
+                emitters,
+                positions.size(),
+                [&](size_t i) { return positions[i]; },
+                output);
+        });
+}
+#else
+void EvaluateRegionAVX512(const KernelConstants&, const PreparedEmitters&, const GridRegion&, float*, size_t) noexcept { }
+void EvaluatePointsAVX512(const KernelConstants&, const PreparedEmitters&, std::span<const glm::ivec2>, float*) noexcept { }
+void EvaluateReceptorsAVX512(const KernelConstants&, const PreparedEmitters&, std::span<const glm::vec2>, float*) noexcept { }
+#endif
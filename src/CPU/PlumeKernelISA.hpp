@@ -0,0 +1,126 @@
+#pragma once
+#include <span>
+#include <array>
+#include <cstddef>
+#include <glm/vec2.hpp>
+#include "PlumeKernel.hpp"
+
+void EvaluateRegionScalar(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept;
+void EvaluateRegionAVX2(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept;
+void EvaluateRegionAVX512(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept;
+void EvaluatePointsScalar(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::ivec2> cells,
+    float *output) noexcept;
+void EvaluatePointsAVX2(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::ivec2> cells,
+    float *output) noexcept;
+void EvaluatePointsAVX512(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::ivec2> cells,
+    float *output) noexcept;
+void EvaluateReceptorsScalar(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::vec2> positions,
+    float *output) noexcept;
+void EvaluateReceptorsAVX2(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::vec2> positions,
+    float *output) noexcept;
+void EvaluateReceptorsAVX512(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::vec2> positions,
+    float *output) noexcept;
+
+// Minimax coefficients of 2^f on [-1/2, 1/2] used by the fast kernel variants, constant term first. Their error
+// in single precision is 1.7e-3, 7.5e-5 and 2.7e-6 relative for degrees 2, 3 and 4.
+template<int Degree>
+constexpr std::array<float, Degree + 1> c_Exp2Coefficients{};
+template<>
+constexpr std::array<float, 3> c_Exp2Coefficients<2>{1.000443220e+00f, 7.034485936e-01f, 2.384292334e-01f};
+template<>
+constexpr std::array<float, 4> c_Exp2Coefficients<3>{
+    9.999280572e-01f, 6.932609677e-01f, 2.426111996e-01f, 5.517170206e-02f};
+template<>
+constexpr std::array<float, 5> c_Exp2Coefficients<4>{
+    9.999992847e-01f, 6.931217909e-01f, 2.402474433e-01f, 5.591787025e-02f, 9.570105001e-03f};
+
+constexpr float c_Log2E = 1.44269504088896341f;
+
+// Calls evaluate.template operator()<IsRotated, HasDeposition, ExpDegree>() with the flags matching the constants,
+// so that the common cases of wind along +x and no deposition are compiled without the arithmetic they do not need
+// instead of branching on it per cell. ExpDegree is 0 for the exact kernel, see KernelConstants::ExpDegree.
+template<typename Evaluate>
+inline void DispatchKernelVariant(const KernelConstants &constants, Evaluate &&evaluate) noexcept
+{
+    const auto dispatch = [&]<int ExpDegree>()
+    {
+        const auto isRotated = constants.SinWindDir != 0.0f || constants.CosWindDir != 1.0f;
+        const auto hasDeposition = constants.DepositionCoeff != 0.0f;
+        if (isRotated)
+        {
+            if (hasDeposition)
+                evaluate.template operator()<true, true, ExpDegree>();
+            else
+                evaluate.template operator()<true, false, ExpDegree>();
+        }
+        else
+        {
+            if (hasDeposition)
+                evaluate.template operator()<false, true, ExpDegree>();
+            else
+                evaluate.template operator()<false, false, ExpDegree>();
+        }
+    };
+
+    switch (constants.ExpDegree)
+    {
+    case 2:
+        dispatch.template operator()<2>();
+        break;
+    case 3:
+        dispatch.template operator()<3>();
+        break;
+    case 4:
+        dispatch.template operator()<4>();
+        break;
+    default:
+        dispatch.template operator()<0>();
+        break;
+    }
+}
+
+// Maps a grid cell index to its position in the same way as main() in MainCompute.glsl.
+inline float GetCellPositionX(const KernelConstants &constants, int x) noexcept
+{
+    const auto t = (float)x / (float)(constants.Resolution.x - 1);
+    return 1.0f * (1.0f - t) + constants.Size.x * t;
+}
+
+inline float GetCellPositionY(const KernelConstants &constants, int y) noexcept
+{
+    const auto t = (float)y / (float)(constants.Resolution.y - 1);
+    return -constants.Size.y * (1.0f - t) + constants.Size.y * t;
+}
@@ -0,0 +1,136 @@
+#include "PlumeKernelISA.hpp"
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+// 2^t as 2^round(t) times the minimax polynomial of the remainder, for t above the exponent cutoff.
+template<int ExpDegree>
+static float FastExp2(float t) noexcept
+{
+    const auto n = std::nearbyint(t);
+    const auto f = t - n;
+    const auto &coefficients = c_Exp2Coefficients<ExpDegree>;
+
+    auto p = coefficients[ExpDegree];
+    for (int i = ExpDegree - 1; i >= 0; i--)
+        p = p * f + coefficients[i];
+
+    // Adding n to the biased exponent field scales by 2^n without a second exp.
+    return std::bit_cast<float>(std::bit_cast<int32_t>(p) + ((int32_t)n << 23));
+}
+
+template<bool IsRotated, bool HasDeposition, int ExpDegree>
+static float EvaluateCell(const KernelConstants &constants, const PreparedEmitters &emitters, float x, float y) noexcept
+{
+    // MainCompute.glsl measures the lateral offset from the grid centreline, not from the emitter.
+    const auto lateral = y * y * constants.LateralCoeff;
+    const auto deposition = HasDeposition ? constants.DepositionCoeff * x : 0.0f;
+    // The rotation is linear, so the downwind distance is the difference of the positions along the wind axis.
+    const auto windX = IsRotated ? x * constants.CosWindDir + y * constants.SinWindDir : x;
+
+    float concentration = 0.0f;
+    if constexpr (ExpDegree != 0)
+    {
+        // The deposition term only depends on the cell, so it is applied once after the sum.
+        for (size_t i = 0; i < emitters.GetCount(); i++)
+        {
+            const auto downwind = windX - emitters.Downwind[i];
+            if (downwind <= 0.0f)
+                continue;
+
+            const auto invDownwindSq = 1.0f / (downwind * downwind);
+            const auto exponent = -(lateral + emitters.HeightTerm[i]) * invDownwindSq;
+            if (exponent < constants.ExpCutoff)
+                continue;
+
+            concentration += emitters.Scale[i] * invDownwindSq * FastExp2<ExpDegree>(exponent * c_Log2E);
+        }
+
+        return HasDeposition ? concentration * std::exp(-deposition) : concentration;
+    }
+
+    for (size_t i = 0; i < emitters.GetCount(); i++)
+    {
+        const auto downwind = windX - emitters.Downwind[i];
+        if (downwind <= 0.0f)
+            continue;
+
+        // The three exponentials of the shader are folded into one: exp(a) * exp(b) * exp(c) == exp(a + b + c).
+        const auto invDownwindSq = 1.0f / (downwind * downwind);
+        const auto exponent = -(lateral + emitters.HeightTerm[i]) * invDownwindSq - deposition;
+        concentration += emitters.Scale[i] * invDownwindSq * std::exp(exponent);
+    }
+
+    return concentration;
+}
+
+template<bool IsRotated, bool HasDeposition, int ExpDegree>
+static void EvaluateRegion(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept
+{
+    for (int row = 0; row < region.Size.y; row++)
+    {
+        const auto y = GetCellPositionY(constants, region.Offset.y + row);
+        float *outputRow = output + (size_t)row * outputStride;
+
+        for (int column = 0; column < region.Size.x; column++)
+        {
+            const auto x = GetCellPositionX(constants, region.Offset.x + column);
+            outputRow[column] = EvaluateCell<IsRotated, HasDeposition, ExpDegree>(constants, emitters, x, y);
+        }
+    }
+}
+
+void EvaluateRegionScalar(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    float *output,
+    size_t outputStride) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            EvaluateRegion<IsRotated, HasDeposition, ExpDegree>(constants, emitters, region, output, outputStride);
+        });
+}
+
+void EvaluatePointsScalar(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::ivec2> cells,
+    float *output) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            for (size_t i = 0; i < cells.size(); i++)
+            {
+                const auto x = GetCellPositionX(constants, cells[i].x);
+                const auto y = GetCellPositionY(constants, cells[i].y);
+                output[i] = EvaluateCell<IsRotated, HasDeposition, ExpDegree>(constants, emitters, x, y);
+            }
+        });
+}
+
+
+void EvaluateReceptorsScalar(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const glm::vec2> positions,
+    float *output) noexcept
+{
+    DispatchKernelVariant(
+        constants,
+        [&]<bool IsRotated, bool HasDeposition, int ExpDegree>()
+        {
+            for (size_t i = 0; i < positions.size(); i++)
+                output[i] = EvaluateCell<IsRotated, HasDeposition, ExpDegree>(constants, emitters, positions[i].x, positions[i].y);
+        });
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "ScenarioSweep.hpp"
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+std::vector<SimulationConfig> MakeSweepVariants(
+    const SimulationConfig &base,
+    std::span<const glm::vec2> stabilities,
+    std::span<const float> windSpeeds,
+    std::span<const float> windDirs)
+{
+    std::vector<SimulationConfig> variants;
+    variants.reserve(stabilities.size() * windSpeeds.size() * windDirs.size());
+
+    for (const auto &stability : stabilities)
+    {
+        for (const auto windSpeed : windSpeeds)
+        {
+            for (const auto windDir : windDirs)
+            {
+                auto &variant = variants.emplace_back(base);
+                variant.Stability = stability;
+                variant.WindSpeed = windSpeed;
+                variant.WindDir = windDir;
+            }
+        }
+    }
+
+    return variants;
+}
+
+std::vector<SweepGroup> GroupSweepVariants(std::span<const SimulationConfig> variants, std::span<const EmitterInfo> emitters)
+{
+    std::vector<SweepGroup> groups;
+    std::vector<SimulationConfig> groupConfigs;
+
+    for (size_t i = 0; i < variants.size(); i++)
+    {
+        const auto &variant = variants[i];
+        if (variant.Size != variants.front().Size || variant.Resolution != variants.front().Resolution)
+            throw std::invalid_argument("All sweep variants must share the grid size and resolution.");
+
+        auto sharedConfig = variant;
+        sharedConfig.WindSpeed = 1.0f;
+        sharedConfig.DepositionCoeff = 0.0f;
+        sharedConfig.CullingThreshold = std::numeric_limits<float>::max();
+
+        const auto group = std::ranges::find(groupConfigs, sharedConfig);
+        const auto groupIdx = (size_t)std::distance(groupConfigs.begin(), group);
+        if (group == groupConfigs.end())
+            groupConfigs.emplace_back(sharedConfig);
+        if (groupIdx == groups.size())
+            groups.emplace_back();
+
+        groups[groupIdx].Variants.emplace_back(i);
+    }
+
+    for (size_t i = 0; i < groups.size(); i++)
+    {
+        // A variant's contribution is at most the shared one divided by its wind speed, so the shared sum may only
+        // cull what every variant of the group would cull.
+        auto &config = groupConfigs[i];
+        for (const auto variantIdx : groups[i].Variants)
+            config.CullingThreshold = std::min(config.CullingThreshold, variants[variantIdx].CullingThreshold * variants[variantIdx].WindSpeed);
+
+        groups[i].Constants = PlumeKernel::PrepareConstants(config);
+        groups[i].Emitters = PlumeKernel::PrepareEmitters(config, emitters);
+    }
+
+    return groups;
+}
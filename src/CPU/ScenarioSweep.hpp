@@ -0,0 +1,26 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstddef>
+#include "PlumeKernel.hpp"
+
+// Variants of a sweep that differ only in WindSpeed and DepositionCoeff. Both only scale the plume sum of a
+// cell, by 1 / u and exp(-k / u * x), so the group evaluates the emitters once with u = 1, k = 0 and derives
+// every variant from that shared sum.
+struct SweepGroup
+{
+    KernelConstants Constants;
+    PreparedEmitters Emitters;
+    std::vector<size_t> Variants;
+};
+
+// Every combination of the given stability classes, wind speeds and wind directions applied to `base`,
+// ordered with the wind direction varying fastest.
+std::vector<SimulationConfig> MakeSweepVariants(
+    const SimulationConfig &base,
+    std::span<const glm::vec2> stabilities,
+    std::span<const float> windSpeeds,
+    std::span<const float> windDirs);
+
+// Groups variants that can share a plume sum. All variants must have the same Size and Resolution.
+std::vector<SweepGroup> GroupSweepVariants(std::span<const SimulationConfig> variants, std::span<const EmitterInfo> emitters);
@@ -0,0 +1,166 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <utility>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = GetDefaultThreadCount();
+
+    queues_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++)
+        queues_.emplace_back(std::make_unique<WorkQueue>());
+
+    workers_.reserve(threadCount - 1);
+    for (size_t i = 0; i < threadCount - 1; i++)
+        workers_.emplace_back(&ThreadPool::WorkerMain, this, i);
+}
+
+ThreadPool::~ThreadPool() noexcept
+{
+    {
+        std::lock_guard lock(jobMutex_);
+        isStopping_ = true;
+    }
+    jobStarted_.notify_all();
+
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const Task &task)
+{
+    if (count == 0)
+        return;
+
+    const auto participants = queues_.size();
+    for (size_t i = 0; i < participants; i++)
+    {
+        auto &queue = *queues_[i];
+        std::lock_guard lock(queue.Mutex);
+        queue.Begin = count * i / participants;
+        queue.End = count * (i + 1) / participants;
+    }
+
+    {
+        std::lock_guard lock(jobMutex_);
+        task_ = &task;
+        exception_ = nullptr;
+        activeWorkers_ = workers_.size();
+        jobGeneration_++;
+    }
+    jobStarted_.notify_all();
+
+    RunParticipant(participants - 1);
+
+    std::unique_lock lock(jobMutex_);
+    jobFinished_.wait(lock, [this] { return activeWorkers_ == 0; });
+    task_ = nullptr;
+
+    if (exception_)
+        std::rethrow_exception(std::exchange(exception_, nullptr));
+}
+
+size_t ThreadPool::GetDefaultThreadCount() noexcept
+{
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void ThreadPool::WorkerMain(size_t participantIdx)
+{
+    size_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock lock(jobMutex_);
+            jobStarted_.wait(lock, [&] { return isStopping_ || jobGeneration_ != seenGeneration; });
+            if (isStopping_)
+                return;
+
+            seenGeneration = jobGeneration_;
+        }
+
+        RunParticipant(participantIdx);
+
+        {
+            std::lock_guard lock(jobMutex_);
+            if (--activeWorkers_ != 0)
+                continue;
+        }
+        jobFinished_.notify_one();
+    }
+}
+
+void ThreadPool::RunParticipant(size_t participantIdx) noexcept
+{
+    size_t index;
+    while (PopIndex(participantIdx, index) || (StealRange(participantIdx) && PopIndex(participantIdx, index)))
+    {
+        try
+        {
+            (*task_)(index, participantIdx);
+        }
+        catch (...)
+        {
+            std::lock_guard lock(jobMutex_);
+            if (!exception_)
+                exception_ = std::current_exception();
+        }
+    }
+}
+
+bool ThreadPool::PopIndex(size_t participantIdx, size_t &index) noexcept
+{
+    auto &queue = *queues_[participantIdx];
+    std::lock_guard lock(queue.Mutex);
+    if (queue.Begin == queue.End)
+        return false;
+
+    index = queue.Begin++;
+    return true;
+}
+
+bool ThreadPool::StealRange(size_t participantIdx) noexcept
+{
+    // Retried until every queue is observed empty, as a victim may be emptied between the scan and the steal.
+    while (true)
+    {
+        size_t victimIdx = participantIdx;
+        size_t victimRemaining = 0;
+        for (size_t i = 0; i < queues_.size(); i++)
+        {
+            if (i == participantIdx)
+                continue;
+
+            auto &queue = *queues_[i];
+            std::lock_guard lock(queue.Mutex);
+            if (queue.End - queue.Begin > victimRemaining)
+            {
+                victimIdx = i;
+                victimRemaining = queue.End - queue.Begin;
+            }
+        }
+
+        if (victimRemaining == 0)
+            return false;
+
+        size_t begin, end;
+        {
+            auto &victim = *queues_[victimIdx];
+            std::lock_guard lock(victim.Mutex);
+            const auto remaining = victim.End - victim.Begin;
+            if (remaining == 0)
+                continue;
+
+            end = victim.End;
+            begin = end - (remaining + 1) / 2;
+            victim.End = begin;
+        }
+
+        auto &queue = *queues_[participantIdx];
+        std::lock_guard lock(queue.Mutex);
+        queue.Begin = begin;
+        queue.End = end;
+        return true;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <cstddef>
+
+// Fixed-size pool that runs index-parallel jobs. Every participant starts with a contiguous share of the
+// index range and, once it runs dry, steals the upper half of the largest remaining share, so uneven task
+// costs do not leave threads idle. The calling thread takes part in the job as the last participant.
+class ThreadPool
+{
+public:
+    using Task = std::function<void(size_t index, size_t participantIdx)>;
+
+    ThreadPool()
+        : ThreadPool(0) { }
+    explicit ThreadPool(size_t threadCount);
+    ThreadPool(const ThreadPool&) = delete;
+
+    ~ThreadPool() noexcept;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void ParallelFor(size_t count, const Task &task);
+
+    constexpr size_t GetThreadCount() const noexcept { return queues_.size(); }
+
+    static size_t GetDefaultThreadCount() noexcept;
+
+private:
+    struct alignas(64) WorkQueue
+    {
+        std::mutex Mutex;
+        size_t Begin = 0;
+        size_t End = 0;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex jobMutex_;
+    std::condition_variable jobStarted_;
+    std::condition_variable jobFinished_;
+    const Task *task_ = nullptr;
+    std::exception_ptr exception_;
+    size_t jobGeneration_ = 0;
+    size_t activeWorkers_ = 0;
+    bool isStopping_ = false;
+
+    void WorkerMain(size_t participantIdx);
+    void RunParticipant(size_t participantIdx) noexcept;
+    bool PopIndex(size_t participantIdx, size_t &index) noexcept;
+    bool StealRange(size_t participantIdx) noexcept;
+};
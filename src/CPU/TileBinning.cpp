@@ -0,0 +1,79 @@
+#include "TileBinning.hpp"
+#include "PlumeKernelISA.hpp"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+float GetMaxEmitterContribution(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    size_t emitterIdx,
+    const GridRegion &region) noexcept
+{
+    const glm::vec2 lo{
+        GetCellPositionX(constants, region.Offset.x),
+        GetCellPositionY(constants, region.Offset.y)};
+    const glm::vec2 hi{
+        GetCellPositionX(constants, region.Offset.x + region.Size.x - 1),
+        GetCellPositionY(constants, region.Offset.y + region.Size.y - 1)};
+
+    // The downwind distance is linear in the cell position, so its extremes lie on the region corners.
+    const auto downwindX0 = lo.x * constants.CosWindDir;
+    const auto downwindX1 = hi.x * constants.CosWindDir;
+    const auto downwindY0 = lo.y * constants.SinWindDir;
+    const auto downwindY1 = hi.y * constants.SinWindDir;
+    const auto downwindMax = std::max(downwindX0, downwindX1) + std::max(downwindY0, downwindY1) - emitters.Downwind[emitterIdx];
+    const auto downwindMin = std::min(downwindX0, downwindX1) + std::min(downwindY0, downwindY1) - emitters.Downwind[emitterIdx];
+    if (downwindMax <= 0.0f)
+        return -1.0f;
+
+    // With q = 1 / downwind^2 the contribution is bounded by Scale * q * exp(-a * q) * exp(-deposition),
+    // where a takes the smallest lateral offset of the region. That peaks at q = 1 / a.
+    const auto lateralMin = lo.y <= 0.0f && hi.y >= 0.0f ? 0.0f : std::min(lo.y * lo.y, hi.y * hi.y);
+    const auto a = lateralMin * constants.LateralCoeff + emitters.HeightTerm[emitterIdx];
+    if (a <= 0.0f && downwindMin <= 0.0f)
+        return std::numeric_limits<float>::max();
+
+    const auto qMin = 1.0f / (downwindMax * downwindMax);
+    const auto qMax = downwindMin > 0.0f ? 1.0f / (downwindMin * downwindMin) : std::numeric_limits<float>::max();
+    const auto q = a > 0.0f ? std::clamp(1.0f / a, qMin, qMax) : qMax;
+
+    return std::abs(emitters.Scale[emitterIdx]) * q * std::exp(-a * q - constants.DepositionCoeff * lo.x);
+}
+
+void BinEmitters(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    PreparedEmitters &binned)
+{
+    binned.Clear();
+
+    for (size_t i = 0; i < emitters.GetCount(); i++)
+    {
+        const auto maxContribution = GetMaxEmitterContribution(constants, emitters, i, region);
+        if (maxContribution < 0.0f || maxContribution < constants.CullingThreshold)
+            continue;
+
+        binned.Append(emitters, i);
+    }
+}
+
+void BinEmitters(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const uint32_t> indices,
+    const GridRegion &region,
+    PreparedEmitters &binned)
+{
+    binned.Clear();
+
+    for (const auto i : indices)
+    {
+        const auto maxContribution = GetMaxEmitterContribution(constants, emitters, i, region);
+        if (maxContribution < 0.0f || maxContribution < constants.CullingThreshold)
+            continue;
+
+        binned.Append(emitters, i);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include <span>
+#include <cstdint>
+#include <vector>
+#include "PlumeKernel.hpp"
+
+// Edge of the square regions emitters are binned for, matching the 16x16 workgroups of MainCompute.glsl.
+constexpr int c_EmitterBinSize = 16;
+
+// Upper bound of the contribution of emitter `emitterIdx` to any cell of `region`. Returns a negative value
+// when the whole region is upwind of the emitter, which means its contribution is exactly 0.
+float GetMaxEmitterContribution(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    size_t emitterIdx,
+    const GridRegion &region) noexcept;
+
+// Copies the emitters that may contribute at least constants.CullingThreshold to some cell of `region`
+// into `binned`, keeping their order.
+void BinEmitters(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    const GridRegion &region,
+    PreparedEmitters &binned);
+
+// Like BinEmitters, but only considers emitters[indices[i]].
+void BinEmitters(
+    const KernelConstants &constants,
+    const PreparedEmitters &emitters,
+    std::span<const uint32_t> indices,
+    const GridRegion &region,
+    PreparedEmitters &binned);
\ No newline at end of file
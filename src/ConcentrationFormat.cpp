@@ -0,0 +1,161 @@
+#include "ConcentrationFormat.hpp"
+#include <bit>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+constexpr uint16_t c_LogUNorm16MaxCode = 65535;
+
+static float GetLogUNorm16Step() noexcept
+{
+    return (std::log(c_LogUNorm16Max) - std::log(c_LogUNorm16Min)) / (float)(c_LogUNorm16MaxCode - 1);
+}
+
+ConcentrationPrecision GetConcentrationPrecision(ConcentrationFormat format) noexcept
+{
+    switch (format)
+    {
+    case ConcentrationFormat::Float16:
+        // Round to nearest with a 10-bit mantissa; values below the smallest normal half become subnormal.
+        return {.RelativeError = 0x1.0p-11f, .MinValue = 0x1.0p-14f, .MaxValue = 65504.0f};
+    case ConcentrationFormat::LogUNorm16:
+    {
+        // Codes are evenly spaced in log(c), so rounding is off by at most half a step, which is a constant factor.
+        // The float log and exp add a few ULPs of the largest |log(c)| on top.
+        const auto logError = 4.0f * std::numeric_limits<float>::epsilon()
+            * std::max(std::abs(std::log(c_LogUNorm16Min)), std::abs(std::log(c_LogUNorm16Max)));
+        return {
+            .RelativeError = std::expm1(GetLogUNorm16Step() * 0.5f + logError),
+            .MinValue = c_LogUNorm16Min,
+            .MaxValue = c_LogUNorm16Max,
+        };
+    }
+    default:
+        return {
+            .RelativeError = 0x1.0p-24f,
+            .MinValue = std::numeric_limits<float>::min(),
+            .MaxValue = std::numeric_limits<float>::max(),
+        };
+    }
+}
+
+size_t GetConcentrationSampleSize(ConcentrationFormat format) noexcept
+{
+    return format == ConcentrationFormat::Float32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+const char *GetConcentrationFormatName(ConcentrationFormat format) noexcept
+{
+    switch (format)
+    {
+    case ConcentrationFormat::Float16:
+        return "float16";
+    case ConcentrationFormat::LogUNorm16:
+        return "log16";
+    default:
+        return "float32";
+    }
+}
+
+ConcentrationFormat ParseConcentrationFormat(const std::string_view name)
+{
+    for (const auto format : {ConcentrationFormat::Float32, ConcentrationFormat::Float16, ConcentrationFormat::LogUNorm16})
+    {
+        if (name == GetConcentrationFormatName(format))
+            return format;
+    }
+
+    throw std::invalid_argument(std::format("Unknown concentration format \"{}\".", name));
+}
+
+uint16_t EncodeHalf(float value) noexcept
+{
+    const auto bits = std::bit_cast<uint32_t>(value);
+    const auto sign = (uint16_t)((bits >> 16) & 0x8000);
+    const auto magnitude = bits & 0x7fffffff;
+
+    if (magnitude >= 0x7f800000)
+        return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x0200 : 0);
+    // Anything from 65520 up rounds to infinity.
+    if (magnitude >= 0x477ff000)
+        return sign | 0x7c00;
+    // Below 2^-14 the half is subnormal with a fixed exponent, so the float is scaled onto its mantissa.
+    if (magnitude < 0x38800000)
+        return sign | (uint16_t)std::nearbyint(std::bit_cast<float>(magnitude) * 0x1.0p24f);
+
+    auto half = (((magnitude >> 23) - 127 + 15) << 10) | ((magnitude >> 13) & 0x3ff);
+    const auto remainder = magnitude & 0x1fff;
+    // Round to nearest even; a carry out of the mantissa correctly increments the exponent.
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+
+    return sign | (uint16_t)half;
+}
+
+float DecodeHalf(uint16_t value) noexcept
+{
+    const auto sign = (uint32_t)(value & 0x8000) << 16;
+    const auto exponent = (uint32_t)(value >> 10) & 0x1f;
+    const auto mantissa = (uint32_t)value & 0x3ff;
+
+    if (exponent == 0)
+    {
+        const auto magnitude = (float)mantissa * 0x1.0p-24f;
+        return sign ? -magnitude : magnitude;
+    }
+    if (exponent == 31)
+        return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+
+    return std::bit_cast<float>(sign | ((exponent - 15 + 127) << 23) | (mantissa << 13));
+}
+
+// Must match encodeLogUNorm16() in MainCompute.glsl.
+uint16_t EncodeLogUNorm16(float value) noexcept
+{
+    // Also maps NaN and negative values, left behind by removed incremental contributions, to 0.
+    if (!(value >= c_LogUNorm16Min))
+        return 0;
+
+    const auto t = std::min((std::log(value) - std::log(c_LogUNorm16Min)) / GetLogUNorm16Step(), (float)(c_LogUNorm16MaxCode - 1));
+    return (uint16_t)(1.0f + std::round(t));
+}
+
+float DecodeLogUNorm16(uint16_t value) noexcept
+{
+    if (value == 0)
+        return 0.0f;
+
+    return std::exp(std::log(c_LogUNorm16Min) + (float)(value - 1) * GetLogUNorm16Step());
+}
+
+void EncodeConcentrations(ConcentrationFormat format, std::span<const float> values, std::span<uint16_t> output) noexcept
+{
+    const auto count = std::min(values.size(), output.size());
+    if (format == ConcentrationFormat::LogUNorm16)
+    {
+        for (size_t i = 0; i < count; i++)
+            output[i] = EncodeLogUNorm16(values[i]);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+            output[i] = EncodeHalf(values[i]);
+    }
+}
+
+void DecodeConcentrations(ConcentrationFormat format, std::span<const uint16_t> values, std::span<float> output) noexcept
+{
+    const auto count = std::min(values.size(), output.size());
+    if (format == ConcentrationFormat::LogUNorm16)
+    {
+        for (size_t i = 0; i < count; i++)
+            output[i] = DecodeLogUNorm16(values[i]);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+            output[i] = DecodeHalf(values[i]);
+    }
+}
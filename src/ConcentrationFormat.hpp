@@ -0,0 +1,43 @@
+#pragma once
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+// Storage format of the concentration grid: the GPU output texture, the CPU backend's upload and grid files.
+// Every backend computes in 32-bit floats; the format only decides how the result is stored.
+enum class ConcentrationFormat : uint32_t
+{
+    Float32 = 0,
+    Float16 = 1,
+    // 16-bit unorm holding log(c) over [c_LogUNorm16Min, c_LogUNorm16Max]; code 0 stores 0.
+    LogUNorm16 = 2,
+};
+
+constexpr float c_LogUNorm16Min = 1.0e-12f; // [g/m^3]
+constexpr float c_LogUNorm16Max = 1.0e4f;   // [g/m^3]
+
+struct ConcentrationPrecision
+{
+    // Largest error of a stored value relative to the value, for values in [MinValue, MaxValue].
+    float RelativeError;
+    // Smallest value stored with RelativeError [g/m^3]. Smaller values lose precision or flush to 0.
+    float MinValue;
+    // Largest value that can be stored [g/m^3]. Larger values saturate.
+    float MaxValue;
+};
+
+ConcentrationPrecision GetConcentrationPrecision(ConcentrationFormat format) noexcept;
+size_t GetConcentrationSampleSize(ConcentrationFormat format) noexcept;
+const char *GetConcentrationFormatName(ConcentrationFormat format) noexcept;
+// Accepts the names returned by GetConcentrationFormatName().
+ConcentrationFormat ParseConcentrationFormat(const std::string_view name);
+
+uint16_t EncodeHalf(float value) noexcept;
+float DecodeHalf(uint16_t value) noexcept;
+uint16_t EncodeLogUNorm16(float value) noexcept;
+float DecodeLogUNorm16(uint16_t value) noexcept;
+
+// Converts between floats and the samples of a 16-bit format.
+void EncodeConcentrations(ConcentrationFormat format, std::span<const float> values, std::span<uint16_t> output) noexcept;
+void DecodeConcentrations(ConcentrationFormat format, std::span<const uint16_t> values, std::span<float> output) noexcept;
@@ -15,4 +15,6 @@ struct EmitterInfo
     static EmitterInfo FromJSON(std::ifstream& fileStream);
 
     nlohmann::json ToJSON() const;
+
+    bool operator==(const EmitterInfo &other) const noexcept = default;
 };
\ No newline at end of file
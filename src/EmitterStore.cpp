@@ -0,0 +1,168 @@
+#include "EmitterStore.hpp"
+#include <stdexcept>
+
+static glm::vec4 PackEmitterInvariants(const PreparedEmitters &emitters, size_t emitterIdx) noexcept
+{
+    return glm::vec4(emitters.Downwind[emitterIdx], emitters.Scale[emitterIdx], emitters.HeightTerm[emitterIdx], 0.0f);
+}
+
+void PackEmitterInvariants(const PreparedEmitters &emitters, std::vector<glm::vec4> &packed)
+{
+    packed.resize(emitters.GetCount());
+    for (size_t i = 0; i < emitters.GetCount(); i++)
+        packed[i] = PackEmitterInvariants(emitters, i);
+}
+
+EmitterStore::EmitterStore(std::span<const EmitterInfo> emitters)
+{
+    Assign(emitters);
+}
+
+void EmitterStore::Add(const EmitterInfo &emitter)
+{
+    x_.emplace_back(emitter.Position.x);
+    y_.emplace_back(emitter.Position.y);
+    height_.emplace_back(emitter.Height);
+    emissionRate_.emplace_back(emitter.EmissionRate);
+
+    if (!hasInvariants_)
+        return;
+
+    invariants_.Append(factors_, emitter.Position, emitter.EmissionRate, emitter.Height);
+    if (hasPackedInvariants_)
+        packedInvariants_.emplace_back(PackEmitterInvariants(invariants_, invariants_.GetCount() - 1));
+}
+
+void EmitterStore::Set(size_t emitterIdx, const EmitterInfo &emitter)
+{
+    if (emitterIdx >= GetCount())
+        throw std::out_of_range("Emitter index out of range.");
+
+    x_[emitterIdx] = emitter.Position.x;
+    y_[emitterIdx] = emitter.Position.y;
+    height_[emitterIdx] = emitter.Height;
+    emissionRate_[emitterIdx] = emitter.EmissionRate;
+
+    if (!hasInvariants_)
+        return;
+
+    invariants_.Set(emitterIdx, factors_, emitter.Position, emitter.EmissionRate, emitter.Height);
+    if (hasPackedInvariants_)
+        packedInvariants_[emitterIdx] = PackEmitterInvariants(invariants_, emitterIdx);
+}
+
+void EmitterStore::Remove(size_t emitterIdx)
+{
+    if (emitterIdx >= GetCount())
+        throw std::out_of_range("Emitter index out of range.");
+
+    x_.erase(x_.begin() + emitterIdx);
+    y_.erase(y_.begin() + emitterIdx);
+    height_.erase(height_.begin() + emitterIdx);
+    emissionRate_.erase(emissionRate_.begin() + emitterIdx);
+
+    if (!hasInvariants_)
+        return;
+
+    invariants_.Erase(emitterIdx);
+    if (hasPackedInvariants_)
+        packedInvariants_.erase(packedInvariants_.begin() + emitterIdx);
+}
+
+void EmitterStore::Assign(std::span<const EmitterInfo> emitters)
+{
+    Clear();
+    Reserve(emitters.size());
+    for (const auto &emitter : emitters)
+    {
+        x_.emplace_back(emitter.Position.x);
+        y_.emplace_back(emitter.Position.y);
+        height_.emplace_back(emitter.Height);
+        emissionRate_.emplace_back(emitter.EmissionRate);
+    }
+}
+
+void EmitterStore::Clear() noexcept
+{
+    x_.clear();
+    y_.clear();
+    height_.clear();
+    emissionRate_.clear();
+    InvalidateInvariants();
+}
+
+void EmitterStore::Reserve(size_t count)
+{
+    x_.reserve(count);
+    y_.reserve(count);
+    height_.reserve(count);
+    emissionRate_.reserve(count);
+}
+
+EmitterInfo EmitterStore::Get(size_t emitterIdx) const
+{
+    if (emitterIdx >= GetCount())
+        throw std::out_of_range("Emitter index out of range.");
+
+    return EmitterInfo{
+        .Position = {x_[emitterIdx], y_[emitterIdx]},
+        .EmissionRate = emissionRate_[emitterIdx],
+        .Height = height_[emitterIdx],
+    };
+}
+
+std::vector<EmitterInfo> EmitterStore::ToVector() const
+{
+    std::vector<EmitterInfo> emitters(GetCount());
+    for (size_t i = 0; i < emitters.size(); i++)
+        emitters[i] = EmitterInfo{.Position = {x_[i], y_[i]}, .EmissionRate = emissionRate_[i], .Height = height_[i]};
+
+    return emitters;
+}
+
+const PreparedEmitters& EmitterStore::GetInvariants(const SimulationConfig &config)
+{
+    const auto factors = PlumeKernel::PrepareEmitterFactors(config);
+    if (hasInvariants_ && factors == factors_)
+        return invariants_;
+
+    // Same arithmetic as PreparedEmitters::Append(), over whole arrays so that it vectorizes.
+    const auto count = GetCount();
+    invariants_.X.assign(x_.begin(), x_.end());
+    invariants_.Y.assign(y_.begin(), y_.end());
+    invariants_.Downwind.resize(count);
+    invariants_.Scale.resize(count);
+    invariants_.HeightTerm.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        invariants_.Downwind[i] = x_[i] * factors.CosWindDir + y_[i] * factors.SinWindDir;
+        invariants_.Scale[i] = emissionRate_[i] / factors.ScaleDenominator;
+        invariants_.HeightTerm[i] = height_[i] * height_[i] / factors.HeightDenominator;
+    }
+
+    factors_ = factors;
+    hasInvariants_ = true;
+    hasPackedInvariants_ = false;
+
+    return invariants_;
+}
+
+std::span<const glm::vec4> EmitterStore::GetPackedInvariants(const SimulationConfig &config)
+{
+    const auto &invariants = GetInvariants(config);
+    if (!hasPackedInvariants_)
+    {
+        PackEmitterInvariants(invariants, packedInvariants_);
+        hasPackedInvariants_ = true;
+    }
+
+    return packedInvariants_;
+}
+
+void EmitterStore::InvalidateInvariants() noexcept
+{
+    invariants_.Clear();
+    packedInvariants_.clear();
+    hasInvariants_ = false;
+    hasPackedInvariants_ = false;
+}
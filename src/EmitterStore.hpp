@@ -0,0 +1,60 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <glm/vec4.hpp>
+#include "EmitterInfo.hpp"
+#include "SimulationConfig.hpp"
+#include "CPU/PlumeKernel.hpp"
+
+// Packs the invariants as one vec4 (downwind position, scale, height term, 0) per emitter, the layout of the
+// emitters buffer read by the compute shaders.
+void PackEmitterInvariants(const PreparedEmitters &emitters, std::vector<glm::vec4> &packed);
+
+// Emitter list in SoA layout, together with the per-emitter invariants of the plume equation derived from it.
+//
+// The invariants depend on the emitters and on the wind direction, wind speed and stability of the config. They
+// are regenerated only when one of those changes, and edits of single emitters update them in place, so that
+// neither the CPU kernels nor the shaders recompute them per cell.
+class EmitterStore
+{
+public:
+    EmitterStore() = default;
+    explicit EmitterStore(std::span<const EmitterInfo> emitters);
+
+    void Add(const EmitterInfo &emitter);
+    void Set(size_t emitterIdx, const EmitterInfo &emitter);
+    void Remove(size_t emitterIdx);
+    void Assign(std::span<const EmitterInfo> emitters);
+    void Clear() noexcept;
+    void Reserve(size_t count);
+
+    // Throws std::out_of_range for an index past the last emitter.
+    EmitterInfo Get(size_t emitterIdx) const;
+    std::vector<EmitterInfo> ToVector() const;
+    // Invariants of every emitter for `config`, in the order of the store.
+    const PreparedEmitters& GetInvariants(const SimulationConfig &config);
+    // GetInvariants() packed by PackEmitterInvariants().
+    std::span<const glm::vec4> GetPackedInvariants(const SimulationConfig &config);
+
+    constexpr size_t GetCount() const noexcept { return x_.size(); }
+    constexpr bool IsEmpty() const noexcept { return x_.empty(); }
+    constexpr std::span<const float> GetX() const noexcept { return x_; }
+    constexpr std::span<const float> GetY() const noexcept { return y_; }
+    constexpr std::span<const float> GetHeight() const noexcept { return height_; }
+    constexpr std::span<const float> GetEmissionRate() const noexcept { return emissionRate_; }
+
+private:
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> height_;
+    std::vector<float> emissionRate_;
+    PreparedEmitters invariants_;
+    std::vector<glm::vec4> packedInvariants_;
+    // Factors invariants_ were computed with, valid while hasInvariants_ is set.
+    EmitterFactors factors_{};
+    bool hasInvariants_ = false;
+    bool hasPackedInvariants_ = false;
+
+    void InvalidateInvariants() noexcept;
+};
@@ -0,0 +1,56 @@
+#include "EmitterTable.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static_assert(sizeof(EmitterTableHeader) == 32, "EmitterTableHeader layout is part of the file format.");
+static_assert(sizeof(EmitterInfo) == 16, "EmitterInfo layout is part of the file format.");
+static_assert(offsetof(EmitterInfo, EmissionRate) == 8 && offsetof(EmitterInfo, Height) == 12,
+    "EmitterInfo layout is part of the file format.");
+
+void SaveEmitterTable(const std::filesystem::path &path, std::span<const EmitterInfo> emitters)
+{
+    if constexpr (std::endian::native != std::endian::little)
+        throw std::runtime_error("Emitter tables can only be written on little-endian hosts.");
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open emitter table save file.");
+
+    EmitterTableHeader header{
+        .Magic = {},
+        .Version = c_EmitterTableVersion,
+        .RecordSize = sizeof(EmitterInfo),
+        .Count = emitters.size(),
+        ._Pad = 0,
+    };
+    std::memcpy(header.Magic, c_EmitterTableMagic, sizeof(c_EmitterTableMagic));
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(emitters.data()), (std::streamsize)emitters.size_bytes());
+
+    if (!file)
+        throw std::runtime_error("Failed to write emitter table.");
+}
+
+EmitterTable::EmitterTable(const std::filesystem::path &path)
+    : file_(path)
+{
+    if (file_.GetSize() < sizeof(EmitterTableHeader))
+        throw std::runtime_error("Emitter table is too small.");
+
+    view_ = file_.Map(0, (size_t)file_.GetSize());
+
+    EmitterTableHeader header;
+    std::memcpy(&header, view_.GetData(), sizeof(header));
+    if (std::memcmp(header.Magic, c_EmitterTableMagic, sizeof(c_EmitterTableMagic)) != 0)
+        throw std::runtime_error("Not an emitter table.");
+    if (header.Version != c_EmitterTableVersion || header.RecordSize != sizeof(EmitterInfo))
+        throw std::runtime_error("Unsupported emitter table version.");
+    if (header.Count > (file_.GetSize() - sizeof(EmitterTableHeader)) / sizeof(EmitterInfo))
+        throw std::runtime_error("Emitter table is truncated.");
+
+    emitters_ = {reinterpret_cast<const EmitterInfo*>(view_.GetData() + sizeof(EmitterTableHeader)), (size_t)header.Count};
+}
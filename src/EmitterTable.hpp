@@ -0,0 +1,37 @@
+#pragma once
+#include <span>
+#include <cstdint>
+#include <filesystem>
+#include "EmitterInfo.hpp"
+#include "MappedFile.hpp"
+
+// Binary emitter inventory: a 32-byte header followed by the EmitterInfo records exactly as they are laid out in
+// memory, so a mapped table can be used as a span of emitters without parsing. All values are little-endian.
+constexpr char c_EmitterTableMagic[8] = {'E', 'M', 'T', 'A', 'B', 'L', 'E', '\0'};
+constexpr uint32_t c_EmitterTableVersion = 1;
+
+struct EmitterTableHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    // sizeof(EmitterInfo) of the writer, checked on load.
+    uint32_t RecordSize;
+    uint64_t Count;
+    uint64_t _Pad;
+};
+
+void SaveEmitterTable(const std::filesystem::path &path, std::span<const EmitterInfo> emitters);
+
+// Read-only, memory-mapped emitter table.
+class EmitterTable
+{
+public:
+    EmitterTable() = default;
+    explicit EmitterTable(const std::filesystem::path &path);
+
+    constexpr std::span<const EmitterInfo> GetEmitters() const noexcept { return emitters_; }
+private:
+    MappedFile file_;
+    MappedView view_;
+    std::span<const EmitterInfo> emitters_;
+};
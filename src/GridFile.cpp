@@ -0,0 +1,352 @@
+#include "GridFile.hpp"
+#include <bit>
+#include <format>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+static_assert(sizeof(GridFileHeader) == 88, "GridFileHeader layout is part of the file format.");
+static_assert(sizeof(GridFileTile) == 24, "GridFileTile layout is part of the file format.");
+
+// Longest run of repeated bytes (and of literal bytes) a single control byte can describe.
+constexpr size_t c_MaxRunLength = 128;
+constexpr size_t c_MinRepeatLength = 3;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) noexcept
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Control byte c < 128 is followed by c + 1 literal bytes, c >= 128 by one byte repeated c - 128 + 3 times.
+static void EncodeShuffleRLE(std::span<const std::byte> bytes, size_t sampleSize, std::vector<std::byte> &encoded)
+{
+    const auto sampleCount = bytes.size() / sampleSize;
+    std::vector<std::byte> planes(bytes.size());
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        for (size_t plane = 0; plane < sampleSize; plane++)
+            planes[plane * sampleCount + i] = bytes[i * sampleSize + plane];
+    }
+
+    encoded.clear();
+    size_t literalStart = 0;
+    const auto flushLiterals = [&](size_t end)
+    {
+        while (literalStart < end)
+        {
+            const auto count = std::min(end - literalStart, c_MaxRunLength);
+            encoded.push_back(std::byte(count - 1));
+            encoded.insert(encoded.end(), planes.begin() + literalStart, planes.begin() + literalStart + count);
+            literalStart += count;
+        }
+    };
+
+    size_t i = 0;
+    while (i < planes.size())
+    {
+        size_t runLength = 1;
+        while (i + runLength < planes.size() && planes[i + runLength] == planes[i] && runLength < c_MaxRunLength + c_MinRepeatLength - 1)
+            runLength++;
+
+        if (runLength < c_MinRepeatLength)
+        {
+            i += runLength;
+            continue;
+        }
+
+        flushLiterals(i);
+        encoded.push_back(std::byte(128 + runLength - c_MinRepeatLength));
+        encoded.push_back(planes[i]);
+        i += runLength;
+        literalStart = i;
+    }
+    flushLiterals(planes.size());
+}
+
+static void DecodeShuffleRLE(std::span<const std::byte> encoded, size_t sampleSize, std::span<std::byte> bytes)
+{
+    const auto sampleCount = bytes.size() / sampleSize;
+    std::vector<std::byte> planes(bytes.size());
+    size_t written = 0;
+    for (size_t i = 0; i < encoded.size();)
+    {
+        const auto control = (size_t)encoded[i++];
+        const auto count = control < 128 ? control + 1 : control - 128 + c_MinRepeatLength;
+        if (written + count > planes.size() || i + (control < 128 ? count : 1) > encoded.size())
+            throw std::runtime_error("Corrupted grid file tile.");
+
+        if (control < 128)
+        {
+            std::copy_n(encoded.begin() + i, count, planes.begin() + written);
+            i += count;
+        }
+        else
+            std::fill_n(planes.begin() + written, count, encoded[i++]);
+        written += count;
+    }
+
+    if (written != planes.size())
+        throw std::runtime_error("Corrupted grid file tile.");
+
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        for (size_t plane = 0; plane < sampleSize; plane++)
+            bytes[i * sampleSize + plane] = planes[plane * sampleCount + i];
+    }
+}
+
+uint64_t HashEmitters(std::span<const EmitterInfo> emitters) noexcept
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const auto byte : std::as_bytes(emitters))
+    {
+        hash ^= (uint64_t)byte;
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+void SaveGridFile(
+    const std::filesystem::path &path,
+    const SimulationConfig &config,
+    std::span<const EmitterInfo> emitters,
+    std::span<const float> grid,
+    const GridFileOptions &options)
+{
+    if constexpr (std::endian::native != std::endian::little)
+        throw std::runtime_error("Grid files can only be written on little-endian hosts.");
+
+    const auto resolution = config.Resolution;
+    if (grid.size() < (size_t)resolution.x * (size_t)resolution.y)
+        throw std::out_of_range("Concentration grid is smaller than its resolution.");
+    if (options.TileSize == 0)
+        throw std::invalid_argument("Grid file tile size must be positive.");
+
+    GridFileHeader header{
+        .Magic = {},
+        .Version = c_GridFileVersion,
+        .DataType = (GridDataType)config.OutputFormat,
+        .Resolution = resolution,
+        .TileSize = options.TileSize,
+        .Compression = options.Compression,
+        .EmittersHash = HashEmitters(emitters),
+        .Config = config,
+    };
+    std::memcpy(header.Magic, c_GridFileMagic, sizeof(c_GridFileMagic));
+    header.Config.EmittersCount = (int)emitters.size();
+
+    const auto tileSize = (int)options.TileSize;
+    const glm::ivec2 tileCount = (resolution + tileSize - 1) / tileSize;
+    std::vector<GridFileTile> tiles((size_t)tileCount.x * (size_t)tileCount.y);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open grid save file.");
+
+    // The index is only known once every tile is encoded, so it is written last into the space reserved here.
+    const auto indexOffset = (uint64_t)sizeof(GridFileHeader);
+    auto offset = AlignUp(indexOffset + tiles.size() * sizeof(GridFileTile), c_GridFileTileAlignment);
+    file.seekp((std::streamoff)offset);
+
+    std::vector<float> samples;
+    std::vector<uint16_t> packed;
+    std::vector<std::byte> encoded;
+    const auto sampleSize = GetConcentrationSampleSize(config.OutputFormat);
+    for (int ty = 0; ty < tileCount.y; ty++)
+    {
+        for (int tx = 0; tx < tileCount.x; tx++)
+        {
+            const glm::ivec2 tileOffset{tx * tileSize, ty * tileSize};
+            const auto size = glm::min(glm::ivec2(tileSize), resolution - tileOffset);
+            samples.resize((size_t)size.x * (size_t)size.y);
+            for (int y = 0; y < size.y; y++)
+            {
+                const auto *row = grid.data() + (size_t)(tileOffset.y + y) * (size_t)resolution.x + (size_t)tileOffset.x;
+                std::copy_n(row, size.x, samples.begin() + (size_t)y * (size_t)size.x);
+            }
+
+            auto &tile = tiles[(size_t)ty * (size_t)tileCount.x + (size_t)tx];
+            if (std::ranges::all_of(samples, [](float x) { return x == 0.0f; }))
+            {
+                tile = {.Offset = offset, .StoredSize = 0, .Encoding = GridTileEncoding::Zero, ._Pad = 0};
+                continue;
+            }
+
+            auto data = std::as_bytes(std::span{samples});
+            if (config.OutputFormat != ConcentrationFormat::Float32)
+            {
+                packed.resize(samples.size());
+                EncodeConcentrations(config.OutputFormat, samples, packed);
+                data = std::as_bytes(std::span{packed});
+            }
+
+            tile.Encoding = GridTileEncoding::Raw;
+            if (options.Compression == GridCompression::ShuffleRLE)
+            {
+                EncodeShuffleRLE(data, sampleSize, encoded);
+                if (encoded.size() < data.size())
+                {
+                    data = encoded;
+                    tile.Encoding = GridTileEncoding::ShuffleRLE;
+                }
+            }
+
+            tile.Offset = offset;
+            tile.StoredSize = data.size();
+            file.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+
+            const auto nextOffset = AlignUp(offset + data.size(), c_GridFileTileAlignment);
+            for (auto padding = nextOffset - (offset + data.size()); padding > 0; padding--)
+                file.put('\0');
+            offset = nextOffset;
+        }
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(tiles.data()), (std::streamsize)(tiles.size() * sizeof(GridFileTile)));
+
+    if (!file)
+        throw std::runtime_error("Failed to write grid file.");
+}
+
+GridFile::GridFile(const std::filesystem::path &path)
+    : file_(path)
+{
+    if (file_.GetSize() < sizeof(GridFileHeader))
+        throw std::runtime_error("Grid file is too small.");
+
+    view_ = file_.Map(0, (size_t)file_.GetSize());
+    std::memcpy(&header_, view_.GetData(), sizeof(GridFileHeader));
+
+    if (std::memcmp(header_.Magic, c_GridFileMagic, sizeof(c_GridFileMagic)) != 0)
+        throw std::runtime_error("Not a grid file.");
+    if (header_.Version != c_GridFileVersion)
+        throw std::runtime_error(std::format("Unsupported grid file version {}.", header_.Version));
+    if (header_.DataType > GridDataType::LogUNorm16 || header_.TileSize == 0 || header_.Resolution.x <= 0 || header_.Resolution.y <= 0)
+        throw std::runtime_error("Invalid grid file header.");
+
+    tileCount_ = (header_.Resolution + (int)header_.TileSize - 1) / (int)header_.TileSize;
+    const auto tileCount = (size_t)tileCount_.x * (size_t)tileCount_.y;
+    if (sizeof(GridFileHeader) + tileCount * sizeof(GridFileTile) > file_.GetSize())
+        throw std::runtime_error("Grid file index is truncated.");
+
+    tiles_ = {reinterpret_cast<const GridFileTile*>(view_.GetData() + sizeof(GridFileHeader)), tileCount};
+    for (size_t i = 0; i < tiles_.size(); i++)
+    {
+        const auto &tile = tiles_[i];
+        if (tile.Offset + tile.StoredSize > file_.GetSize())
+            throw std::runtime_error("Grid file tile data is truncated.");
+
+        const auto extent = GetTileSize(i);
+        if (tile.Encoding == GridTileEncoding::Raw && tile.StoredSize != (uint64_t)extent.x * (uint64_t)extent.y * GetSampleSize())
+            throw std::runtime_error("Corrupted grid file tile.");
+    }
+}
+
+glm::ivec2 GridFile::GetTileSize(size_t tileIdx) const noexcept
+{
+    const auto tileSize = (int)header_.TileSize;
+    const glm::ivec2 offset{(int)(tileIdx % (size_t)tileCount_.x) * tileSize, (int)(tileIdx / (size_t)tileCount_.x) * tileSize};
+
+    return glm::min(glm::ivec2(tileSize), header_.Resolution - offset);
+}
+
+std::span<const float> GridFile::GetRawTile(size_t tileIdx) const noexcept
+{
+    const auto &tile = tiles_[tileIdx];
+    if (tile.Encoding != GridTileEncoding::Raw || header_.DataType != GridDataType::Float32)
+        return {};
+
+    return {reinterpret_cast<const float*>(view_.GetData() + tile.Offset), (size_t)(tile.StoredSize / sizeof(float))};
+}
+
+void GridFile::ReadRegion(const glm::ivec2 &offset, const glm::ivec2 &size, float *output, size_t outputStride) const
+{
+    if (offset.x < 0 || offset.y < 0 || offset.x + size.x > header_.Resolution.x || offset.y + size.y > header_.Resolution.y)
+        throw std::out_of_range("Grid region exceeds the grid resolution.");
+    if (size.x <= 0 || size.y <= 0)
+        return;
+
+    const auto tileSize = (int)header_.TileSize;
+    const auto firstTile = offset / tileSize;
+    const auto lastTile = (offset + size - 1) / tileSize;
+    std::vector<float> decoded;
+
+    for (int ty = firstTile.y; ty <= lastTile.y; ty++)
+    {
+        for (int tx = firstTile.x; tx <= lastTile.x; tx++)
+        {
+            const auto tileIdx = (size_t)ty * (size_t)tileCount_.x + (size_t)tx;
+            const glm::ivec2 tileOffset{tx * tileSize, ty * tileSize};
+            const auto tileExtent = GetTileSize(tileIdx);
+
+            auto samples = GetRawTile(tileIdx);
+            if (samples.empty())
+            {
+                decoded.resize((size_t)tileExtent.x * (size_t)tileExtent.y);
+                DecodeTile(tileIdx, decoded.data());
+                samples = decoded;
+            }
+
+            // Intersection of the tile with the requested region, in grid coordinates.
+            const auto lo = glm::max(offset, tileOffset);
+            const auto hi = glm::min(offset + size, tileOffset + tileExtent);
+            for (int y = lo.y; y < hi.y; y++)
+            {
+                const auto *src = samples.data() + (size_t)(y - tileOffset.y) * (size_t)tileExtent.x + (size_t)(lo.x - tileOffset.x);
+                auto *dst = output + (size_t)(y - offset.y) * outputStride + (size_t)(lo.x - offset.x);
+                std::copy_n(src, hi.x - lo.x, dst);
+            }
+        }
+    }
+}
+
+std::vector<float> GridFile::ReadAll() const
+{
+    std::vector<float> grid((size_t)header_.Resolution.x * (size_t)header_.Resolution.y);
+    ReadRegion({0, 0}, header_.Resolution, grid.data(), (size_t)header_.Resolution.x);
+
+    return grid;
+}
+
+void GridFile::DecodeTile(size_t tileIdx, float *output) const
+{
+    const auto &tile = tiles_[tileIdx];
+    const auto extent = GetTileSize(tileIdx);
+    const std::span samples{output, (size_t)extent.x * (size_t)extent.y};
+    const std::span data{view_.GetData() + tile.Offset, (size_t)tile.StoredSize};
+
+    if (tile.Encoding == GridTileEncoding::Zero)
+    {
+        std::ranges::fill(samples, 0.0f);
+        return;
+    }
+
+    // 16-bit samples are unpacked into a temporary and then decoded; Float32 samples go straight to the output.
+    const auto format = (ConcentrationFormat)header_.DataType;
+    std::vector<uint16_t> packed;
+    auto bytes = std::as_writable_bytes(samples);
+    if (format != ConcentrationFormat::Float32)
+    {
+        packed.resize(samples.size());
+        bytes = std::as_writable_bytes(std::span{packed});
+    }
+
+    switch (tile.Encoding)
+    {
+    case GridTileEncoding::Raw:
+        std::memcpy(bytes.data(), data.data(), data.size());
+        break;
+    case GridTileEncoding::ShuffleRLE:
+        DecodeShuffleRLE(data, GetSampleSize(), bytes);
+        break;
+    default:
+        throw std::runtime_error("Unknown grid file tile encoding.");
+    }
+
+    if (format != ConcentrationFormat::Float32)
+        DecodeConcentrations(format, packed, samples);
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <glm/vec2.hpp>
+#include "SimulationConfig.hpp"
+#include "EmitterInfo.hpp"
+#include "MappedFile.hpp"
+
+// Concentration grids are stored as fixed-size square tiles behind a header and a tile index, so a window of
+// the grid can be read through a memory map by decoding only the tiles it overlaps. All values are little-endian.
+//
+//   GridFileHeader
+//   GridFileTile[tile count]        row-major tile order
+//   tile data                       every tile starts at a c_GridFileTileAlignment boundary
+//
+// A tile holds min(TileSize, remaining) x min(TileSize, remaining) samples in row-major order.
+
+constexpr char c_GridFileMagic[8] = {'E', 'M', 'G', 'R', 'I', 'D', '\0', '\0'};
+constexpr uint32_t c_GridFileVersion = 1;
+constexpr uint32_t c_GridFileDefaultTileSize = 256;
+constexpr uint64_t c_GridFileTileAlignment = 64;
+
+// Same values as ConcentrationFormat; samples are stored in the format of the config they were computed with.
+enum class GridDataType : uint32_t
+{
+    Float32 = 0,
+    Float16 = 1,
+    LogUNorm16 = 2,
+};
+
+enum class GridCompression : uint32_t
+{
+    None = 0,
+    // Byte planes of the samples run-length encoded; works well on the smooth, mostly empty plume fields.
+    ShuffleRLE = 1,
+};
+
+enum class GridTileEncoding : uint32_t
+{
+    Raw = 0,
+    // Every sample is 0, nothing is stored.
+    Zero = 1,
+    ShuffleRLE = 2,
+};
+
+struct GridFileHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    GridDataType DataType;
+    glm::ivec2 Resolution;
+    uint32_t TileSize;
+    GridCompression Compression;
+    // Identifies the emitter inventory the grid was computed from, see HashEmitters.
+    uint64_t EmittersHash;
+    // Same std140 layout as the GPU uniform block.
+    SimulationConfig Config;
+};
+
+struct GridFileTile
+{
+    uint64_t Offset;
+    uint64_t StoredSize;
+    GridTileEncoding Encoding;
+    uint32_t _Pad;
+};
+
+struct GridFileOptions
+{
+    uint32_t TileSize = c_GridFileDefaultTileSize;
+    GridCompression Compression = GridCompression::None;
+};
+
+// FNV-1a over the raw emitter records.
+uint64_t HashEmitters(std::span<const EmitterInfo> emitters) noexcept;
+
+// The samples are stored in config.OutputFormat.
+void SaveGridFile(
+    const std::filesystem::path &path,
+    const SimulationConfig &config,
+    std::span<const EmitterInfo> emitters,
+    std::span<const float> grid,
+    const GridFileOptions &options = {});
+
+// Read-only, memory-mapped view of a grid file. Opening only parses the header and the tile index.
+class GridFile
+{
+public:
+    GridFile() = default;
+    explicit GridFile(const std::filesystem::path &path);
+
+    // Copies the samples of `region` into `output`, which is row-major with `outputStride` samples per row.
+    void ReadRegion(const glm::ivec2 &offset, const glm::ivec2 &size, float *output, size_t outputStride) const;
+    std::vector<float> ReadAll() const;
+    // Samples of an uncompressed Float32 tile, pointing into the mapping; empty for encoded tiles and other data types.
+    std::span<const float> GetRawTile(size_t tileIdx) const noexcept;
+
+    constexpr const GridFileHeader& GetHeader() const noexcept { return header_; }
+    constexpr const SimulationConfig& GetConfig() const noexcept { return header_.Config; }
+    constexpr glm::ivec2 GetResolution() const noexcept { return header_.Resolution; }
+    constexpr glm::ivec2 GetTileCount() const noexcept { return tileCount_; }
+    glm::ivec2 GetTileSize(size_t tileIdx) const noexcept;
+private:
+    MappedFile file_;
+    MappedView view_;
+    GridFileHeader header_{};
+    std::span<const GridFileTile> tiles_;
+    glm::ivec2 tileCount_{0, 0};
+
+    void DecodeTile(size_t tileIdx, float *output) const;
+    size_t GetSampleSize() const noexcept { return GetConcentrationSampleSize((ConcentrationFormat)header_.DataType); }
+};
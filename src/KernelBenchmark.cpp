@@ -0,0 +1,87 @@
+#include "KernelBenchmark.hpp"
+#include "SimulationController.hpp"
+#include <array>
+#include <random>
+#include <utility>
+#include <algorithm>
+
+constexpr glm::vec2 c_KernelBenchmarkGridSize {1000.0f, 500.0f};
+constexpr uint32_t c_KernelBenchmarkSeed = 1234;
+// (shared emitter staging, fast variant) of every timed variant.
+constexpr std::array<std::pair<bool, bool>, 3> c_KernelBenchmarkVariants {
+    std::make_pair(false, false),
+    std::make_pair(true, false),
+    std::make_pair(true, true),
+};
+
+static std::vector<EmitterInfo> MakeEmitters(const glm::vec2 &gridSize, size_t count)
+{
+    std::mt19937 rng(c_KernelBenchmarkSeed);
+    std::uniform_real_distribution<float> x(0.0f, gridSize.x);
+    std::uniform_real_distribution<float> y(-gridSize.y, gridSize.y);
+    std::uniform_real_distribution<float> height(10.0f, 200.0f);
+    std::uniform_real_distribution<float> emissionRate(10.0f, 1000.0f);
+
+    std::vector<EmitterInfo> emitters(count);
+    for (auto &emitter : emitters)
+    {
+        emitter.Position = {x(rng), y(rng)};
+        emitter.Height = height(rng);
+        emitter.EmissionRate = emissionRate(rng);
+    }
+
+    return emitters;
+}
+
+std::vector<KernelBenchmarkResult> RunKernelBenchmark(
+    const glm::ivec2 &resolution,
+    std::span<const size_t> emitterCounts,
+    size_t iterations)
+{
+    SimulationController controller(c_KernelBenchmarkGridSize, resolution);
+    controller.SetBackend(SimulationBackend::GPU);
+    controller.SetIncrementalUpdates(false);
+
+    std::vector<KernelBenchmarkResult> results;
+    std::vector<double> times;
+    for (const auto emittersCount : emitterCounts)
+    {
+        const auto emitters = MakeEmitters(c_KernelBenchmarkGridSize, emittersCount);
+        for (const auto &[sharedEmitterStaging, isFast] : c_KernelBenchmarkVariants)
+        {
+            controller.SetSharedEmitterStaging(sharedEmitterStaging);
+            controller.SetAccuracyBudget(isFast ? c_FastKernelVariants.back().MaxRelativeError : 0.0f);
+
+            // The first run builds the shader variant, grows the buffers and checks the accuracy budget, so it is
+            // not measured.
+            times.clear();
+            for (size_t i = 0; i <= iterations; i++)
+            {
+                controller.SetEmitters(emitters);
+                controller.Calculate();
+                glFinish();
+
+                SimulationTiming timing;
+                while (controller.HasPendingTimings())
+                {
+                    if (controller.PollTiming(timing) && i != 0)
+                        times.emplace_back(timing.DispatchTime);
+                }
+            }
+
+            std::sort(times.begin(), times.end());
+            const auto dispatchTime = times.empty() ? 0.0 : times[times.size() / 2];
+            const auto pairs = (double)resolution.x * (double)resolution.y * (double)emittersCount;
+            results.emplace_back(KernelBenchmarkResult{
+                .EmittersCount = emittersCount,
+                .SharedEmitterStaging = sharedEmitterStaging,
+                .ExpDegree = controller.GetExpDegree(),
+                .MaxRelativeError = controller.GetKernelError(),
+                .DispatchTime = dispatchTime,
+                .Throughput = dispatchTime > 0.0 ? pairs / dispatchTime : 0.0,
+            });
+        }
+    }
+
+    return results;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <glm/vec2.hpp>
+
+struct KernelBenchmarkResult
+{
+    size_t EmittersCount;
+    bool SharedEmitterStaging;
+    // Degree of the exp polynomial kept by the accuracy check for the fast variant, 0 for the exact kernel.
+    int ExpDegree;
+    // Largest error of that kernel relative to the exact one, measured by SimulationController.
+    float MaxRelativeError;
+    // Median GPU time of the binning and main dispatches [s].
+    double DispatchTime;
+    // Emitter-cell pairs evaluated per second.
+    double Throughput;
+};
+
+// Times the direct, the staged and the staged fast variant of the GPU kernel, in this order, for every emitter
+// count on a fresh SimulationController, using randomly placed emitters and no culling. The fast variant runs with
+// the smallest accuracy budget that admits one. Needs a current GL context and blocks until done.
+std::vector<KernelBenchmarkResult> RunKernelBenchmark(
+    const glm::ivec2 &resolution,
+    std::span<const size_t> emitterCounts,
+    size_t iterations);
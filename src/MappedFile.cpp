@@ -0,0 +1,215 @@
+#include "MappedFile.hpp"
+#include <utility>
+#include <stdexcept>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+static uint64_t GetMappingGranularity() noexcept
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+MappedView::MappedView(void *base, size_t baseSize, size_t offsetInBase, size_t size) noexcept
+    : base_(base), baseSize_(baseSize), data_(static_cast<std::byte*>(base) + offsetInBase), size_(size)
+{
+}
+
+MappedView::MappedView(MappedView &&other) noexcept
+{
+    base_ = std::exchange(other.base_, nullptr);
+    baseSize_ = std::exchange(other.baseSize_, 0);
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+}
+
+MappedView::~MappedView() noexcept
+{
+    Unmap();
+}
+
+MappedView &MappedView::operator=(MappedView &&other) noexcept
+{
+    Unmap();
+    base_ = std::exchange(other.base_, nullptr);
+    baseSize_ = std::exchange(other.baseSize_, 0);
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+
+    return *this;
+}
+
+void MappedView::Flush()
+{
+    if (!base_)
+        return;
+
+#ifdef _WIN32
+    if (!FlushViewOfFile(base_, baseSize_))
+        throw std::runtime_error("Failed to flush mapped file view.");
+#else
+    if (msync(base_, baseSize_, MS_SYNC) != 0)
+        throw std::runtime_error("Failed to flush mapped file view.");
+#endif
+}
+
+void MappedView::Unmap() noexcept
+{
+    if (!base_)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(base_);
+#else
+    munmap(base_, baseSize_);
+#endif
+    base_ = nullptr;
+}
+
+MappedFile::MappedFile(const std::filesystem::path &path)
+    : readOnly_(true)
+{
+#ifdef _WIN32
+    file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        file_ = nullptr;
+        throw std::runtime_error("Failed to open mapped file.");
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file_, &fileSize);
+    size_ = (uint64_t)fileSize.QuadPart;
+
+    mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_)
+    {
+        Close();
+        throw std::runtime_error("Failed to create file mapping.");
+    }
+#else
+    file_ = open(path.c_str(), O_RDONLY);
+    if (file_ < 0)
+        throw std::runtime_error("Failed to open mapped file.");
+
+    struct stat fileStat;
+    if (fstat(file_, &fileStat) != 0)
+    {
+        Close();
+        throw std::runtime_error("Failed to query mapped file size.");
+    }
+    size_ = (uint64_t)fileStat.st_size;
+#endif
+}
+
+MappedFile::MappedFile(const std::filesystem::path &path, uint64_t size)
+    : size_(size)
+{
+#ifdef _WIN32
+    file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        file_ = nullptr;
+        throw std::runtime_error("Failed to create mapped file.");
+    }
+
+    mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+    if (!mapping_)
+    {
+        Close();
+        throw std::runtime_error("Failed to create file mapping.");
+    }
+#else
+    file_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file_ < 0)
+        throw std::runtime_error("Failed to create mapped file.");
+
+    if (ftruncate(file_, (off_t)size) != 0)
+    {
+        Close();
+        throw std::runtime_error("Failed to resize mapped file.");
+    }
+#endif
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+#ifdef _WIN32
+    file_ = std::exchange(other.file_, nullptr);
+    mapping_ = std::exchange(other.mapping_, nullptr);
+#else
+    file_ = std::exchange(other.file_, -1);
+#endif
+    size_ = std::exchange(other.size_, 0);
+    readOnly_ = std::exchange(other.readOnly_, false);
+}
+
+MappedFile::~MappedFile() noexcept
+{
+    Close();
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    Close();
+#ifdef _WIN32
+    file_ = std::exchange(other.file_, nullptr);
+    mapping_ = std::exchange(other.mapping_, nullptr);
+#else
+    file_ = std::exchange(other.file_, -1);
+#endif
+    size_ = std::exchange(other.size_, 0);
+    readOnly_ = std::exchange(other.readOnly_, false);
+
+    return *this;
+}
+
+MappedView MappedFile::Map(uint64_t offset, size_t size) const
+{
+    if (offset + size > size_)
+        throw std::out_of_range("Mapped view exceeds the file size.");
+
+    const auto granularity = GetMappingGranularity();
+    const auto baseOffset = offset / granularity * granularity;
+    const auto offsetInBase = (size_t)(offset - baseOffset);
+    const auto baseSize = offsetInBase + size;
+
+#ifdef _WIN32
+    void *base = MapViewOfFile(mapping_, readOnly_ ? FILE_MAP_READ : FILE_MAP_WRITE, (DWORD)(baseOffset >> 32), (DWORD)baseOffset, baseSize);
+    if (!base)
+        throw std::runtime_error("Failed to map file view.");
+#else
+    const auto protection = readOnly_ ? PROT_READ : PROT_READ | PROT_WRITE;
+    void *base = mmap(nullptr, baseSize, protection, MAP_SHARED, file_, (off_t)baseOffset);
+    if (base == MAP_FAILED)
+        throw std::runtime_error("Failed to map file view.");
+#endif
+
+    return MappedView(base, baseSize, offsetInBase, size);
+}
+
+void MappedFile::Close() noexcept
+{
+#ifdef _WIN32
+    if (mapping_)
+        CloseHandle(std::exchange(mapping_, nullptr));
+    if (file_)
+        CloseHandle(std::exchange(file_, nullptr));
+#else
+    if (file_ >= 0)
+        close(std::exchange(file_, -1));
+#endif
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Read-write view of a byte range of a MappedFile. Unmapping hands the pages back to the OS, so only the
+// views currently alive count towards resident memory.
+class MappedView
+{
+public:
+    MappedView() = default;
+    MappedView(const MappedView&) = delete;
+    MappedView(MappedView&& other) noexcept;
+
+    ~MappedView() noexcept;
+
+    MappedView& operator=(MappedView&& other) noexcept;
+
+    // Blocks until the view's dirty pages are written to the file.
+    void Flush();
+
+    constexpr std::byte* GetData() const noexcept { return data_; }
+    constexpr size_t GetSize() const noexcept { return size_; }
+private:
+    friend class MappedFile;
+
+    // The mapping starts at an allocation-granularity boundary at or before the requested offset.
+    void *base_ = nullptr;
+    size_t baseSize_ = 0;
+    std::byte *data_ = nullptr;
+    size_t size_ = 0;
+
+    MappedView(void *base, size_t baseSize, size_t offsetInBase, size_t size) noexcept;
+    void Unmap() noexcept;
+};
+
+// File of a fixed size that is accessed through memory-mapped views, for data too large to keep in RAM.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    // Opens an existing file read-only; writing through its views is not allowed.
+    explicit MappedFile(const std::filesystem::path &path);
+    // Creates (or truncates) the file and resizes it to `size` bytes.
+    MappedFile(const std::filesystem::path &path, uint64_t size);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+
+    ~MappedFile() noexcept;
+
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    MappedView Map(uint64_t offset, size_t size) const;
+
+    constexpr uint64_t GetSize() const noexcept { return size_; }
+    constexpr bool IsReadOnly() const noexcept { return readOnly_; }
+private:
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#else
+    int file_ = -1;
+#endif
+    uint64_t size_ = 0;
+    bool readOnly_ = false;
+
+    void Close() noexcept;
+};
@@ -1,5 +1,8 @@
 #include "Buffer.hpp"
 #include <limits>
+#include <cstring>
+#include <utility>
+#include <algorithm>
 #include <stdexcept>
 
 Buffer::Buffer(const void *data, GLsizeiptr size) noexcept
@@ -12,6 +15,7 @@ Buffer::Buffer(const void *data, GLsizeiptr size) noexcept
 Buffer::Buffer(Buffer &&other) noexcept
 {
     id_ = std::exchange(other.id_, 0);
+    size_ = std::exchange(other.size_, 0);
 }
 
 Buffer::~Buffer() noexcept
@@ -21,7 +25,9 @@ Buffer::~Buffer() noexcept
 
 Buffer &Buffer::operator=(Buffer &&other) noexcept
 {
+    glDeleteBuffers(1, &id_);
     id_ = std::exchange(other.id_, 0);
+    size_ = std::exchange(other.size_, 0);
 
     return *this;
 }
@@ -38,3 +44,137 @@ void Buffer::Write(const void *data, GLsizeiptr dataSize, GLintptr offset)
 {
     glNamedBufferSubData(id_, offset, dataSize, data);
 }
+
+static GLsizeiptr GetRingSegmentAlignment() noexcept
+{
+    GLint uniformAlignment = 1;
+    GLint storageAlignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+
+    return std::max<GLsizeiptr>({uniformAlignment, storageAlignment, 1});
+}
+
+RingBuffer::RingBuffer(GLsizeiptr segmentSize, GLuint segmentCount)
+    : fences_(segmentCount, nullptr)
+{
+    if (segmentCount == 0)
+        throw std::invalid_argument("Ring buffer needs at least one segment.");
+
+    Allocate(segmentSize);
+}
+
+RingBuffer::RingBuffer(RingBuffer &&other) noexcept
+{
+    fences_ = std::exchange(other.fences_, {});
+    mapped_ = std::exchange(other.mapped_, nullptr);
+    id_ = std::exchange(other.id_, 0);
+    segmentSize_ = std::exchange(other.segmentSize_, 0);
+    currentSegment_ = std::exchange(other.currentSegment_, 0);
+}
+
+RingBuffer::~RingBuffer() noexcept
+{
+    Free();
+}
+
+RingBuffer &RingBuffer::operator=(RingBuffer &&other) noexcept
+{
+    Free();
+    fences_ = std::exchange(other.fences_, {});
+    mapped_ = std::exchange(other.mapped_, nullptr);
+    id_ = std::exchange(other.id_, 0);
+    segmentSize_ = std::exchange(other.segmentSize_, 0);
+    currentSegment_ = std::exchange(other.currentSegment_, 0);
+
+    return *this;
+}
+
+std::byte *RingBuffer::Acquire(GLsizeiptr size)
+{
+    // Default-constructed and moved-from rings have no segments to cycle through.
+    if (fences_.empty())
+        throw std::logic_error("Ring buffer has no segments.");
+
+    if (size > segmentSize_)
+    {
+        // GL keeps the old storage alive until the commands still reading it complete.
+        Free();
+        Allocate(std::max(size, segmentSize_ * 2));
+    }
+
+    currentSegment_ = (currentSegment_ + 1) % (GLuint)fences_.size();
+
+    auto &fence = fences_[currentSegment_];
+    if (fence)
+    {
+        GLenum waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (waitResult == GL_TIMEOUT_EXPIRED)
+            waitResult = glClientWaitSync(fence, 0, 1'000'000);
+
+        if (waitResult == GL_WAIT_FAILED)
+            throw std::runtime_error("Failed to wait for ring buffer segment fence.");
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    return mapped_ + GetSegmentOffset();
+}
+
+void RingBuffer::Write(const void *data, GLsizeiptr dataSize)
+{
+    std::memcpy(Acquire(dataSize), data, (size_t)dataSize);
+}
+
+void RingBuffer::Release()
+{
+    if (fences_.empty())
+        throw std::logic_error("Ring buffer has no segments.");
+
+    auto &fence = fences_[currentSegment_];
+    if (fence)
+        glDeleteSync(fence);
+
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void RingBuffer::BindRange(GLenum target, GLuint binding) const noexcept
+{
+    glBindBufferRange(target, binding, id_, GetSegmentOffset(), segmentSize_);
+}
+
+void RingBuffer::Allocate(GLsizeiptr segmentSize)
+{
+    const auto alignment = GetRingSegmentAlignment();
+    segmentSize_ = (std::max<GLsizeiptr>(segmentSize, 1) + alignment - 1) / alignment * alignment;
+    currentSegment_ = 0;
+
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const auto totalSize = segmentSize_ * (GLsizeiptr)fences_.size();
+
+    glCreateBuffers(1, &id_);
+    glNamedBufferStorage(id_, totalSize, nullptr, flags);
+
+    mapped_ = static_cast<std::byte*>(glMapNamedBufferRange(id_, 0, totalSize, flags));
+    if (!mapped_)
+        throw std::runtime_error("Failed to map ring buffer.");
+}
+
+void RingBuffer::Free() noexcept
+{
+    for (auto &fence : fences_)
+    {
+        if (fence)
+            glDeleteSync(std::exchange(fence, nullptr));
+    }
+
+    if (id_)
+    {
+        glUnmapNamedBuffer(id_);
+        glDeleteBuffers(1, &id_);
+    }
+
+    id_ = 0;
+    mapped_ = nullptr;
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include <span>
+#include <vector>
+#include <cstddef>
 #include <glad/gl.h>
 
 class Buffer
@@ -24,6 +26,44 @@ public:
     constexpr GLuint GetID() const noexcept { return id_; }
     constexpr GLsizeiptr GetSize() const noexcept { return size_; }
 private:
-    GLuint id_;
-    GLsizeiptr size_;
-};
\ No newline at end of file
+    GLuint id_ = 0;
+    GLsizeiptr size_ = 0;
+};
+
+// Persistently mapped buffer split into equally sized segments that are written round-robin, one per
+// submission. Each segment is guarded by a fence, so writes are plain memcpy into memory the GPU is
+// guaranteed not to be reading anymore, without any driver-side copy or implicit synchronization.
+class RingBuffer
+{
+public:
+    RingBuffer() = default;
+    RingBuffer(GLsizeiptr segmentSize, GLuint segmentCount = 3);
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer(RingBuffer&& other) noexcept;
+
+    ~RingBuffer() noexcept;
+
+    RingBuffer& operator=(RingBuffer&& other) noexcept;
+
+    // Moves to the next segment, waiting for the GPU to release it, and returns its mapped memory.
+    // Segments grow geometrically when `size` does not fit. Like Release(), throws std::logic_error on a
+    // default-constructed or moved-from ring.
+    std::byte* Acquire(GLsizeiptr size);
+    void Write(const void *data, GLsizeiptr dataSize);
+    // Fences the current segment; call after submitting the commands that read it.
+    void Release();
+    void BindRange(GLenum target, GLuint binding) const noexcept;
+
+    constexpr GLuint GetID() const noexcept { return id_; }
+    constexpr GLsizeiptr GetSegmentSize() const noexcept { return segmentSize_; }
+    constexpr GLintptr GetSegmentOffset() const noexcept { return (GLintptr)currentSegment_ * segmentSize_; }
+private:
+    std::vector<GLsync> fences_;
+    std::byte *mapped_ = nullptr;
+    GLuint id_ = 0;
+    GLsizeiptr segmentSize_ = 0;
+    GLuint currentSegment_ = 0;
+
+    void Allocate(GLsizeiptr segmentSize);
+    void Free() noexcept;
+};
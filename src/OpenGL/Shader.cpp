@@ -2,7 +2,80 @@
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <format>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+constexpr uint32_t c_ProgramBinaryMagic = 0x42505345; // "ESPB"
+
+struct ProgramBinaryHeader
+{
+    uint32_t Magic;
+    GLenum BinaryFormat;
+    uint64_t Key;
+    uint64_t BinarySize;
+};
+
+static uint64_t HashBytes(uint64_t hash, const void *data, size_t size) noexcept
+{
+    // FNV-1a
+    const auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static uint64_t HashString(uint64_t hash, const std::string_view str) noexcept
+{
+    // The terminator keeps adjacent strings from running into each other.
+    return HashBytes(HashBytes(hash, str.data(), str.size()), "", 1);
+}
+
+static std::string ReadSourceFile(const std::string_view filepath)
+{
+    std::ifstream file(std::string{filepath}, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error(std::format("Failed to open shader stage source file {}.", filepath));
+
+    std::ostringstream source;
+    source << file.rdbuf();
+    return std::move(source).str();
+}
+
+// Everything before the first line after #version must stay in place, so the defines go right after it.
+// A #line directive keeps the line numbers in compile errors matching the file.
+static std::string InjectDefines(const std::string_view source, const std::vector<ShaderDefine> &defines)
+{
+    if (defines.empty())
+        return std::string{source};
+
+    size_t insertAt = 0;
+    size_t line = 1;
+    const auto versionPos = source.find("#version");
+    if (versionPos != std::string_view::npos)
+    {
+        const auto lineEnd = source.find('\n', versionPos);
+        insertAt = lineEnd == std::string_view::npos ? source.size() : lineEnd + 1;
+        line = (size_t)std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+    }
+
+    std::string result{source.substr(0, insertAt)};
+    if (insertAt != 0 && result.back() != '\n')
+        result += '\n';
+    for (const auto &define : defines)
+        result += std::format("#define {} {}\n", define.Name, define.Value);
+    result += std::format("#line {}\n", line);
+    result += source.substr(insertAt);
+
+    return result;
+}
 
 static GLuint CreateStage(GLenum type, const std::string_view source)
 {
@@ -14,13 +87,16 @@ static GLuint CreateStage(GLenum type, const std::string_view source)
 
     glCompileShader(stage);
 
-    GLint logLength = 0;
-    glGetShaderiv(stage, GL_INFO_LOG_LENGTH, &logLength);
-
-    if (logLength != 0)
+    GLint compileStatus = GL_FALSE;
+    glGetShaderiv(stage, GL_COMPILE_STATUS, &compileStatus);
+    if (compileStatus != GL_TRUE)
     {
+        GLint logLength = 0;
+        glGetShaderiv(stage, GL_INFO_LOG_LENGTH, &logLength);
+
         std::string infoLog(logLength, '\0');
         glGetShaderInfoLog(stage, infoLog.size() * sizeof(char), nullptr, infoLog.data());
+        glDeleteShader(stage);
 
         std::cerr << std::format("Failed to compile shader stage:\n{}\n", infoLog);
         throw std::runtime_error("Failed to compile shader stage.");
@@ -29,71 +105,217 @@ static GLuint CreateStage(GLenum type, const std::string_view source)
     return stage;
 }
 
-static GLuint CreateStageFromFile(GLenum type, const std::string_view filepath)
+static bool LoadProgramBinary(GLuint program, const std::filesystem::path &filepath, uint64_t key)
 {
-    std::ifstream file;
-    file.open(filepath.data());
+    std::ifstream file(filepath, std::ios::binary);
     if (!file.is_open())
-        throw std::runtime_error("Failed to open shader stage source file.");
+        return false;
+
+    ProgramBinaryHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.Magic != c_ProgramBinaryMagic || header.Key != key)
+        return false;
 
-    std::vector<char> source(2048);
+    // A truncated or corrupt cache file must not make us allocate more than it can hold.
+    const auto dataStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    const auto remainingSize = (uint64_t)(file.tellg() - dataStart);
+    if (header.BinarySize > remainingSize || header.BinarySize > (uint64_t)std::numeric_limits<GLsizei>::max())
+        return false;
+    file.seekg(dataStart);
 
-    size_t offset = 0;
-    while (true)
+    std::vector<char> binary(header.BinarySize);
+    file.read(binary.data(), binary.size());
+    if ((size_t)file.gcount() != binary.size())
+        return false;
+
+    // The driver rejects binaries it can no longer use (e.g. after an update it does not report in GL_VERSION),
+    // which leaves the program unlinked.
+    glProgramBinary(program, header.BinaryFormat, binary.data(), (GLsizei)binary.size());
+
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    return linkStatus == GL_TRUE;
+}
+
+static void SaveProgramBinary(GLuint program, const std::filesystem::path &filepath, uint64_t key)
+{
+    GLint binarySize = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0)
+        return;
+
+    ProgramBinaryHeader header = {
+        .Magic = c_ProgramBinaryMagic,
+        .BinaryFormat = 0,
+        .Key = key,
+        .BinarySize = (uint64_t)binarySize,
+    };
+    std::vector<char> binary(binarySize);
+    glGetProgramBinary(program, binarySize, nullptr, &header.BinaryFormat, binary.data());
+
+    // The cache is only an optimization, so failing to write it is not an error.
+    std::error_code error;
+    std::filesystem::create_directories(filepath.parent_path(), error);
+
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), binary.size());
+}
+
+Shader::Shader(
+    const std::vector<ShaderStage> &stages,
+    const std::vector<ShaderDefine> &defines,
+    const std::filesystem::path &binaryCacheDirectory)
+    : defines_(defines), binaryCacheDirectory_(binaryCacheDirectory)
+{
+    stages_.reserve(stages.size());
+    for (const auto &stage : stages)
     {
-        file.read(source.data() + offset, 2048);
-        offset += (size_t)file.gcount();
-        if (offset >= source.max_size())
-            source.reserve(source.max_size() + 2048);
-        else
-            break;
-    }
+        std::filesystem::file_time_type writeTime;
+        if (stage.IsFromFile)
+        {
+            std::error_code error;
+            writeTime = std::filesystem::last_write_time(stage.SourceOrFilepath, error);
+        }
 
-    source.resize(offset);
+        stages_.emplace_back(StageSource{
+            .Type = stage.Type,
+            .SourceOrFilepath = std::string{stage.SourceOrFilepath},
+            .IsFromFile = stage.IsFromFile,
+            .WriteTime = writeTime,
+        });
+    }
 
-    return CreateStage(type, std::string_view{source.data(), offset});
+    id_ = CreateProgram();
 }
 
-Shader::Shader(const std::vector<ShaderStage> &stages)
+GLuint Shader::CreateProgram() const
 {
-    id_ = glCreateProgram();
+    std::vector<std::string> sources;
+    sources.reserve(stages_.size());
+    for (const auto &stage : stages_)
+        sources.emplace_back(InjectDefines(
+            stage.IsFromFile ? ReadSourceFile(stage.SourceOrFilepath) : stage.SourceOrFilepath,
+            defines_));
+
+    GLuint program = glCreateProgram();
+
+    // Binaries are only valid for the driver that produced them, so it is part of the key along with the sources.
+    std::filesystem::path binaryPath;
+    uint64_t key = 0xcbf29ce484222325ull;
+    if (!binaryCacheDirectory_.empty())
+    {
+        for (const auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+            key = HashString(key, reinterpret_cast<const char*>(glGetString(name)));
+        for (size_t i = 0; i < stages_.size(); i++)
+        {
+            key = HashBytes(key, &stages_[i].Type, sizeof(GLenum));
+            key = HashString(key, sources[i]);
+        }
+
+        binaryPath = binaryCacheDirectory_ / std::format("{:016x}.bin", key);
+        if (LoadProgramBinary(program, binaryPath, key))
+            return program;
+
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
 
     std::vector<GLuint> stageIDs;
-    stageIDs.reserve(stages.size());
-    for (const auto& stage : stages)
+    stageIDs.reserve(stages_.size());
+    try
     {
-        const auto stageID = stage.IsFromFile
-            ? CreateStageFromFile(stage.Type, stage.SourceOrFilepath)
-            : CreateStage(stage.Type, stage.SourceOrFilepath);
-        glAttachShader(id_, stageID);
-        stageIDs.emplace_back(stageID);
+        for (size_t i = 0; i < stages_.size(); i++)
+        {
+            const auto stageID = CreateStage(stages_[i].Type, sources[i]);
+            glAttachShader(program, stageID);
+            stageIDs.emplace_back(stageID);
+        }
+    }
+    catch (...)
+    {
+        for (const auto stageID : stageIDs)
+            glDeleteShader(stageID);
+        glDeleteProgram(program);
+        throw;
     }
 
-    glLinkProgram(id_);
+    glLinkProgram(program);
 
     for (const auto stageID : stageIDs)
     {
-        glDetachShader(id_, stageID);
+        glDetachShader(program, stageID);
         glDeleteShader(stageID);
     }
 
-    GLint logLength = 0;
-    glGetProgramiv(id_, GL_INFO_LOG_LENGTH, &logLength);
-
-    if (logLength != 0)
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE)
     {
+        GLint logLength = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+
         std::string infoLog(logLength, '\0');
-        glGetProgramInfoLog(id_, infoLog.size() * sizeof(char), nullptr, infoLog.data());
+        glGetProgramInfoLog(program, infoLog.size() * sizeof(char), nullptr, infoLog.data());
+        glDeleteProgram(program);
 
         std::cerr << std::format("Failed to link shader:\n{}\n", infoLog);
         throw std::runtime_error("Failed to link shader.");
     }
+
+    if (!binaryCacheDirectory_.empty())
+        SaveProgramBinary(program, binaryPath, key);
+
+    return program;
+}
+
+bool Shader::ReloadIfChanged()
+{
+    auto changed = false;
+    for (auto &stage : stages_)
+    {
+        if (!stage.IsFromFile)
+            continue;
+
+        // Editors may briefly remove the file while saving, that is picked up on a later call.
+        std::error_code error;
+        const auto writeTime = std::filesystem::last_write_time(stage.SourceOrFilepath, error);
+        if (error || writeTime == stage.WriteTime)
+            continue;
+
+        stage.WriteTime = writeTime;
+        changed = true;
+    }
+
+    if (!changed)
+        return false;
+
+    try
+    {
+        const auto program = CreateProgram();
+        glDeleteProgram(id_);
+        id_ = program;
+        interface_.clear();
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << std::format("Failed to reload shader, keeping the previous program: {}\n", e.what());
+        return false;
+    }
+
+    return true;
 }
 
 Shader::Shader(Shader &&other) noexcept
 {
     id_ = std::exchange(other.id_, 0);
     interface_ = std::move(other.interface_);
+    stages_ = std::move(other.stages_);
+    defines_ = std::move(other.defines_);
+    binaryCacheDirectory_ = std::move(other.binaryCacheDirectory_);
 }
 
 Shader::~Shader() noexcept
@@ -103,8 +325,15 @@ Shader::~Shader() noexcept
 
 Shader &Shader::operator=(Shader &&other) noexcept
 {
-    id_ = std::exchange(other.id_, 0);
-    interface_ = std::move(other.interface_);
+    if (this != &other)
+    {
+        glDeleteProgram(id_);
+        id_ = std::exchange(other.id_, 0);
+        interface_ = std::move(other.interface_);
+        stages_ = std::move(other.stages_);
+        defines_ = std::move(other.defines_);
+        binaryCacheDirectory_ = std::move(other.binaryCacheDirectory_);
+    }
     return *this;
 }
 
@@ -128,6 +357,26 @@ void Shader::BindShaderStorageBuffer(GLuint binding, const Buffer &buffer)
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.GetID());
 }
 
+void Shader::BindShaderStorageBuffer(GLuint binding, const RingBuffer &buffer)
+{
+    buffer.BindRange(GL_SHADER_STORAGE_BUFFER, binding);
+}
+
+void Shader::SetUniform(GLint location, int value) noexcept
+{
+    glProgramUniform1i(id_, location, value);
+}
+
+void Shader::SetUniform(GLint location, GLuint value) noexcept
+{
+    glProgramUniform1ui(id_, location, value);
+}
+
+void Shader::SetUniform(GLint location, float value) noexcept
+{
+    glProgramUniform1f(id_, location, value);
+}
+
 GLuint Shader::GetUniformBlockLocation(const std::string_view name)
 {
     const auto it = interface_.find(name);
@@ -1,5 +1,6 @@
 #pragma once
 #include <filesystem>
+#include <string>
 #include <string_view>
 #include <vector>
 #include <unordered_map>
@@ -14,11 +15,23 @@ struct ShaderStage
     bool IsFromFile = true;
 };
 
+struct ShaderDefine
+{
+    std::string Name;
+    std::string Value;
+};
+
 class Shader
 {
 public:
     Shader() = default;
-    Shader(const std::vector<ShaderStage> &stages);
+    // The defines are inserted into every stage right after its #version directive.
+    // With a non-empty binaryCacheDirectory, linked programs are stored there and reused by later runs
+    // whose sources, defines and driver match, skipping compilation.
+    Shader(
+        const std::vector<ShaderStage> &stages,
+        const std::vector<ShaderDefine> &defines = {},
+        const std::filesystem::path &binaryCacheDirectory = {});
     Shader(const Shader&) = delete;
     Shader(Shader&& other) noexcept;
 
@@ -26,16 +39,36 @@ public:
 
     Shader& operator=(Shader&& other) noexcept;
 
+    // Rebuilds the program if any stage source file was modified since it was last built.
+    // On failure the error is reported and the previous program stays in use. Returns whether the program changed.
+    bool ReloadIfChanged();
     void Use();
     void BindUniformBuffer(const std::string_view uniformBlockName, const Buffer &buffer);
     void BindUniformBuffer(GLuint binding, const Buffer &buffer);
     void BindShaderStorageBuffer(GLuint binding, const Buffer &buffer);
+    void BindShaderStorageBuffer(GLuint binding, const RingBuffer &buffer);
+    void SetUniform(GLint location, int value) noexcept;
+    void SetUniform(GLint location, GLuint value) noexcept;
+    void SetUniform(GLint location, float value) noexcept;
 
     constexpr GLuint GetID() const noexcept { return id_; }
 
 private:
+    struct StageSource
+    {
+        GLenum Type;
+        std::string SourceOrFilepath;
+        bool IsFromFile;
+        std::filesystem::file_time_type WriteTime;
+    };
+
     std::unordered_map<std::string, GLuint, StringHash, std::equal_to<>> interface_;
-    GLuint id_;
+    std::vector<StageSource> stages_;
+    std::vector<ShaderDefine> defines_;
+    std::filesystem::path binaryCacheDirectory_;
+    GLuint id_ = 0;
+
+    GLuint CreateProgram() const;
 
     GLuint GetUniformBlockLocation(const std::string_view name);
 };
\ No newline at end of file
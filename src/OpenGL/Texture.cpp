@@ -1,4 +1,7 @@
 #include "Texture.hpp"
+#include <stdexcept>
+#include <limits>
+#include <utility>
 
 Texture2D::Texture2D(GLsizei width, GLsizei height, GLenum format, GLsizei levels)
     : width_(width),
@@ -30,6 +33,7 @@ Texture2D::~Texture2D() noexcept
 
 Texture2D &Texture2D::operator=(Texture2D &&other) noexcept
 {
+    glDeleteTextures(1, &id_);
     id_ = std::exchange(other.id_, 0);
     width_ = other.width_;
     height_ = other.height_;
@@ -47,4 +51,156 @@ void Texture2D::Bind(GLuint unit) noexcept
 void Texture2D::BindImage(GLuint unit, GLenum access) noexcept
 {
     glBindImageTexture(unit, id_, 0, GL_FALSE, 0, access, format_);
-}
\ No newline at end of file
+}
+
+void Texture2D::Write(const void *data, GLenum dataFormat, GLenum dataType) noexcept
+{
+    Write({0, 0}, GetSize(), data, dataFormat, dataType);
+}
+
+void Texture2D::Write(const glm::ivec2 &offset, const glm::ivec2 &size, const void *data, GLenum dataFormat, GLenum dataType) noexcept
+{
+    // Rows of 16-bit single channel data are not 4-byte aligned for odd widths.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage2D(id_, 0, offset.x, offset.y, size.x, size.y, dataFormat, dataType, data);
+}
+
+void Texture2D::SetFilter(GLenum minFilter, GLenum magFilter) noexcept
+{
+    glTextureParameteri(id_, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTextureParameteri(id_, GL_TEXTURE_MAG_FILTER, magFilter);
+}
+
+void Texture2D::Read(void *data, GLsizei dataSize, GLenum dataFormat, GLenum dataType) const noexcept
+{
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureImage(id_, 0, dataFormat, dataType, dataSize, data);
+}
+
+void Texture2D::Read(const glm::ivec2 &offset, const glm::ivec2 &size, void *data, GLsizei dataSize, GLenum dataFormat, GLenum dataType) const noexcept
+{
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureSubImage(id_, 0, offset.x, offset.y, 0, size.x, size.y, 1, dataFormat, dataType, dataSize, data);
+}
+
+void Texture2D::Read(GLuint buffer, GLsizei dataSize, GLenum dataFormat, GLenum dataType) const noexcept
+{
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glGetTextureImage(id_, 0, dataFormat, dataType, dataSize, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+TextureReadbackRing::TextureReadbackRing(GLuint slotCount)
+    : slots_(slotCount)
+{
+    if (slotCount == 0)
+        throw std::invalid_argument("Readback ring needs at least one slot.");
+}
+
+TextureReadbackRing::TextureReadbackRing(TextureReadbackRing &&other) noexcept
+{
+    slots_ = std::move(other.slots_);
+    head_ = std::exchange(other.head_, 0);
+    pendingSlots_ = std::exchange(other.pendingSlots_, 0);
+}
+
+TextureReadbackRing::~TextureReadbackRing() noexcept
+{
+    Free();
+}
+
+TextureReadbackRing &TextureReadbackRing::operator=(TextureReadbackRing &&other) noexcept
+{
+    Free();
+    slots_ = std::move(other.slots_);
+    head_ = std::exchange(other.head_, 0);
+    pendingSlots_ = std::exchange(other.pendingSlots_, 0);
+
+    return *this;
+}
+
+int TextureReadbackRing::Request(const Texture2D &texture, GLsizeiptr dataSize, GLenum dataFormat, GLenum dataType)
+{
+    if (dataSize > std::numeric_limits<GLsizei>::max())
+        throw std::out_of_range("Readback exceeds the largest texture copy.");
+    if (IsFull())
+        return -1;
+
+    auto &slot = slots_[head_];
+    if (dataSize > slot.Capacity)
+    {
+        // The slot is not pending, so nothing still writes to the old storage.
+        if (slot.Buffer)
+        {
+            glUnmapNamedBuffer(slot.Buffer);
+            glDeleteBuffers(1, &slot.Buffer);
+        }
+
+        constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glCreateBuffers(1, &slot.Buffer);
+        glNamedBufferStorage(slot.Buffer, dataSize, nullptr, flags);
+        slot.Mapped = static_cast<const std::byte*>(glMapNamedBufferRange(slot.Buffer, 0, dataSize, flags));
+        if (!slot.Mapped)
+            throw std::runtime_error("Failed to map readback buffer.");
+
+        slot.Capacity = dataSize;
+    }
+
+    texture.Read(slot.Buffer, (GLsizei)dataSize, dataFormat, dataType);
+    slot.DataSize = dataSize;
+    slot.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    const auto slotIdx = (int)head_;
+    head_ = (head_ + 1) % (GLuint)slots_.size();
+    pendingSlots_++;
+
+    return slotIdx;
+}
+
+int TextureReadbackRing::Poll()
+{
+    if (pendingSlots_ == 0)
+        return -1;
+
+    const auto slotIdx = (head_ + (GLuint)slots_.size() - pendingSlots_) % (GLuint)slots_.size();
+    auto &slot = slots_[slotIdx];
+
+    // Flushing makes sure the fence is eventually signaled even if nothing else is submitted.
+    const auto waitResult = glClientWaitSync(slot.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (waitResult == GL_TIMEOUT_EXPIRED)
+        return -1;
+    if (waitResult == GL_WAIT_FAILED)
+        throw std::runtime_error("Failed to wait for readback fence.");
+
+    glDeleteSync(std::exchange(slot.Fence, nullptr));
+    pendingSlots_--;
+
+    return (int)slotIdx;
+}
+
+std::span<const std::byte> TextureReadbackRing::GetData(int slot) const noexcept
+{
+    const auto &readbackSlot = slots_[(size_t)slot];
+    return {readbackSlot.Mapped, (size_t)readbackSlot.DataSize};
+}
+
+void TextureReadbackRing::Free() noexcept
+{
+    for (auto &slot : slots_)
+    {
+        if (slot.Fence)
+            glDeleteSync(std::exchange(slot.Fence, nullptr));
+
+        if (slot.Buffer)
+        {
+            glUnmapNamedBuffer(slot.Buffer);
+            glDeleteBuffers(1, &slot.Buffer);
+        }
+
+        slot = {};
+    }
+
+    head_ = 0;
+    pendingSlots_ = 0;
+}
@@ -1,4 +1,7 @@
 #pragma once
+#include <span>
+#include <vector>
+#include <cstddef>
 #include <utility>
 #include <glad/gl.h>
 #include <glm/vec2.hpp>
@@ -19,15 +22,67 @@ public:
 
     void Bind(GLuint unit) noexcept;
     void BindImage(GLuint unit, GLenum access) noexcept;
+    void Write(const void *data, GLenum dataFormat, GLenum dataType) noexcept;
+    void Write(const glm::ivec2 &offset, const glm::ivec2 &size, const void *data, GLenum dataFormat, GLenum dataType) noexcept;
+    void SetFilter(GLenum minFilter, GLenum magFilter) noexcept;
+    void Read(void *data, GLsizei dataSize, GLenum dataFormat, GLenum dataType) const noexcept;
+    void Read(const glm::ivec2 &offset, const glm::ivec2 &size, void *data, GLsizei dataSize, GLenum dataFormat, GLenum dataType) const noexcept;
+    // Queues a copy of the texture into the pixel pack buffer `buffer`, starting at its first byte.
+    void Read(GLuint buffer, GLsizei dataSize, GLenum dataFormat, GLenum dataType) const noexcept;
 
     constexpr GLuint GetID() const noexcept { return id_; }
     constexpr GLsizei GetWidth() const noexcept { return width_; }
     constexpr GLsizei GetHeight() const noexcept { return height_; }
     constexpr glm::ivec2 GetSize() const noexcept { return glm::ivec2(width_, height_); }
+    constexpr GLenum GetFormat() const noexcept { return format_; }
 private:
-    GLuint id_;
-    GLsizei width_;
-    GLsizei height_;
-    GLsizei levels_;
-    GLenum format_;
-};
\ No newline at end of file
+    GLuint id_ = 0;
+    GLsizei width_ = 0;
+    GLsizei height_ = 0;
+    GLsizei levels_ = 0;
+    GLenum format_ = 0;
+};
+
+// Ring of persistently mapped pixel pack buffers that textures are read back through. Each copy is fenced
+// when it is queued and handed out only once its fence signaled, so reading back a texture every frame
+// never stalls the pipeline.
+class TextureReadbackRing
+{
+public:
+    TextureReadbackRing() = default;
+    TextureReadbackRing(GLuint slotCount);
+    TextureReadbackRing(const TextureReadbackRing&) = delete;
+    TextureReadbackRing(TextureReadbackRing&& other) noexcept;
+
+    ~TextureReadbackRing() noexcept;
+
+    TextureReadbackRing& operator=(TextureReadbackRing&& other) noexcept;
+
+    // Queues a copy of `texture` into the next free slot and returns it, or returns -1 and queues nothing if
+    // every slot still holds a copy that was not polled. Slots grow when `dataSize` does not fit. Throws if
+    // `dataSize` exceeds what a single texture copy can write (the range of GLsizei).
+    int Request(const Texture2D &texture, GLsizeiptr dataSize, GLenum dataFormat, GLenum dataType);
+    // Returns the slot of the oldest queued copy if it finished, or -1 without waiting. Its data stays valid
+    // until the next Request().
+    int Poll();
+    std::span<const std::byte> GetData(int slot) const noexcept;
+
+    constexpr GLuint GetSlotCount() const noexcept { return (GLuint)slots_.size(); }
+    constexpr bool HasPendingSlots() const noexcept { return pendingSlots_ != 0; }
+    constexpr bool IsFull() const noexcept { return pendingSlots_ == slots_.size(); }
+private:
+    struct Slot
+    {
+        GLuint Buffer = 0;
+        const std::byte *Mapped = nullptr;
+        GLsizeiptr Capacity = 0;
+        GLsizeiptr DataSize = 0;
+        GLsync Fence = nullptr;
+    };
+
+    std::vector<Slot> slots_;
+    GLuint head_ = 0;
+    GLuint pendingSlots_ = 0;
+
+    void Free() noexcept;
+};
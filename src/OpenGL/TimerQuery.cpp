@@ -0,0 +1,84 @@
+#include "TimerQuery.hpp"
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+TimestampQueryRing::TimestampQueryRing(GLuint timestampsPerFrame, GLuint frameCount)
+    : queries_((size_t)timestampsPerFrame * frameCount), timestampsPerFrame_(timestampsPerFrame), frameCount_(frameCount)
+{
+    if (queries_.empty())
+        throw std::invalid_argument("Timestamp query ring needs at least one frame and one timestamp.");
+
+    glCreateQueries(GL_TIMESTAMP, (GLsizei)queries_.size(), queries_.data());
+}
+
+TimestampQueryRing::TimestampQueryRing(TimestampQueryRing &&other) noexcept
+{
+    queries_ = std::move(other.queries_);
+    timestampsPerFrame_ = std::exchange(other.timestampsPerFrame_, 0);
+    frameCount_ = std::exchange(other.frameCount_, 0);
+    head_ = std::exchange(other.head_, 0);
+    pendingFrames_ = std::exchange(other.pendingFrames_, 0);
+    recording_ = std::exchange(other.recording_, false);
+}
+
+TimestampQueryRing::~TimestampQueryRing() noexcept
+{
+    glDeleteQueries((GLsizei)queries_.size(), queries_.data());
+}
+
+TimestampQueryRing &TimestampQueryRing::operator=(TimestampQueryRing &&other) noexcept
+{
+    glDeleteQueries((GLsizei)queries_.size(), queries_.data());
+    queries_ = std::move(other.queries_);
+    timestampsPerFrame_ = std::exchange(other.timestampsPerFrame_, 0);
+    frameCount_ = std::exchange(other.frameCount_, 0);
+    head_ = std::exchange(other.head_, 0);
+    pendingFrames_ = std::exchange(other.pendingFrames_, 0);
+    recording_ = std::exchange(other.recording_, false);
+
+    return *this;
+}
+
+bool TimestampQueryRing::BeginFrame() noexcept
+{
+    recording_ = frameCount_ != 0 && pendingFrames_ < frameCount_;
+    return recording_;
+}
+
+void TimestampQueryRing::Record(GLuint timestampIdx) noexcept
+{
+    if (recording_)
+        glQueryCounter(queries_[(size_t)head_ * timestampsPerFrame_ + timestampIdx], GL_TIMESTAMP);
+}
+
+void TimestampQueryRing::EndFrame() noexcept
+{
+    if (!recording_)
+        return;
+
+    head_ = (head_ + 1) % frameCount_;
+    pendingFrames_++;
+    recording_ = false;
+}
+
+int TimestampQueryRing::Poll(std::span<GLuint64> timestamps) noexcept
+{
+    if (pendingFrames_ == 0)
+        return -1;
+
+    const auto frame = (head_ + frameCount_ - pendingFrames_) % frameCount_;
+    const auto *frameQueries = queries_.data() + (size_t)frame * timestampsPerFrame_;
+
+    // Queries complete in submission order, so the last one being available implies all of them are.
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(frameQueries[timestampsPerFrame_ - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return -1;
+
+    for (size_t i = 0; i < std::min<size_t>(timestamps.size(), timestampsPerFrame_); i++)
+        glGetQueryObjectui64v(frameQueries[i], GL_QUERY_RESULT, &timestamps[i]);
+
+    pendingFrames_--;
+    return (int)frame;
+}
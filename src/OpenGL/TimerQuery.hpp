@@ -0,0 +1,40 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <glad/gl.h>
+
+// Ring of GL_TIMESTAMP query sets, one set per frame. Results are read back only once the driver
+// reports them available, a few frames after they were issued, so polling never stalls the pipeline.
+class TimestampQueryRing
+{
+public:
+    TimestampQueryRing() = default;
+    TimestampQueryRing(GLuint timestampsPerFrame, GLuint frameCount = 4);
+    TimestampQueryRing(const TimestampQueryRing&) = delete;
+    TimestampQueryRing(TimestampQueryRing&& other) noexcept;
+
+    ~TimestampQueryRing() noexcept;
+
+    TimestampQueryRing& operator=(TimestampQueryRing&& other) noexcept;
+
+    // Starts recording into the next free query set. Returns false and records nothing if every set
+    // is still waiting for its results.
+    bool BeginFrame() noexcept;
+    void Record(GLuint timestampIdx) noexcept;
+    void EndFrame() noexcept;
+    // Copies the timestamps of the oldest finished frame into `timestamps` and returns its frame slot,
+    // or -1 if no results are available yet.
+    int Poll(std::span<GLuint64> timestamps) noexcept;
+
+    constexpr GLuint GetTimestampsPerFrame() const noexcept { return timestampsPerFrame_; }
+    constexpr GLuint GetFrameCount() const noexcept { return frameCount_; }
+    constexpr int GetCurrentFrame() const noexcept { return recording_ ? (int)head_ : -1; }
+    constexpr bool HasPendingFrames() const noexcept { return pendingFrames_ != 0; }
+private:
+    std::vector<GLuint> queries_;
+    GLuint timestampsPerFrame_ = 0;
+    GLuint frameCount_ = 0;
+    GLuint head_ = 0;
+    GLuint pendingFrames_ = 0;
+    bool recording_ = false;
+};
@@ -17,6 +17,8 @@ SimulationConfig SimulationConfig::FromJSON(const nlohmann::json& data)
     data.at("depositionCoeff").get_to(config.DepositionCoeff);
     data.at("resolution").at(0).get_to(config.Resolution[0]);
     data.at("resolution").at(1).get_to(config.Resolution[1]);
+    config.CullingThreshold = data.value("cullingThreshold", 0.0f);
+    config.OutputFormat = ParseConcentrationFormat(data.value("outputFormat", "float32"));
 
     return config;
 }
@@ -35,6 +37,20 @@ nlohmann::json SimulationConfig::ToJSON() const
     json["windDir"] = WindDir;
     json["depositionCoeff"] = DepositionCoeff;
     json["resolution"] = nlohmann::json::array({Resolution.x, Resolution.y});
+    json["cullingThreshold"] = CullingThreshold;
+    json["outputFormat"] = GetConcentrationFormatName(OutputFormat);
 
     return json;
 }
+
+bool SimulationConfig::operator==(const SimulationConfig &other) const noexcept
+{
+    return Size == other.Size
+        && Stability == other.Stability
+        && WindSpeed == other.WindSpeed
+        && WindDir == other.WindDir
+        && DepositionCoeff == other.DepositionCoeff
+        && Resolution == other.Resolution
+        && CullingThreshold == other.CullingThreshold
+        && OutputFormat == other.OutputFormat;
+}
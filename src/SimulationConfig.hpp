@@ -1,8 +1,10 @@
 #pragma once
+#include <array>
 #include <string_view>
 #include <fstream>
 #include <nlohmann/json.hpp>
 #include <glm/vec2.hpp>
+#include "ConcentrationFormat.hpp"
 
 constexpr glm::vec2 AtmosphericStabilityA {0.22f, 0.20f};
 constexpr glm::vec2 AtmosphericStabilityB {0.16f, 0.12f};
@@ -10,6 +12,14 @@ constexpr glm::vec2 AtmosphericStabilityC {0.11f, 0.08f};
 constexpr glm::vec2 AtmosphericStabilityD {0.08f, 0.06f};
 constexpr glm::vec2 AtmosphericStabilityE {0.06f, 0.03f};
 constexpr glm::vec2 AtmosphericStabilityF {0.04f, 0.016f};
+constexpr std::array<glm::vec2, 6> AtmosphericStabilities {
+    AtmosphericStabilityA,
+    AtmosphericStabilityB,
+    AtmosphericStabilityC,
+    AtmosphericStabilityD,
+    AtmosphericStabilityE,
+    AtmosphericStabilityF,
+};
 
 struct SimulationConfig
 {
@@ -18,13 +28,20 @@ struct SimulationConfig
     float WindSpeed;
     float WindDir;
     float DepositionCoeff;
-    float _Pad1;
+    // Occupies the std140 padding before Resolution, so the uniform block layout is unchanged.
+    ConcentrationFormat OutputFormat;
     glm::ivec2 Resolution;
     int EmittersCount;
+    // Emitters whose contribution stays below this value [g/m^3] everywhere in a tile are skipped for that tile.
+    // Upwind emitters are always skipped, as they contribute exactly 0.
+    float CullingThreshold;
 
     static SimulationConfig FromJSON(const std::string_view data);
     static SimulationConfig FromJSON(const nlohmann::json& data);
     static SimulationConfig FromJSON(std::ifstream& fileStream);
 
     nlohmann::json ToJSON() const;
+
+    // Compares the user-facing parameters only; EmittersCount is derived when dispatching.
+    bool operator==(const SimulationConfig &other) const noexcept;
 };
\ No newline at end of file
@@ -1,15 +1,86 @@
 #include "SimulationController.hpp"
+#include <utility>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <format>
 #include <glm/glm.hpp>
+#include "CPU/TileBinning.hpp"
 
 constexpr glm::vec2 c_DefaultAtmosphericStability = AtmosphericStabilityD;
 constexpr float c_DefaultWindSpeed = 10.0f;
 constexpr float c_DefaultWindDir = glm::radians(0.0f);
 constexpr float c_DefaultDepositionCoeff = 0.0001f;
 constexpr size_t c_DefaultEmittersCapacity = 32;
+// Lets the CPU fill the next emitters segment while the GPU still reads the previous ones.
+constexpr GLuint c_EmittersBufferSegments = 3;
+constexpr const char *c_ShaderBinaryCacheDirectory = "./cache/shaders";
 constexpr GLuint c_ConfigBufferBinding = 1;
 constexpr GLuint c_EmittersBufferBinding = 2;
+constexpr GLuint c_EmitterBinCountsBinding = 3;
+constexpr GLuint c_EmitterBinsBinding = 4;
 constexpr GLuint c_OutputTextureBinding = 1;
-constexpr GLenum c_OutputTextureFormat = GL_R32F;
+constexpr GLint c_AccumulateUniformLocation = 0;
+constexpr GLint c_BinCapacityUniformLocation = 1;
+constexpr GLint c_TileRowOffsetUniformLocation = 2;
+constexpr GLint c_ExpCutoffUniformLocation = 3;
+constexpr GLint c_BinShaderCapacityUniformLocation = 0;
+constexpr GLint c_BinShaderTileRowOffsetUniformLocation = 1;
+constexpr GLuint c_ReceptorsBinding = 5;
+constexpr GLuint c_ReceptorConcentrationsBinding = 6;
+constexpr GLint c_ReceptorsCountUniformLocation = 0;
+constexpr GLint c_ReceptorOffsetUniformLocation = 1;
+// Workgroup size of EvaluateReceptors.glsl.
+constexpr size_t c_ReceptorsPerGroup = 256;
+// Minimum of GL_MAX_COMPUTE_WORK_GROUP_COUNT guaranteed by the spec; larger receptor sets take several dispatches.
+constexpr size_t c_MaxReceptorGroupsPerDispatch = 65535;
+// Edge of the tiles of MainCompute.glsl and BinEmitters.glsl.
+constexpr int c_ComputeTileSize = 16;
+// Binning only pays off once the per-cell loop is long enough.
+constexpr size_t c_MinEmittersForBinning = 32;
+constexpr GLuint c_MaxEmitterBinCapacity = 1024;
+// Bins whose capacity would drop below this overflow too often to be worth building.
+constexpr GLuint c_MinEmitterBinCapacity = 16;
+constexpr GLsizeiptr c_MaxEmitterBinsSize = 64 * 1024 * 1024;
+// More pending deltas than this cost about as much as a full recalculation.
+constexpr size_t c_MaxEmitterDeltas = 64;
+// Every incremental update adds float rounding error to the output; a full recalculation resets it.
+constexpr size_t c_IncrementalUpdatesPerRebuild = 256;
+// Smaller grids are recomputed at full resolution even while interacting.
+constexpr size_t c_MinProgressiveCells = 512 * 512;
+// Tile rows from the middle of the grid that MeasureGPUKernelError() computes with both kernels.
+constexpr int c_AccuracyCheckTileRows = 16;
+// Refinement slices cover whole rows of compute tiles.
+constexpr int c_RefinementRowGranularity = c_ComputeTileSize;
+constexpr GLuint c_TimestampStart = 0;
+constexpr GLuint c_TimestampUploaded = 1;
+constexpr GLuint c_TimestampEnd = 2;
+constexpr GLuint c_TimestampsPerFrame = 3;
+// Query results usually arrive one or two frames late; more frames in flight are dropped rather than waited on.
+constexpr GLuint c_TimedFramesInFlight = 4;
+// Copies usually finish within a frame or two; the slots beyond that absorb bursts of requests.
+constexpr GLuint c_ReadbacksInFlight = 3;
+
+static GLenum GetOutputTextureFormat(ConcentrationFormat format) noexcept
+{
+    switch (format)
+    {
+    case ConcentrationFormat::Float16:
+        return GL_R16F;
+    case ConcentrationFormat::LogUNorm16:
+        return GL_R16;
+    default:
+        return GL_R32F;
+    }
+}
+
+// Host data type of the packed samples of a 16-bit format.
+static GLenum GetOutputTextureDataType(ConcentrationFormat format) noexcept
+{
+    return format == ConcentrationFormat::Float16 ? GL_HALF_FLOAT : GL_UNSIGNED_SHORT;
+}
 
 SimulationController::SimulationController(const glm::vec2 &gridSize, const glm::ivec2 &gridResolution)
 {
@@ -19,18 +90,26 @@ SimulationController::SimulationController(const glm::vec2 &gridSize, const glm:
         .WindSpeed = c_DefaultWindSpeed,
         .WindDir = c_DefaultWindDir,
         .DepositionCoeff = c_DefaultDepositionCoeff,
+        .OutputFormat = ConcentrationFormat::Float32,
         .Resolution = gridResolution,
+        .EmittersCount = 0,
+        .CullingThreshold = 0.0f,
     };
 
-    emitters_.reserve(c_DefaultEmittersCapacity);
+    emitters_.Reserve(c_DefaultEmittersCapacity);
 
     configBuffer_ = Buffer(sizeof(SimulationConfig));
-    emittersBuffer_ = Buffer(sizeof(EmitterInfo) * c_DefaultEmittersCapacity);
-    outputTexture_ = Texture2D(gridResolution, c_OutputTextureFormat);
+    emittersBuffer_ = RingBuffer(sizeof(glm::vec4) * std::max(c_DefaultEmittersCapacity, c_MaxEmitterDeltas), c_EmittersBufferSegments);
+    emitterBinCountsBuffer_ = Buffer(sizeof(GLuint));
+    emitterBinsBuffer_ = Buffer(sizeof(GLuint));
+    outputTexture_ = Texture2D(gridResolution, GetOutputTextureFormat(config_.OutputFormat));
+
+    binShader_ = Shader({{GL_COMPUTE_SHADER, "./data/shaders/BinEmitters.glsl"}}, {}, c_ShaderBinaryCacheDirectory);
+    receptorShader_ = Shader({{GL_COMPUTE_SHADER, "./data/shaders/EvaluateReceptors.glsl"}}, {}, c_ShaderBinaryCacheDirectory);
 
-    computeShader_ = Shader({{GL_COMPUTE_SHADER, "./data/shaders/MainCompute.glsl"}});
-    computeShader_.BindUniformBuffer(c_ConfigBufferBinding, configBuffer_);
-    computeShader_.BindShaderStorageBuffer(c_EmittersBufferBinding, emittersBuffer_);
+    timerQueries_ = TimestampQueryRing(c_TimestampsPerFrame, c_TimedFramesInFlight);
+    pendingTimings_.resize(c_TimedFramesInFlight);
+    readbackRing_ = TextureReadbackRing(c_ReadbacksInFlight);
 }
 
 SimulationController::SimulationController(SimulationController &&other) noexcept
@@ -39,8 +118,42 @@ SimulationController::SimulationController(SimulationController &&other) noexcep
     emitters_ = std::move(other.emitters_);
     configBuffer_ = std::move(other.configBuffer_);
     emittersBuffer_ = std::move(other.emittersBuffer_);
+    emitterBinCountsBuffer_ = std::move(other.emitterBinCountsBuffer_);
+    emitterBinsBuffer_ = std::move(other.emitterBinsBuffer_);
     outputTexture_ = std::move(other.outputTexture_);
-    computeShader_ = std::move(other.computeShader_);
+    lodTexture_ = std::move(other.lodTexture_);
+    computeShaders_ = std::move(other.computeShaders_);
+    binShader_ = std::move(other.binShader_);
+    receptorShader_ = std::move(other.receptorShader_);
+    receptorsBuffer_ = std::move(other.receptorsBuffer_);
+    receptorConcentrationsBuffer_ = std::move(other.receptorConcentrationsBuffer_);
+    cpuBackend_ = std::move(other.cpuBackend_);
+    lodOutput_ = std::move(other.lodOutput_);
+    packedOutput_ = std::move(other.packedOutput_);
+    timerQueries_ = std::move(other.timerQueries_);
+    pendingTimings_ = std::move(other.pendingTimings_);
+    readbackRing_ = std::move(other.readbackRing_);
+    readbacks_ = std::move(other.readbacks_);
+    backend_ = other.backend_;
+    dirtyFlags_ = std::exchange(other.dirtyFlags_, SimulationDirtyAll);
+    emitterDeltas_ = std::move(other.emitterDeltas_);
+    incrementalUpdatesSinceRebuild_ = other.incrementalUpdatesSinceRebuild_;
+    incrementalUpdates_ = other.incrementalUpdates_;
+    sharedEmitterStaging_ = other.sharedEmitterStaging_;
+    lodScale_ = other.lodScale_;
+    refinementBudget_ = other.refinementBudget_;
+    refinedRows_ = other.refinedRows_;
+    clusters_ = std::move(other.clusters_);
+    packedSources_ = std::move(other.packedSources_);
+    clusterTolerance_ = other.clusterTolerance_;
+    clusterBins_ = std::move(other.clusterBins_);
+    clusterBinRowsReady_ = std::move(other.clusterBinRowsReady_);
+    clusterBinsResolution_ = std::exchange(other.clusterBinsResolution_, glm::ivec2(0));
+    clustersStale_ = std::exchange(other.clustersStale_, true);
+    accuracyBudget_ = other.accuracyBudget_;
+    cellsPerSecond_ = other.cellsPerSecond_;
+    interacting_ = other.interacting_;
+    isRefining_ = std::exchange(other.isRefining_, false);
 }
 
 SimulationController &SimulationController::operator=(SimulationController &&other) noexcept
@@ -49,38 +162,606 @@ SimulationController &SimulationController::operator=(SimulationController &&oth
     emitters_ = std::move(other.emitters_);
     configBuffer_ = std::move(other.configBuffer_);
     emittersBuffer_ = std::move(other.emittersBuffer_);
+    emitterBinCountsBuffer_ = std::move(other.emitterBinCountsBuffer_);
+    emitterBinsBuffer_ = std::move(other.emitterBinsBuffer_);
     outputTexture_ = std::move(other.outputTexture_);
-    computeShader_ = std::move(other.computeShader_);
+    lodTexture_ = std::move(other.lodTexture_);
+    computeShaders_ = std::move(other.computeShaders_);
+    binShader_ = std::move(other.binShader_);
+    receptorShader_ = std::move(other.receptorShader_);
+    receptorsBuffer_ = std::move(other.receptorsBuffer_);
+    receptorConcentrationsBuffer_ = std::move(other.receptorConcentrationsBuffer_);
+    cpuBackend_ = std::move(other.cpuBackend_);
+    lodOutput_ = std::move(other.lodOutput_);
+    packedOutput_ = std::move(other.packedOutput_);
+    timerQueries_ = std::move(other.timerQueries_);
+    pendingTimings_ = std::move(other.pendingTimings_);
+    readbackRing_ = std::move(other.readbackRing_);
+    readbacks_ = std::move(other.readbacks_);
+    backend_ = other.backend_;
+    dirtyFlags_ = std::exchange(other.dirtyFlags_, SimulationDirtyAll);
+    emitterDeltas_ = std::move(other.emitterDeltas_);
+    incrementalUpdatesSinceRebuild_ = other.incrementalUpdatesSinceRebuild_;
+    incrementalUpdates_ = other.incrementalUpdates_;
+    sharedEmitterStaging_ = other.sharedEmitterStaging_;
+    lodScale_ = other.lodScale_;
+    refinementBudget_ = other.refinementBudget_;
+    refinedRows_ = other.refinedRows_;
+    clusters_ = std::move(other.clusters_);
+    packedSources_ = std::move(other.packedSources_);
+    clusterTolerance_ = other.clusterTolerance_;
+    clusterBins_ = std::move(other.clusterBins_);
+    clusterBinRowsReady_ = std::move(other.clusterBinRowsReady_);
+    clusterBinsResolution_ = std::exchange(other.clusterBinsResolution_, glm::ivec2(0));
+    clustersStale_ = std::exchange(other.clustersStale_, true);
+    accuracyBudget_ = other.accuracyBudget_;
+    cellsPerSecond_ = other.cellsPerSecond_;
+    interacting_ = other.interacting_;
+    isRefining_ = std::exchange(other.isRefining_, false);
 
     return *this;
 }
 
-void SimulationController::Calculate()
+bool SimulationController::Calculate()
 {
-    const auto emittersCount = emitters_.size();
-    if (emittersCount * sizeof(EmitterInfo) > emittersBuffer_.GetSize())
+    // With nothing changed, a pending refinement continues once the interaction is over.
+    const auto isRefinementSlice = dirtyFlags_ == SimulationDirtyNone && isRefining_ && !interacting_;
+    if (dirtyFlags_ == SimulationDirtyNone && !isRefinementSlice)
+        return false;
+
+    if (dirtyFlags_ & (SimulationDirtyConfig | SimulationDirtyEmitters | SimulationDirtyEmitterDeltas))
+        clustersStale_ = true;
+
+    // Checked here rather than in SetAccuracyBudget(), against the config and emitters being calculated. The GPU
+    // check dispatches outside the timed frame.
+    if (accuracyCheckPending_)
+        CheckAccuracyBudget();
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto isTimed = timerQueries_.BeginFrame();
+    timerQueries_.Record(c_TimestampStart);
+
+    const auto outputTextureFormat = GetOutputTextureFormat(config_.OutputFormat);
+    if ((dirtyFlags_ & SimulationDirtyResolution)
+        && (outputTexture_.GetSize() != config_.Resolution || outputTexture_.GetFormat() != outputTextureFormat))
+        outputTexture_ = Texture2D(config_.Resolution, outputTextureFormat);
+
+    // Deltas cannot be added to an output that is only partially refined.
+    if (isRefining_ && (dirtyFlags_ & SimulationDirtyEmitterDeltas))
+        dirtyFlags_ |= SimulationDirtyEmitters;
+
+    // Accumulating into a 16-bit texture would round every update, so those are always recomputed on the GPU.
+    // The CPU backend accumulates in floats and only packs for the upload. Deltas are evaluated exactly, so they
+    // cannot be added to an output whose contributions were culled or approximated by clusters: removing an
+    // emitter would subtract values that were never added.
+    const auto isIncremental = dirtyFlags_ == SimulationDirtyEmitterDeltas
+        && incrementalUpdatesSinceRebuild_ < c_IncrementalUpdatesPerRebuild
+        && (backend_ == SimulationBackend::CPU || config_.OutputFormat == ConcentrationFormat::Float32)
+        && config_.CullingThreshold <= 0.0f
+        && clusterTolerance_ <= 0.0f;
+    // Incremental updates are cheap enough at full resolution, so only full recalculations are reduced. The
+    // last edit of an interaction usually arrives after it ended and restarts the pending refinement.
+    const auto isLOD = !isIncremental
+        && !isRefinementSlice
+        && (interacting_ || isRefining_)
+        && lodScale_ > 1
+        && (size_t)config_.Resolution.x * (size_t)config_.Resolution.y >= c_MinProgressiveCells;
+
+    auto resolution = outputTexture_.GetSize();
+    auto rowCount = resolution.y;
+    if (isRefinementSlice)
+        rowCount = RefineSlice(GetRefinementSliceRows());
+    else if (isIncremental)
     {
-        emittersBuffer_ = Buffer(sizeof(EmitterInfo) * emitters_.capacity());
-        computeShader_.BindShaderStorageBuffer(c_EmittersBufferBinding, emittersBuffer_);
+        if (backend_ == SimulationBackend::CPU)
+            CalculateIncrementalCPU();
+        else
+            CalculateIncrementalGPU();
+
+        incrementalUpdatesSinceRebuild_++;
     }
+    else if (isLOD)
+    {
+        CalculateLOD();
+        resolution = lodTexture_.GetSize();
+        rowCount = resolution.y;
+        refinedRows_ = 0;
+        isRefining_ = true;
+    }
+    else
+    {
+        if (backend_ == SimulationBackend::CPU)
+            CalculateCPU();
+        else
+            CalculateGPU();
+
+        incrementalUpdatesSinceRebuild_ = 0;
+        isRefining_ = false;
+    }
+
+    timerQueries_.Record(c_TimestampEnd);
+    if (isTimed)
+    {
+        pendingTimings_[timerQueries_.GetCurrentFrame()] = {
+            .Backend = backend_,
+            .Resolution = resolution,
+            .EmittersCount = emitters_.GetCount(),
+            .RowCount = rowCount,
+            .IsIncremental = isIncremental,
+            .CPUTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+            // Filled in from the queries by PollTiming().
+            .UploadTime = 0.0,
+            .DispatchTime = 0.0,
+        };
+    }
+    timerQueries_.EndFrame();
 
-    emittersBuffer_.Write(emitters_.data(), sizeof(EmitterInfo) * emittersCount);
+    emitterDeltas_.clear();
+    dirtyFlags_ = SimulationDirtyNone;
+    return true;
+}
+
+void SimulationController::CalculateGPU()
+{
+    DispatchGPU(outputTexture_, 0, (outputTexture_.GetHeight() + c_ComputeTileSize - 1) / c_ComputeTileSize);
+}
+
+void SimulationController::CalculateLOD()
+{
+    const auto resolution = glm::max(config_.Resolution / lodScale_, glm::ivec2(2));
+    if (lodTexture_.GetSize() != resolution || lodTexture_.GetFormat() != outputTexture_.GetFormat())
+    {
+        lodTexture_ = Texture2D(resolution, outputTexture_.GetFormat());
+        // The coarse grid is stretched over the full one on screen.
+        lodTexture_.SetFilter(GL_LINEAR, GL_LINEAR);
+    }
+
+    if (backend_ == SimulationBackend::CPU)
+    {
+        auto config = config_;
+        config.Resolution = resolution;
+        config.EmittersCount = (int)emitters_.GetCount();
+        lodOutput_.resize((size_t)resolution.x * (size_t)resolution.y);
+        cpuBackend_.Calculate(config, emitters_.GetInvariants(config), lodOutput_);
+
+        UploadCPUOutput(lodTexture_, lodOutput_, 0, resolution.y);
+        timerQueries_.Record(c_TimestampUploaded);
+    }
+    else
+        DispatchGPU(lodTexture_, 0, (resolution.y + c_ComputeTileSize - 1) / c_ComputeTileSize);
+}
+
+int SimulationController::RefineSlice(int rowCount)
+{
+    rowCount = std::min(rowCount, outputTexture_.GetHeight() - refinedRows_);
+    if (backend_ == SimulationBackend::CPU)
+    {
+        config_.EmittersCount = (int)emitters_.GetCount();
+        cpuBackend_.CalculateRows(config_, emitters_.GetInvariants(config_), refinedRows_, rowCount);
+
+        UploadCPUOutput(outputTexture_, cpuBackend_.GetOutput(), refinedRows_, rowCount);
+        timerQueries_.Record(c_TimestampUploaded);
+    }
+    else
+    {
+        // Slices start on a tile row; only the last one may end inside a tile, past the end of the grid.
+        DispatchGPU(
+            outputTexture_,
+            refinedRows_ / c_ComputeTileSize,
+            (rowCount + c_ComputeTileSize - 1) / c_ComputeTileSize);
+    }
+
+    refinedRows_ += rowCount;
+    isRefining_ = refinedRows_ < outputTexture_.GetHeight();
+    return rowCount;
+}
+
+int SimulationController::GetRefinementSliceRows() const noexcept
+{
+    if (cellsPerSecond_ <= 0.0)
+        return c_RefinementRowGranularity;
+
+    const auto rows = (int)std::min(
+        refinementBudget_ * cellsPerSecond_ / (double)outputTexture_.GetWidth(),
+        (double)outputTexture_.GetHeight());
+    return std::max(rows / c_RefinementRowGranularity, 1) * c_RefinementRowGranularity;
+}
+
+void SimulationController::CompleteRefinement()
+{
+    if (isRefining_)
+        RefineSlice(outputTexture_.GetHeight() - refinedRows_);
+}
+
+void SimulationController::DispatchGPU(Texture2D &target, int firstTileRow, int tileRowCount)
+{
+    DispatchGPU(target, firstTileRow, tileRowCount, config_.OutputFormat, gpuExpDegree_);
+}
+
+void SimulationController::DispatchGPU(
+    Texture2D &target,
+    int firstTileRow,
+    int tileRowCount,
+    ConcentrationFormat outputFormat,
+    int expDegree)
+{
+    const auto emittersCount = emitters_.GetCount();
+    const auto useClusters = clusterTolerance_ > 0.0f && emittersCount >= c_MinEmittersForBinning;
+    if (useClusters && clustersStale_)
+    {
+        clusters_ = EmitterClusterTree(emitters_.GetInvariants(config_), clusterTolerance_);
+        PackEmitterInvariants(clusters_.GetSources(), packedSources_);
+        clusterBinsResolution_ = {0, 0};
+        clustersStale_ = false;
+    }
+
+    // The pseudo-emitters follow the exact ones, so tiles whose bin overflows still only loop over the latter.
+    const auto sources = useClusters ? std::span<const glm::vec4>(packedSources_) : emitters_.GetPackedInvariants(config_);
+    emittersBuffer_.Write(sources.data(), (GLsizeiptr)sources.size_bytes());
 
     config_.EmittersCount = (int)emittersCount;
+    auto config = config_;
+    config.Resolution = target.GetSize();
+    config.OutputFormat = outputFormat;
+    configBuffer_.Write(&config, sizeof(SimulationConfig));
+    timerQueries_.Record(c_TimestampUploaded);
+
+    auto &computeShader = GetComputeShader(config, expDegree);
+    computeShader.BindShaderStorageBuffer(c_EmittersBufferBinding, emittersBuffer_);
+    const auto binCapacity = useClusters
+        ? BinEmitterClustersGPU(config, firstTileRow, tileRowCount)
+        : BinEmittersGPU(target.GetSize(), firstTileRow, tileRowCount);
+
+    BindSimulationBuffers();
+    target.BindImage(c_OutputTextureBinding, GL_WRITE_ONLY);
+
+    computeShader.SetUniform(c_AccumulateUniformLocation, GL_FALSE);
+    computeShader.SetUniform(c_BinCapacityUniformLocation, binCapacity);
+    computeShader.SetUniform(c_TileRowOffsetUniformLocation, firstTileRow);
+    computeShader.Use();
+
+    const auto tilesX = (target.GetWidth() + c_ComputeTileSize - 1) / c_ComputeTileSize;
+    glDispatchCompute(tilesX, tileRowCount, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    emittersBuffer_.Release();
+}
+
+// Packs the specializations of MainCompute.glsl that the config allows: bit 0 for WIND_ALIGNED, bit 1 for
+// NO_DEPOSITION, bit 2 for DIRECT_EMITTER_LOADS, bits 3-4 for the output format, bits 5-7 for EXP_DEGREE and the
+// bits above for the index of the stability class plus one, or 0 for a custom stability.
+static uint32_t GetComputeShaderVariantKey(const SimulationConfig &config, bool sharedEmitterStaging, int expDegree) noexcept
+{
+    uint32_t key = 0;
+    if (config.WindDir == 0.0f)
+        key |= 1u << 0;
+    if (config.DepositionCoeff == 0.0f)
+        key |= 1u << 1;
+    if (!sharedEmitterStaging)
+        key |= 1u << 2;
+    key |= (uint32_t)config.OutputFormat << 3;
+    key |= (uint32_t)expDegree << 5;
+
+    const auto stabilityIt = std::find(AtmosphericStabilities.begin(), AtmosphericStabilities.end(), config.Stability);
+    if (stabilityIt != AtmosphericStabilities.end())
+        key |= (uint32_t)(std::distance(AtmosphericStabilities.begin(), stabilityIt) + 1) << 8;
+
+    return key;
+}
+
+static std::vector<ShaderDefine> GetComputeShaderVariantDefines(uint32_t key)
+{
+    std::vector<ShaderDefine> defines;
+    if (key & (1u << 0))
+        defines.emplace_back("WIND_ALIGNED", "1");
+    if (key & (1u << 1))
+        defines.emplace_back("NO_DEPOSITION", "1");
+    if (key & (1u << 2))
+        defines.emplace_back("DIRECT_EMITTER_LOADS", "1");
+
+    switch ((ConcentrationFormat)((key >> 3) & 0x3))
+    {
+    case ConcentrationFormat::Float16:
+        defines.emplace_back("OUTPUT_IMAGE_FORMAT", "r16f");
+        break;
+    case ConcentrationFormat::LogUNorm16:
+        defines.emplace_back("OUTPUT_IMAGE_FORMAT", "r16");
+        defines.emplace_back("OUTPUT_LOG_UNORM16", "1");
+        defines.emplace_back("LOG_UNORM16_MIN", std::format("{:e}", c_LogUNorm16Min));
+        defines.emplace_back("LOG_UNORM16_MAX", std::format("{:e}", c_LogUNorm16Max));
+        break;
+    default:
+        break;
+    }
+
+    const auto expDegree = (int)((key >> 5) & 0x7);
+    if (expDegree != 0)
+    {
+        std::string coefficients;
+        for (const auto coefficient : PlumeKernel::GetExp2Coefficients(expDegree))
+            coefficients += std::format("{}{:.9e}", coefficients.empty() ? "" : ", ", coefficient);
+
+        defines.emplace_back("EXP_DEGREE", std::to_string(expDegree));
+        defines.emplace_back("EXP2_COEFFICIENTS", std::format("float[]({})", coefficients));
+    }
+
+    const auto stabilityIdx = key >> 8;
+    if (stabilityIdx != 0)
+    {
+        const auto stability = AtmosphericStabilities[stabilityIdx - 1];
+        defines.emplace_back("STABILITY", std::format("vec2({}, {})", stability.x, stability.y));
+    }
+
+    return defines;
+}
+
+Shader& SimulationController::GetComputeShader(const SimulationConfig &config, int expDegree)
+{
+    const auto key = GetComputeShaderVariantKey(config, sharedEmitterStaging_, expDegree);
+    auto it = computeShaders_.find(key);
+    if (it == computeShaders_.end())
+    {
+        it = computeShaders_.emplace(
+            key,
+            Shader(
+                {{GL_COMPUTE_SHADER, "./data/shaders/MainCompute.glsl"}},
+                GetComputeShaderVariantDefines(key),
+                c_ShaderBinaryCacheDirectory)).first;
+    }
+
+    // The cutoff follows the budget, which has no variant of its own.
+    if (expDegree != 0)
+        it->second.SetUniform(c_ExpCutoffUniformLocation, PlumeKernel::GetExpCutoff(accuracyBudget_));
+
+    return it->second;
+}
+
+// Buffer bindings are context state shared with every other controller, so they are refreshed before each dispatch
+// instead of once at construction.
+void SimulationController::BindSimulationBuffers()
+{
+    binShader_.BindUniformBuffer(c_ConfigBufferBinding, configBuffer_);
+    binShader_.BindShaderStorageBuffer(c_EmitterBinCountsBinding, emitterBinCountsBuffer_);
+    binShader_.BindShaderStorageBuffer(c_EmitterBinsBinding, emitterBinsBuffer_);
+}
+
+GLuint SimulationController::BinEmittersGPU(const glm::ivec2 &gridSize, int firstTileRow, int tileRowCount)
+{
+    const auto emittersCount = emitters_.GetCount();
+    if (emittersCount < c_MinEmittersForBinning)
+        return 0;
+
+    // Bins are indexed over the whole grid, so slices of it can share the buffers.
+    const auto tileCount = (gridSize + c_ComputeTileSize - 1) / c_ComputeTileSize;
+    const auto binCount = (GLsizeiptr)tileCount.x * (GLsizeiptr)tileCount.y;
+    const auto binCapacity = (GLuint)std::min<GLsizeiptr>(
+        {(GLsizeiptr)emittersCount, c_MaxEmitterBinCapacity, c_MaxEmitterBinsSize / (binCount * (GLsizeiptr)sizeof(GLuint))});
+    if (binCapacity < c_MinEmitterBinCapacity)
+        return 0;
+
+    if (emitterBinCountsBuffer_.GetSize() < binCount * (GLsizeiptr)sizeof(GLuint))
+        emitterBinCountsBuffer_ = Buffer(binCount * sizeof(GLuint));
+    if (emitterBinsBuffer_.GetSize() < binCount * binCapacity * (GLsizeiptr)sizeof(GLuint))
+        emitterBinsBuffer_ = Buffer(binCount * binCapacity * sizeof(GLuint));
+
+    BindSimulationBuffers();
+    binShader_.SetUniform(c_BinShaderCapacityUniformLocation, binCapacity);
+    binShader_.SetUniform(c_BinShaderTileRowOffsetUniformLocation, firstTileRow);
+    binShader_.Use();
+    glDispatchCompute(tileCount.x, tileRowCount, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    return binCapacity;
+}
+
+GLuint SimulationController::BinEmitterClustersGPU(const SimulationConfig &config, int firstTileRow, int tileRowCount)
+{
+    // The cut through the cluster tree depends on the distance of every tile to each cluster, so the bins are
+    // built on the host from the tree instead of by BinEmitters.glsl.
+    const auto tileCount = (config.Resolution + c_ComputeTileSize - 1) / c_ComputeTileSize;
+    const auto sliceBinCount = (size_t)tileCount.x * (size_t)tileRowCount;
+    if (sliceBinCount == 0)
+        return 0;
+
+    if (clusterBinsResolution_ != config.Resolution)
+    {
+        clusterBins_.assign((size_t)tileCount.x * (size_t)tileCount.y, {});
+        clusterBinRowsReady_.assign((size_t)tileCount.y, 0);
+        clusterBinsResolution_ = config.Resolution;
+    }
+
+    std::vector<int> missingRows;
+    for (int tileY = firstTileRow; tileY < firstTileRow + tileRowCount; tileY++)
+    {
+        if (!clusterBinRowsReady_[(size_t)tileY])
+            missingRows.emplace_back(tileY);
+    }
+
+    if (!missingRows.empty())
+    {
+        const auto constants = PlumeKernel::PrepareConstants(config);
+        auto &threadPool = cpuBackend_.GetThreadPool();
+        std::vector<std::vector<uint32_t>> sources(threadPool.GetThreadCount());
+        threadPool.ParallelFor(
+            missingRows.size() * (size_t)tileCount.x,
+            [&](size_t taskIdx, size_t participantIdx)
+            {
+                const glm::ivec2 tile{(int)(taskIdx % (size_t)tileCount.x), missingRows[taskIdx / (size_t)tileCount.x]};
+                const glm::ivec2 offset = tile * c_ComputeTileSize;
+                const GridRegion region{offset, glm::min(glm::ivec2(c_ComputeTileSize), config.Resolution - offset)};
+
+                auto &bin = clusterBins_[(size_t)tile.y * (size_t)tileCount.x + (size_t)tile.x];
+                bin.clear();
+                clusters_.SelectSources(constants, region, sources[participantIdx]);
+                for (const auto sourceIdx : sources[participantIdx])
+                {
+                    const auto maxContribution = GetMaxEmitterContribution(constants, clusters_.GetSources(), sourceIdx, region);
+                    if (maxContribution >= 0.0f && maxContribution >= constants.CullingThreshold)
+                        bin.emplace_back(sourceIdx);
+                }
+            });
+
+        for (const auto tileY : missingRows)
+            clusterBinRowsReady_[(size_t)tileY] = 1;
+    }
+
+    const auto firstBin = (GLintptr)firstTileRow * tileCount.x;
+    const std::span sliceBins(clusterBins_.begin() + firstBin, sliceBinCount);
+    std::vector<GLuint> binCounts(sliceBinCount);
+    std::transform(sliceBins.begin(), sliceBins.end(), binCounts.begin(), [](const auto &bin) { return (GLuint)bin.size(); });
+
+    // Bins are indexed over the whole grid, as in BinEmittersGPU(). Tiles whose bin overflows fall back to the
+    // exact emitters.
+    const auto binCount = (GLsizeiptr)tileCount.x * (GLsizeiptr)tileCount.y;
+    const auto maxBinCount = *std::max_element(binCounts.begin(), binCounts.end());
+    const auto binCapacity = (GLuint)std::clamp<GLsizeiptr>(
+        std::min<GLsizeiptr>(c_MaxEmitterBinCapacity, c_MaxEmitterBinsSize / (binCount * (GLsizeiptr)sizeof(GLuint))),
+        1,
+        std::max<GLsizeiptr>(maxBinCount, 1));
+
+    std::vector<GLuint> bins(sliceBinCount * binCapacity);
+    for (size_t binIdx = 0; binIdx < sliceBinCount; binIdx++)
+    {
+        if (binCounts[binIdx] <= binCapacity)
+            std::copy(sliceBins[binIdx].begin(), sliceBins[binIdx].end(), bins.begin() + binIdx * binCapacity);
+    }
+
+    if (emitterBinCountsBuffer_.GetSize() < binCount * (GLsizeiptr)sizeof(GLuint))
+        emitterBinCountsBuffer_ = Buffer(binCount * sizeof(GLuint));
+    if (emitterBinsBuffer_.GetSize() < binCount * binCapacity * (GLsizeiptr)sizeof(GLuint))
+        emitterBinsBuffer_ = Buffer(binCount * binCapacity * sizeof(GLuint));
+
+    emitterBinCountsBuffer_.Write(binCounts.data(), (GLsizeiptr)(binCounts.size() * sizeof(GLuint)), firstBin * sizeof(GLuint));
+    emitterBinsBuffer_.Write(bins.data(), (GLsizeiptr)(bins.size() * sizeof(GLuint)), firstBin * binCapacity * sizeof(GLuint));
+
+    return binCapacity;
+}
+
+void SimulationController::SetClusterTolerance(float tolerance) noexcept
+{
+    if (tolerance == clusterTolerance_)
+        return;
+
+    clusterTolerance_ = tolerance;
+    cpuBackend_.SetClusterTolerance(tolerance);
+    clustersStale_ = true;
+    dirtyFlags_ |= SimulationDirtyAll;
+}
+
+void SimulationController::SetAccuracyBudget(float budget) noexcept
+{
+    if (budget == accuracyBudget_)
+        return;
+
+    accuracyBudget_ = budget;
+    cpuBackend_.SetAccuracyBudget(budget);
+    accuracyCheckPending_ = true;
+    dirtyFlags_ |= SimulationDirtyAll;
+}
+
+void SimulationController::CheckAccuracyBudget()
+{
+    accuracyCheckPending_ = false;
+    if (backend_ == SimulationBackend::CPU)
+    {
+        // Starts over from the declared errors, as a previous check may have fallen back.
+        cpuBackend_.SetAccuracyBudget(accuracyBudget_);
+        kernelError_ = cpuBackend_.CheckAccuracyBudget(config_, emitters_.GetInvariants(config_));
+        return;
+    }
+
+    // Same fallback as CPUBackend::CheckAccuracyBudget().
+    gpuExpDegree_ = PlumeKernel::SelectExpDegree(accuracyBudget_);
+    kernelError_ = MeasureGPUKernelError(gpuExpDegree_);
+    while (kernelError_ > accuracyBudget_ && gpuExpDegree_ != 0)
+    {
+        gpuExpDegree_ = PlumeKernel::GetMoreAccurateExpDegree(gpuExpDegree_);
+        kernelError_ = MeasureGPUKernelError(gpuExpDegree_);
+    }
+}
+
+float SimulationController::MeasureGPUKernelError(int expDegree)
+{
+    const auto tileRows = (config_.Resolution.y + c_ComputeTileSize - 1) / c_ComputeTileSize;
+    if (expDegree == 0 || tileRows == 0)
+        return 0.0f;
+
+    // Both kernels write floats, so that the comparison is not limited by the output format. The cells depend on
+    // the grid resolution, so the textures cover the whole grid even though only the band is computed.
+    const auto tileRowCount = std::min(c_AccuracyCheckTileRows, tileRows);
+    const auto firstTileRow = (tileRows - tileRowCount) / 2;
+    Texture2D exact(config_.Resolution, GL_R32F);
+    Texture2D fast(config_.Resolution, GL_R32F);
+    DispatchGPU(exact, firstTileRow, tileRowCount, ConcentrationFormat::Float32, 0);
+    DispatchGPU(fast, firstTileRow, tileRowCount, ConcentrationFormat::Float32, expDegree);
+
+    const auto offset = glm::ivec2(0, firstTileRow * c_ComputeTileSize);
+    const auto size = glm::ivec2(config_.Resolution.x, std::min(tileRowCount * c_ComputeTileSize, config_.Resolution.y - offset.y));
+    const auto count = (size_t)size.x * (size_t)size.y;
+    std::vector<float> expected(count);
+    std::vector<float> actual(count);
+    exact.Read(offset, size, expected.data(), (GLsizei)(count * sizeof(float)), GL_RED, GL_FLOAT);
+    fast.Read(offset, size, actual.data(), (GLsizei)(count * sizeof(float)), GL_RED, GL_FLOAT);
+
+    // Ignores cells below c_KernelAbsoluteTolerance like PlumeKernel::MeasureRelativeError().
+    float maxError = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (std::abs(expected[i]) >= c_KernelAbsoluteTolerance)
+            maxError = std::max(maxError, std::abs(actual[i] - expected[i]) / std::abs(expected[i]));
+    }
+
+    return maxError;
+}
+
+void SimulationController::CalculateCPU()
+{
+    config_.EmittersCount = (int)emitters_.GetCount();
+    cpuBackend_.Calculate(config_, emitters_.GetInvariants(config_));
+
+    UploadCPUOutput(outputTexture_, cpuBackend_.GetOutput(), 0, outputTexture_.GetHeight());
+    timerQueries_.Record(c_TimestampUploaded);
+}
+
+void SimulationController::CalculateIncrementalGPU()
+{
+    std::vector<glm::vec4> deltas;
+    PackEmitterInvariants(PlumeKernel::PrepareEmitters(config_, emitterDeltas_), deltas);
+    emittersBuffer_.Write(deltas.data(), (GLsizeiptr)(deltas.size() * sizeof(glm::vec4)));
+
+    config_.EmittersCount = (int)emitterDeltas_.size();
     configBuffer_.Write(&config_, sizeof(SimulationConfig));
+    timerQueries_.Record(c_TimestampUploaded);
 
-    outputTexture_.BindImage(c_OutputTextureBinding, GL_WRITE_ONLY);
+    BindSimulationBuffers();
+    outputTexture_.BindImage(c_OutputTextureBinding, GL_READ_WRITE);
 
-    computeShader_.Use();
+    auto &computeShader = GetComputeShader(config_, gpuExpDegree_);
+    computeShader.BindShaderStorageBuffer(c_EmittersBufferBinding, emittersBuffer_);
+    computeShader.SetUniform(c_AccumulateUniformLocation, GL_TRUE);
+    computeShader.SetUniform(c_BinCapacityUniformLocation, 0u);
+    computeShader.SetUniform(c_TileRowOffsetUniformLocation, 0);
+    computeShader.Use();
 
-    const auto groupSize = (outputTexture_.GetSize() + 15) / 16;
+    const auto groupSize = (outputTexture_.GetSize() + c_ComputeTileSize - 1) / c_ComputeTileSize;
     glDispatchCompute(groupSize.x, groupSize.y, 1);
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    emittersBuffer_.Release();
+}
+
+void SimulationController::CalculateIncrementalCPU()
+{
+    cpuBackend_.Accumulate(config_, emitterDeltas_);
+
+    UploadCPUOutput(outputTexture_, cpuBackend_.GetOutput(), 0, outputTexture_.GetHeight());
+    timerQueries_.Record(c_TimestampUploaded);
 }
 
 void SimulationController::AddEmitter(EmitterInfo &&emitterInfo)
 {
-    emitters_.emplace_back(std::forward<EmitterInfo>(emitterInfo));
+    PushEmitterDelta(emitterInfo, false);
+    emitters_.Add(emitterInfo);
 }
 
 void SimulationController::AddEmitter(const glm::vec2 &position, float height, float emissionRate)
@@ -88,14 +769,286 @@ void SimulationController::AddEmitter(const glm::vec2 &position, float height, f
     AddEmitter(EmitterInfo{.Position = position, .EmissionRate = emissionRate, .Height = height});
 }
 
+void SimulationController::UpdateEmitter(size_t emitterIdx, const EmitterInfo &emitterInfo)
+{
+    const auto emitter = emitters_.Get(emitterIdx);
+    if (emitter == emitterInfo)
+        return;
+
+    PushEmitterDelta(emitter, true);
+    PushEmitterDelta(emitterInfo, false);
+    emitters_.Set(emitterIdx, emitterInfo);
+}
+
 void SimulationController::RemoveEmitter(size_t emitterIdx)
 {
-    emitters_.erase(emitters_.begin() + emitterIdx);
+    PushEmitterDelta(emitters_.Get(emitterIdx), true);
+    emitters_.Remove(emitterIdx);
 }
 
 void SimulationController::ClearEmitters()
 {
-    emitters_.clear();
+    emitters_.Clear();
+    dirtyFlags_ |= SimulationDirtyEmitters;
+}
+
+void SimulationController::SetEmitters(std::span<const EmitterInfo> emitters)
+{
+    emitters_.Assign(emitters);
+    dirtyFlags_ |= SimulationDirtyEmitters;
+}
+
+void SimulationController::SetConfig(const SimulationConfig &config) noexcept
+{
+    if (config == config_)
+        return;
+
+    if (config.Resolution != config_.Resolution || config.OutputFormat != config_.OutputFormat)
+        dirtyFlags_ |= SimulationDirtyResolution;
+
+    config_ = config;
+    dirtyFlags_ |= SimulationDirtyConfig;
+}
+
+void SimulationController::SetIncrementalUpdates(bool enabled) noexcept
+{
+    incrementalUpdates_ = enabled;
+}
+
+void SimulationController::SetSharedEmitterStaging(bool enabled) noexcept
+{
+    if (enabled == sharedEmitterStaging_)
+        return;
+
+    sharedEmitterStaging_ = enabled;
+    if (backend_ == SimulationBackend::GPU)
+        dirtyFlags_ |= SimulationDirtyAll;
+}
+
+bool SimulationController::ReloadShadersIfChanged()
+{
+    // Receptor queries are not cached, so their shader does not invalidate the output.
+    receptorShader_.ReloadIfChanged();
+
+    auto reloaded = binShader_.ReloadIfChanged();
+    for (auto &[key, computeShader] : computeShaders_)
+        reloaded = computeShader.ReloadIfChanged() || reloaded;
+    if (!reloaded)
+        return false;
+
+    if (backend_ == SimulationBackend::GPU)
+        dirtyFlags_ |= SimulationDirtyAll;
+
+    return true;
+}
+
+void SimulationController::UploadCPUOutput(Texture2D &target, std::span<const float> grid, int firstRow, int rowCount)
+{
+    const auto width = (size_t)target.GetWidth();
+    if (grid.size() != width * (size_t)target.GetHeight())
+        return;
+
+    const auto output = grid.subspan((size_t)firstRow * width, (size_t)rowCount * width);
+    const glm::ivec2 offset{0, firstRow};
+    const glm::ivec2 size{target.GetWidth(), rowCount};
+    if (config_.OutputFormat == ConcentrationFormat::Float32)
+    {
+        target.Write(offset, size, output.data(), GL_RED, GL_FLOAT);
+        return;
+    }
+
+    // Packing on the host halves the upload as well as the texture.
+    packedOutput_.resize(output.size());
+    EncodeConcentrations(config_.OutputFormat, output, packedOutput_);
+    target.Write(offset, size, packedOutput_.data(), GL_RED, GetOutputTextureDataType(config_.OutputFormat));
+}
+
+std::vector<float> SimulationController::ReadOutput() const
+{
+    // The CPU output is stored in the same format as the texture, so both backends export identical grids.
+    if (backend_ == SimulationBackend::CPU)
+    {
+        const auto output = cpuBackend_.GetOutput();
+        std::vector<float> result(output.begin(), output.end());
+        if (config_.OutputFormat != ConcentrationFormat::Float32)
+        {
+            std::vector<uint16_t> packed(output.size());
+            EncodeConcentrations(config_.OutputFormat, output, packed);
+            DecodeConcentrations(config_.OutputFormat, packed, result);
+        }
+
+        return result;
+    }
+
+    const auto size = outputTexture_.GetSize();
+    const auto count = (size_t)size.x * (size_t)size.y;
+    if (count * GetConcentrationSampleSize(config_.OutputFormat) > (size_t)std::numeric_limits<GLsizei>::max())
+        throw std::out_of_range("Output grid is too large to read back from the GPU.");
+
+    std::vector<float> output(count);
+    if (config_.OutputFormat == ConcentrationFormat::Float32)
+    {
+        outputTexture_.Read(output.data(), (GLsizei)(count * sizeof(float)), GL_RED, GL_FLOAT);
+        return output;
+    }
+
+    std::vector<uint16_t> packed(count);
+    outputTexture_.Read(
+        packed.data(),
+        (GLsizei)(count * sizeof(uint16_t)),
+        GL_RED,
+        GetOutputTextureDataType(config_.OutputFormat));
+    DecodeConcentrations(config_.OutputFormat, packed, output);
+
+    return output;
+}
+
+bool SimulationController::RequestReadback()
+{
+    if (backend_ == SimulationBackend::CPU)
+    {
+        readbacks_.push_back({{outputTexture_.GetSize(), config_.OutputFormat, ReadOutput()}, -1});
+        return true;
+    }
+
+    const auto size = outputTexture_.GetSize();
+    const auto dataSize = (GLsizeiptr)size.x * (GLsizeiptr)size.y * (GLsizeiptr)GetConcentrationSampleSize(config_.OutputFormat);
+    const auto dataType = config_.OutputFormat == ConcentrationFormat::Float32
+        ? GL_FLOAT
+        : GetOutputTextureDataType(config_.OutputFormat);
+
+    // The copy has to see the image stores of the dispatches before it.
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    const auto slot = readbackRing_.Request(outputTexture_, dataSize, GL_RED, dataType);
+    if (slot < 0)
+        return false;
+
+    readbacks_.push_back({{size, config_.OutputFormat, {}}, slot});
+    return true;
+}
+
+bool SimulationController::PollReadback(SimulationReadback &readback)
+{
+    if (readbacks_.empty())
+        return false;
+
+    auto &pending = readbacks_.front();
+    if (pending.Slot >= 0)
+    {
+        // The ring completes copies in the order they were queued, so the one it returns is this one.
+        const auto slot = readbackRing_.Poll();
+        if (slot < 0)
+            return false;
+
+        auto &values = pending.Readback.Values;
+        const auto data = readbackRing_.GetData(slot);
+        values.resize((size_t)pending.Readback.Resolution.x * (size_t)pending.Readback.Resolution.y);
+        if (pending.Readback.Format == ConcentrationFormat::Float32)
+            std::memcpy(values.data(), data.data(), values.size() * sizeof(float));
+        else
+        {
+            // The mapping is only guaranteed 4-byte alignment, which is enough for 16-bit samples.
+            const std::span packed(reinterpret_cast<const uint16_t*>(data.data()), values.size());
+            DecodeConcentrations(pending.Readback.Format, packed, values);
+        }
+    }
+
+    readback = std::move(pending.Readback);
+    readbacks_.pop_front();
+    return true;
+}
+
+void SimulationController::EvaluateReceptors(std::span<const glm::vec2> positions, std::span<float> output)
+{
+    if (output.size() < positions.size())
+        throw std::out_of_range("Receptor output is smaller than the receptor count.");
+    if (positions.empty())
+        return;
+
+    config_.EmittersCount = (int)emitters_.GetCount();
+    if (backend_ == SimulationBackend::CPU)
+    {
+        cpuBackend_.EvaluateReceptors(config_, emitters_.GetInvariants(config_), positions, output);
+        return;
+    }
+
+    const auto receptorsSize = (GLsizeiptr)positions.size_bytes();
+    const auto concentrationsSize = (GLsizeiptr)(positions.size() * sizeof(float));
+    if (receptorsBuffer_.GetSize() < receptorsSize)
+    {
+        receptorsBuffer_ = Buffer(receptorsSize);
+        receptorConcentrationsBuffer_ = Buffer(concentrationsSize);
+    }
+    receptorsBuffer_.Write(positions.data(), receptorsSize);
+
+    const auto invariants = emitters_.GetPackedInvariants(config_);
+    emittersBuffer_.Write(invariants.data(), (GLsizeiptr)invariants.size_bytes());
+    configBuffer_.Write(&config_, sizeof(SimulationConfig));
+
+    receptorShader_.BindUniformBuffer(c_ConfigBufferBinding, configBuffer_);
+    receptorShader_.BindShaderStorageBuffer(c_EmittersBufferBinding, emittersBuffer_);
+    receptorShader_.BindShaderStorageBuffer(c_ReceptorsBinding, receptorsBuffer_);
+    receptorShader_.BindShaderStorageBuffer(c_ReceptorConcentrationsBinding, receptorConcentrationsBuffer_);
+    receptorShader_.SetUniform(c_ReceptorsCountUniformLocation, (GLuint)positions.size());
+    receptorShader_.Use();
+
+    const auto groupCount = (positions.size() + c_ReceptorsPerGroup - 1) / c_ReceptorsPerGroup;
+    for (size_t firstGroup = 0; firstGroup < groupCount; firstGroup += c_MaxReceptorGroupsPerDispatch)
+    {
+        receptorShader_.SetUniform(c_ReceptorOffsetUniformLocation, (GLuint)(firstGroup * c_ReceptorsPerGroup));
+        glDispatchCompute((GLuint)std::min(groupCount - firstGroup, c_MaxReceptorGroupsPerDispatch), 1, 1);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    emittersBuffer_.Release();
+
+    // Reads straight into the caller's span; this waits for the dispatches to finish.
+    glGetNamedBufferSubData(receptorConcentrationsBuffer_.GetID(), 0, concentrationsSize, output.data());
+}
+
+bool SimulationController::PollTiming(SimulationTiming &timing) noexcept
+{
+    GLuint64 timestamps[c_TimestampsPerFrame];
+    const auto frame = timerQueries_.Poll(timestamps);
+    if (frame < 0)
+        return false;
+
+    timing = pendingTimings_[frame];
+    timing.UploadTime = (double)(timestamps[c_TimestampUploaded] - timestamps[c_TimestampStart]) * 1.0e-9;
+    timing.DispatchTime = (double)(timestamps[c_TimestampEnd] - timestamps[c_TimestampUploaded]) * 1.0e-9;
+
+    // Reduced, full and sliced recalculations all measure the per-cell cost that refinement slices are sized by.
+    const auto time = timing.Backend == SimulationBackend::CPU ? timing.CPUTime : timing.DispatchTime;
+    if (!timing.IsIncremental && time > 0.0)
+        cellsPerSecond_ = (double)timing.Resolution.x * (double)timing.RowCount / time;
+
+    return true;
+}
+
+void SimulationController::PushEmitterDelta(const EmitterInfo &emitterInfo, bool isRemoval)
+{
+    if (!incrementalUpdates_ || emitterDeltas_.size() >= c_MaxEmitterDeltas)
+    {
+        dirtyFlags_ |= SimulationDirtyEmitters;
+        return;
+    }
+
+    auto &delta = emitterDeltas_.emplace_back(emitterInfo);
+    if (isRemoval)
+        delta.EmissionRate = -delta.EmissionRate;
+
+    dirtyFlags_ |= SimulationDirtyEmitterDeltas;
+}
+
+void SimulationController::SetBackend(SimulationBackend backend) noexcept
+{
+    if (backend == backend_)
+        return;
+
+    backend_ = backend;
+    // The other backend runs its own kernel, whose error has not been measured yet.
+    accuracyCheckPending_ = true;
+    dirtyFlags_ = SimulationDirtyAll;
 }
 
 void SimulationController::ResizeTexture(const glm::ivec2& size) noexcept
@@ -105,5 +1058,6 @@ void SimulationController::ResizeTexture(const glm::ivec2& size) noexcept
 
 void SimulationController::ResizeTexture(int width, int height) noexcept
 {
-    outputTexture_ = Texture2D(width, height, c_OutputTextureFormat);
+    outputTexture_ = Texture2D(width, height, GetOutputTextureFormat(config_.OutputFormat));
+    dirtyFlags_ |= SimulationDirtyResolution;
 }
\ No newline at end of file
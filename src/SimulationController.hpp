@@ -1,11 +1,68 @@
 #pragma once
 #include <vector>
+#include <algorithm>
+#include <span>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
 #include <glm/vec2.hpp>
 #include "SimulationConfig.hpp"
 #include "EmitterInfo.hpp"
+#include "EmitterStore.hpp"
 #include "OpenGL/Buffer.hpp"
 #include "OpenGL/Texture.hpp"
 #include "OpenGL/Shader.hpp"
+#include "OpenGL/TimerQuery.hpp"
+#include "CPU/CPUBackend.hpp"
+#include "CPU/EmitterClusters.hpp"
+
+// Per-axis resolution divisor of the recalculations made while the user interacts, see SetInteracting().
+constexpr int c_DefaultInteractiveLODScale = 4;
+// Time a refinement slice may take each frame [s].
+constexpr double c_DefaultRefinementBudget = 0.008;
+
+enum class SimulationBackend
+{
+    GPU,
+    CPU,
+};
+
+enum SimulationDirtyFlags : uint32_t
+{
+    SimulationDirtyNone = 0,
+    SimulationDirtyConfig = 1 << 0,
+    SimulationDirtyEmitters = 1 << 1,
+    SimulationDirtyResolution = 1 << 2,
+    // Only emitterDeltas_ changed, the output can be updated incrementally.
+    SimulationDirtyEmitterDeltas = 1 << 3,
+    SimulationDirtyAll = SimulationDirtyConfig | SimulationDirtyEmitters | SimulationDirtyResolution,
+};
+
+// Cost of a single Calculate call that submitted work. Times are in seconds.
+struct SimulationTiming
+{
+    SimulationBackend Backend;
+    glm::ivec2 Resolution;
+    size_t EmittersCount;
+    // Rows of Resolution that were computed, fewer than Resolution.y for a refinement slice.
+    int RowCount;
+    bool IsIncremental;
+    // Host time spent in Calculate, which for the GPU backend only covers command submission.
+    double CPUTime;
+    // GPU time spent on uploads (config, or the CPU output texture for the CPU backend).
+    double UploadTime;
+    // GPU time spent on the binning and main dispatches, including their barriers.
+    double DispatchTime;
+};
+
+// Output grid delivered by SimulationController::PollReadback().
+struct SimulationReadback
+{
+    glm::ivec2 Resolution;
+    // Format the grid was stored in when it was read back; Values are already decoded from it.
+    ConcentrationFormat Format;
+    std::vector<float> Values;
+};
 
 class SimulationController
 {
@@ -17,27 +74,185 @@ public:
 
     SimulationController& operator=(SimulationController &&other) noexcept;
 
-    void Calculate();
+    // Recomputes the output only if the config, emitters or resolution changed since the last call.
+    // Returns whether any work was submitted.
+    bool Calculate();
     void AddEmitter(EmitterInfo&& emitterInfo);
     void AddEmitter(const glm::vec2 &position, float height, float emissionRate);
+    void UpdateEmitter(size_t emitterIdx, const EmitterInfo &emitterInfo);
     void RemoveEmitter(size_t emitterIdx);
     void ClearEmitters();
-    void SetEmitters(std::vector<EmitterInfo> &&emitters) noexcept { emitters_ = std::move(emitters); }
-    void SetConfig(SimulationConfig &&config) noexcept { config_ = std::move(config); }
+    void SetEmitters(std::span<const EmitterInfo> emitters);
+    void SetConfig(const SimulationConfig &config) noexcept;
     void ResizeTexture(const glm::ivec2& size) noexcept;
     void ResizeTexture(int width, int height) noexcept;
+    void SetBackend(SimulationBackend backend) noexcept;
+    void SetCPUThreadCount(size_t threadCount) { cpuBackend_.SetThreadCount(threadCount); }
+    // Lets emitter edits be added to the previous output instead of recomputing it. Only takes effect while the
+    // output is exact: no culling (CullingThreshold 0) and no cluster approximation (cluster tolerance 0).
+    void SetIncrementalUpdates(bool enabled) noexcept;
+    // Selects between the GPU kernel that stages emitters in shared memory and the one loading them per invocation.
+    void SetSharedEmitterStaging(bool enabled) noexcept;
+    // While the user interacts, full recalculations of large grids run at 1/scale of the resolution per axis
+    // and are refined to full resolution over the following frames once the interaction ends, each
+    // Calculate call computing as many rows as fit in the refinement budget. A scale of 1 disables this.
+    void SetInteracting(bool interacting) noexcept { interacting_ = interacting; }
+    void SetInteractiveLODScale(int scale) noexcept { lodScale_ = std::max(scale, 1); }
+    void SetRefinementBudget(double seconds) noexcept { refinementBudget_ = seconds; }
+    // Relative error per cell allowed for approximating distant emitter clusters by a single pseudo-emitter, see
+    // EmitterClusterTree. 0 evaluates every emitter exactly.
+    void SetClusterTolerance(float tolerance) noexcept;
+    // Relative error per cell allowed for the fast variants of the kernel, see PlumeKernel::SetAccuracyBudget().
+    // The GPU runs the EXP_DEGREE variant of MainCompute.glsl with the same polynomials. 0 keeps the exact kernel.
+    // The next calculation measures the selected variant of the active backend on the current config and emitters
+    // and falls back to more accurate ones while the error exceeds the budget, see CPUBackend::CheckAccuracyBudget().
+    void SetAccuracyBudget(float budget) noexcept;
+    // Computes the rest of a pending refinement at once.
+    void CompleteRefinement();
+    // Copies the current output grid to host memory, reading it back from the GPU if needed. Only covers the
+    // rows refined so far while IsRefining().
+    std::vector<float> ReadOutput() const;
+    // Queues a copy of the current output grid without waiting for the GPU to finish computing it. Returns
+    // false if too many readbacks are still in flight. Like ReadOutput(), only covers the refined rows while
+    // IsRefining().
+    bool RequestReadback();
+    // Retrieves the oldest requested output grid if its copy finished, without waiting. Grids are returned in
+    // request order, also across a backend switch.
+    bool PollReadback(SimulationReadback &readback);
+    // Evaluates the plume sum of the current emitters and config directly at arbitrary positions [m], writing
+    // the value at positions[i] to output[i] without going through the grid. Blocks until the values are ready.
+    void EvaluateReceptors(std::span<const glm::vec2> positions, std::span<float> output);
+    // Rebuilds the compute shaders whose source files changed, and schedules a full recompute if any did.
+    bool ReloadShadersIfChanged();
+    // Retrieves the timing of the oldest Calculate call whose GPU queries finished, without waiting.
+    bool PollTiming(SimulationTiming &timing) noexcept;
 
-    constexpr SimulationConfig& GetConfig() noexcept { return config_; }
-    constexpr std::vector<EmitterInfo>& GetEmitters() noexcept { return emitters_; }
-    constexpr EmitterInfo& GetEmitter(size_t emitterIdx) noexcept { return emitters_.at(emitterIdx); }
-    constexpr size_t GetEmittersCount() const noexcept { return emitters_.size(); }
+    constexpr const SimulationConfig& GetConfig() const noexcept { return config_; }
+    std::vector<EmitterInfo> GetEmitters() const { return emitters_.ToVector(); }
+    EmitterInfo GetEmitter(size_t emitterIdx) const { return emitters_.Get(emitterIdx); }
+    constexpr size_t GetEmittersCount() const noexcept { return emitters_.GetCount(); }
     constexpr const Texture2D& GetOutputTexture() const noexcept { return outputTexture_; }
+    // The reduced-resolution output while a refinement is pending, the output texture otherwise.
+    constexpr const Texture2D& GetDisplayTexture() const noexcept { return isRefining_ ? lodTexture_ : outputTexture_; }
+    // Full-resolution CPU output. Like ReadOutput(), only covers the refined rows while IsRefining().
+    constexpr std::span<const float> GetOutputBuffer() const noexcept { return cpuBackend_.GetOutput(); }
+    constexpr SimulationBackend GetBackend() const noexcept { return backend_; }
+    size_t GetCPUThreadCount() const noexcept { return cpuBackend_.GetThreadCount(); }
+    // Instruction set of the kernel the CPU backend was built with, which may differ from the best supported one.
+    constexpr KernelISA GetCPUKernelISA() const noexcept { return cpuBackend_.GetKernel().GetISA(); }
+    constexpr bool IsDirty() const noexcept { return dirtyFlags_ != SimulationDirtyNone; }
+    constexpr bool GetIncrementalUpdates() const noexcept { return incrementalUpdates_; }
+    constexpr bool GetSharedEmitterStaging() const noexcept { return sharedEmitterStaging_; }
+    constexpr bool HasPendingTimings() const noexcept { return timerQueries_.HasPendingFrames(); }
+    bool HasPendingReadbacks() const noexcept { return !readbacks_.empty(); }
+    constexpr bool IsRefining() const noexcept { return isRefining_; }
+    // Whether the next Calculate() refines a slice: a refinement is pending and no interaction holds it back.
+    constexpr bool CanRefine() const noexcept { return isRefining_ && !interacting_; }
+    constexpr float GetRefinementProgress() const noexcept
+    {
+        return isRefining_ ? (float)refinedRows_ / (float)outputTexture_.GetHeight() : 1.0f;
+    }
+    constexpr int GetInteractiveLODScale() const noexcept { return lodScale_; }
+    constexpr double GetRefinementBudget() const noexcept { return refinementBudget_; }
+    constexpr float GetClusterTolerance() const noexcept { return clusterTolerance_; }
+    constexpr float GetAccuracyBudget() const noexcept { return accuracyBudget_; }
+    // Degree of the exp polynomial the kernel of the active backend kept after checking the budget, 0 for the exact
+    // kernel.
+    constexpr int GetExpDegree() const noexcept
+    {
+        return backend_ == SimulationBackend::CPU ? cpuBackend_.GetKernel().GetExpDegree() : gpuExpDegree_;
+    }
+    // Error of that kernel relative to the exact one, measured by the last check of the budget.
+    constexpr float GetKernelError() const noexcept { return kernelError_; }
 
 private:
+    struct PendingReadback
+    {
+        // Values stay empty until the copy is polled.
+        SimulationReadback Readback;
+        // Ring slot the copy was queued in, or -1 for the CPU output, which is in host memory already.
+        int Slot;
+    };
+
     SimulationConfig config_;
-    std::vector<EmitterInfo> emitters_;
+    EmitterStore emitters_;
     Buffer configBuffer_;
-    Buffer emittersBuffer_;
+    // Holds the packed invariants of either the full emitter list or the pending deltas, rewritten for every
+    // dispatch. See PackEmitterInvariants().
+    RingBuffer emittersBuffer_;
+    Buffer emitterBinCountsBuffer_;
+    Buffer emitterBinsBuffer_;
     Texture2D outputTexture_;
-    Shader computeShader_;
+    // Output of the last recalculation made while interacting, shown until outputTexture_ is refined.
+    Texture2D lodTexture_;
+    // MainCompute.glsl variants specialized for the config, built on first use. See GetComputeShaderVariantKey().
+    std::unordered_map<uint32_t, Shader> computeShaders_;
+    Shader binShader_;
+    Shader receptorShader_;
+    // Sized for the largest receptor query so far.
+    Buffer receptorsBuffer_;
+    Buffer receptorConcentrationsBuffer_;
+    CPUBackend cpuBackend_;
+    // Grid behind lodTexture_ for the CPU backend, kept apart so that the full-resolution output being refined
+    // stays intact.
+    std::vector<float> lodOutput_;
+    // CPU output encoded for upload when the output format is 16-bit.
+    std::vector<uint16_t> packedOutput_;
+    TimestampQueryRing timerQueries_;
+    // Indexed by the query ring frame the timing was recorded in.
+    std::vector<SimulationTiming> pendingTimings_;
+    TextureReadbackRing readbackRing_;
+    // Every requested readback in request order, so that CPU ones do not overtake GPU copies still in flight.
+    std::deque<PendingReadback> readbacks_;
+    SimulationBackend backend_ = SimulationBackend::GPU;
+    uint32_t dirtyFlags_ = SimulationDirtyAll;
+    // Contributions to add to the current output; removed emitters are stored with a negated emission rate.
+    std::vector<EmitterInfo> emitterDeltas_;
+    size_t incrementalUpdatesSinceRebuild_ = 0;
+    bool incrementalUpdates_ = true;
+    bool sharedEmitterStaging_ = true;
+    int lodScale_ = c_DefaultInteractiveLODScale;
+    double refinementBudget_ = c_DefaultRefinementBudget;
+    // Rows of outputTexture_ computed since the last reduced-resolution recalculation.
+    int refinedRows_ = 0;
+    // Built on the first GPU dispatch after the emitters or the config changed.
+    EmitterClusterTree clusters_;
+    // clusters_.GetSources() packed for upload.
+    std::vector<glm::vec4> packedSources_;
+    // Culled sources of each compute tile of a clusterBinsResolution_ grid, selected from clusters_ one tile row at
+    // a time on first use, so that refinement slices and repeated dispatches reuse them until clusters_ is rebuilt.
+    std::vector<std::vector<uint32_t>> clusterBins_;
+    std::vector<uint8_t> clusterBinRowsReady_;
+    glm::ivec2 clusterBinsResolution_ = {0, 0};
+    float clusterTolerance_ = 0.0f;
+    bool clustersStale_ = true;
+    float accuracyBudget_ = 0.0f;
+    // Degree of the exp polynomial of the MainCompute.glsl variant, see CheckAccuracyBudget().
+    int gpuExpDegree_ = 0;
+    float kernelError_ = 0.0f;
+    bool accuracyCheckPending_ = false;
+    // Cost of the kernel for the current emitters, measured by the last completed timing. Sizes refinement slices.
+    double cellsPerSecond_ = 0.0;
+    bool interacting_ = false;
+    bool isRefining_ = false;
+
+    void CalculateGPU();
+    void CalculateCPU();
+    void CalculateLOD();
+    int RefineSlice(int rowCount);
+    int GetRefinementSliceRows() const noexcept;
+    void DispatchGPU(Texture2D &target, int firstTileRow, int tileRowCount);
+    void DispatchGPU(Texture2D &target, int firstTileRow, int tileRowCount, ConcentrationFormat outputFormat, int expDegree);
+    void CalculateIncrementalGPU();
+    void CalculateIncrementalCPU();
+    void CheckAccuracyBudget();
+    // Largest error of the GPU kernel with the exp polynomial of degree `expDegree` relative to the exact one, over a
+    // band of tile rows from the middle of the grid computed with both and read back.
+    float MeasureGPUKernelError(int expDegree);
+    void BindSimulationBuffers();
+    GLuint BinEmittersGPU(const glm::ivec2 &gridSize, int firstTileRow, int tileRowCount);
+    GLuint BinEmitterClustersGPU(const SimulationConfig &config, int firstTileRow, int tileRowCount);
+    Shader& GetComputeShader(const SimulationConfig &config, int expDegree);
+    void PushEmitterDelta(const EmitterInfo &emitterInfo, bool isRemoval);
+    void UploadCPUOutput(Texture2D &target, std::span<const float> grid, int firstRow, int rowCount);
 };
\ No newline at end of file
@@ -0,0 +1,383 @@
+#include "SimulationIO.hpp"
+#include "MappedFile.hpp"
+#include "EmitterTable.hpp"
+#include <bit>
+#include <string>
+#include <filesystem>
+#include <iterator>
+#include <type_traits>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+// Bytes between two progress updates or cancellation checks.
+constexpr size_t c_IOProgressGranularity = 1 << 16;
+constexpr size_t c_EmittersPerProgressUpdate = 4096;
+
+// Byte iterator over the mapped config that publishes how far the parser got.
+class ProgressIterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char*;
+    using reference = const char&;
+
+    ProgressIterator(const char *current, const char *begin, size_t size, IOProgress *progress) noexcept
+        : current_(current), begin_(begin), size_(size), progress_(progress) { }
+
+    reference operator*() const noexcept { return *current_; }
+    ProgressIterator& operator++() noexcept
+    {
+        if ((size_t)(++current_ - begin_) % c_IOProgressGranularity == 0)
+            progress_->Fraction.store((float)(current_ - begin_) / (float)size_, std::memory_order_relaxed);
+        return *this;
+    }
+    ProgressIterator operator++(int) noexcept
+    {
+        auto previous = *this;
+        ++*this;
+        return previous;
+    }
+    bool operator==(const ProgressIterator &other) const noexcept { return current_ == other.current_; }
+
+private:
+    const char *current_;
+    const char *begin_;
+    size_t size_;
+    IOProgress *progress_;
+};
+
+// Streams a simulation config. The "emitters" array is converted into EmitterInfo records as it is parsed;
+// only the few config fields are collected into a DOM and handed to SimulationConfig::FromJSON.
+class SimulationConfigSAXHandler : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+    nlohmann::json ConfigData = nlohmann::json::object();
+    std::vector<EmitterInfo> Emitters;
+    bool HasEmitters = false;
+
+    explicit SimulationConfigSAXHandler(const IOProgress *progress) noexcept
+        : progress_(progress) { }
+
+    bool null() override { return Value(nullptr); }
+    bool boolean(bool value) override { return Value(value); }
+    bool number_integer(number_integer_t value) override { return Number((float)value) && Value(value); }
+    bool number_unsigned(number_unsigned_t value) override { return Number((float)value) && Value(value); }
+    bool number_float(number_float_t value, const string_t&) override { return Number((float)value) && Value(value); }
+    bool string(string_t &value) override { return Value(value); }
+    bool binary(binary_t &value) override { return Value(value); }
+
+    bool start_object(std::size_t) override
+    {
+        depth_++;
+        if (IsInEmitters())
+        {
+            if (depth_ == c_EmitterDepth)
+            {
+                emitter_ = {};
+                emitterFields_ = 0;
+            }
+            return true;
+        }
+
+        return StartContainer(nlohmann::json::object());
+    }
+
+    bool end_object() override
+    {
+        depth_--;
+        if (IsInEmitters())
+        {
+            if (depth_ == c_EmittersDepth)
+            {
+                if (emitterFields_ != c_AllEmitterFields)
+                    throw std::runtime_error(std::format("Emitter {} is missing a required field.", Emitters.size()));
+                Emitters.emplace_back(emitter_);
+
+                // Returning false stops the parser.
+                if (progress_ && Emitters.size() % c_EmittersPerProgressUpdate == 0)
+                    return !progress_->CancelRequested.load(std::memory_order_relaxed);
+            }
+            return true;
+        }
+
+        return EndContainer();
+    }
+
+    bool start_array(std::size_t) override
+    {
+        depth_++;
+        if (depth_ == c_EmittersDepth && key_ == "emitters")
+        {
+            emittersOpen_ = true;
+            HasEmitters = true;
+            return true;
+        }
+        if (IsInEmitters())
+        {
+            if (depth_ == c_EmitterDepth)
+                throw std::runtime_error(std::format("Emitter {} is not an object.", Emitters.size()));
+            if (depth_ == c_EmitterDepth + 1 && field_ == EmitterField::Position)
+                positionIdx_ = 0;
+            return true;
+        }
+
+        return StartContainer(nlohmann::json::array());
+    }
+
+    bool end_array() override
+    {
+        depth_--;
+        if (IsInEmitters())
+        {
+            if (depth_ == c_EmittersDepth - 1)
+                emittersOpen_ = false;
+            return true;
+        }
+
+        return EndContainer();
+    }
+
+    bool key(string_t &value) override
+    {
+        if (IsInEmitters())
+        {
+            if (depth_ == c_EmitterDepth)
+                field_ = value == "position" ? EmitterField::Position
+                    : value == "emissionRate" ? EmitterField::EmissionRate
+                    : value == "height" ? EmitterField::Height
+                    : EmitterField::Unknown;
+            return true;
+        }
+
+        key_ = value;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception &e) override
+    {
+        throw std::runtime_error(std::format("Failed to parse simulation config at byte {}: {}", position, e.what()));
+    }
+
+private:
+    enum class EmitterField
+    {
+        Unknown,
+        Position,
+        EmissionRate,
+        Height,
+    };
+
+    static constexpr int c_EmittersDepth = 2;
+    static constexpr int c_EmitterDepth = 3;
+    static constexpr uint32_t c_AllEmitterFields = 0b1111;
+
+    const IOProgress *progress_;
+    std::vector<nlohmann::json*> domStack_;
+    std::string key_;
+    EmitterInfo emitter_{};
+    uint32_t emitterFields_ = 0;
+    EmitterField field_ = EmitterField::Unknown;
+    int positionIdx_ = 0;
+    int depth_ = 0;
+    bool emittersOpen_ = false;
+
+    constexpr bool IsInEmitters() const noexcept { return emittersOpen_; }
+
+    bool Number(float value)
+    {
+        if (!IsInEmitters())
+            return true;
+
+        if (depth_ == c_EmitterDepth + 1 && field_ == EmitterField::Position && positionIdx_ < 2)
+        {
+            emitter_.Position[positionIdx_] = value;
+            emitterFields_ |= 1u << positionIdx_++;
+        }
+        else if (depth_ == c_EmitterDepth && field_ == EmitterField::EmissionRate)
+        {
+            emitter_.EmissionRate = value;
+            emitterFields_ |= 1u << 2;
+        }
+        else if (depth_ == c_EmitterDepth && field_ == EmitterField::Height)
+        {
+            emitter_.Height = value;
+            emitterFields_ |= 1u << 3;
+        }
+
+        return true;
+    }
+
+    template<typename T>
+    bool Value(T &&value)
+    {
+        if (IsInEmitters())
+        {
+            if (depth_ == c_EmittersDepth)
+                throw std::runtime_error(std::format("Emitter {} is not an object.", Emitters.size()));
+            if (depth_ >= c_EmitterDepth && field_ != EmitterField::Unknown && !std::is_arithmetic_v<std::remove_cvref_t<T>>)
+                throw std::runtime_error(std::format("Emitter {} has a non-numeric field.", Emitters.size()));
+            return true;
+        }
+
+        AddValue(nlohmann::json(std::forward<T>(value)));
+        return true;
+    }
+
+    nlohmann::json* AddValue(nlohmann::json &&value)
+    {
+        if (domStack_.empty())
+            return &ConfigData;
+
+        auto &parent = *domStack_.back();
+        if (parent.is_array())
+        {
+            parent.push_back(std::move(value));
+            return &parent.back();
+        }
+
+        return &(parent[key_] = std::move(value));
+    }
+
+    bool StartContainer(nlohmann::json &&container)
+    {
+        domStack_.push_back(domStack_.empty() ? &ConfigData : AddValue(std::move(container)));
+        return true;
+    }
+
+    bool EndContainer()
+    {
+        domStack_.pop_back();
+        return true;
+    }
+};
+
+std::pair<SimulationConfig, std::vector<EmitterInfo>> LoadSimulationConfigFromFile(
+    const std::string_view filepath,
+    IOProgress *progress)
+{
+    const std::filesystem::path path(filepath);
+    if (!std::filesystem::is_regular_file(path))
+        throw std::runtime_error("Failed to open simulation config file.");
+
+    if (std::filesystem::file_size(path) == 0)
+        throw std::runtime_error("Simulation config file is empty.");
+
+    SimulationConfigSAXHandler handler(progress);
+    {
+        const MappedFile file(path);
+        const auto view = file.Map(0, (size_t)file.GetSize());
+        const auto *data = reinterpret_cast<const char*>(view.GetData());
+        const auto size = view.GetSize();
+
+        if (!progress)
+            nlohmann::json::sax_parse(data, data + size, &handler);
+        else if (!nlohmann::json::sax_parse(
+            ProgressIterator(data, data, size, progress),
+            ProgressIterator(data + size, data, size, progress),
+            &handler))
+            throw IOCanceledError();
+    }
+
+    auto &configData = handler.ConfigData;
+    auto emitters = std::move(handler.Emitters);
+    if (configData.contains("emitterTable"))
+    {
+        // Relative table paths are resolved against the config file.
+        const auto tablePath = path.parent_path() / configData.at("emitterTable").get<std::string>();
+        const EmitterTable table(tablePath);
+        emitters.insert(emitters.end(), table.GetEmitters().begin(), table.GetEmitters().end());
+    }
+    else if (!handler.HasEmitters)
+        configData.at("emitters");
+
+    if (progress)
+        progress->Fraction = 1.0f;
+
+    return std::make_pair(SimulationConfig::FromJSON(configData), std::move(emitters));
+}
+
+void SaveSimulationConfigToFile(
+    const std::string_view filepath,
+    const SimulationConfig &config,
+    const std::vector<EmitterInfo> &emitters,
+    IOProgress *progress)
+{
+    const std::filesystem::path path(filepath);
+    auto temporaryPath = path;
+    temporaryPath += ".tmp";
+
+    {
+        std::ofstream file(temporaryPath);
+        if (!file.is_open())
+            throw std::runtime_error("Failed to open simulation config save file.");
+
+        // The emitters are written one by one instead of through a DOM of the whole inventory.
+        auto configData = config.ToJSON().dump();
+        configData.pop_back();
+        file << configData << (configData.size() > 1 ? ",\"emitters\":[" : "\"emitters\":[");
+
+        for (size_t i = 0; i < emitters.size(); i++)
+        {
+            if (progress && i % c_EmittersPerProgressUpdate == 0)
+            {
+                if (progress->CancelRequested.load(std::memory_order_relaxed))
+                {
+                    file.close();
+                    std::filesystem::remove(temporaryPath);
+                    throw IOCanceledError();
+                }
+                progress->Fraction.store((float)i / (float)emitters.size(), std::memory_order_relaxed);
+            }
+
+            if (i > 0)
+                file << ',';
+            file << emitters[i].ToJSON();
+        }
+        file << "]}";
+
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(temporaryPath);
+            throw std::runtime_error("Failed to write simulation config.");
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, path);
+    if (progress)
+        progress->Fraction = 1.0f;
+}
+
+void SaveConcentrationGridToFile(const std::string_view filepath, std::span<const float> grid, const glm::ivec2 &resolution)
+{
+    if (grid.size() < (size_t)resolution.x * (size_t)resolution.y)
+        throw std::out_of_range("Concentration grid is smaller than its resolution.");
+
+    std::ofstream file(filepath.data(), std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open concentration grid save file.");
+
+    file << GetConcentrationGridHeader(resolution);
+    file.write(reinterpret_cast<const char*>(grid.data()), (std::streamsize)(sizeof(float) * resolution.x * resolution.y));
+
+    if (!file)
+        throw std::runtime_error("Failed to write concentration grid.");
+}
+
+std::string GetConcentrationGridHeader(const glm::ivec2 &resolution)
+{
+    // A negative scale marks little-endian samples. PFM stores rows bottom to top, which matches the
+    // grid's Y axis pointing up.
+    const auto scale = std::endian::native == std::endian::little ? -1.0f : 1.0f;
+    const auto dimensions = std::format("Pf\n{} {}\n", resolution.x, resolution.y);
+
+    // Pads the scale with trailing zeros so the samples start float-aligned, which lets
+    // CPUBackend::CalculateToFile write them through a mapped view of the file.
+    const auto unpaddedSize = dimensions.size() + std::format("{:.1f}\n", scale).size();
+    const auto padding = (sizeof(float) - unpaddedSize % sizeof(float)) % sizeof(float);
+    return dimensions + std::format("{:.{}f}\n", scale, 1 + padding);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <utility>
+#include <stdexcept>
+#include <string_view>
+#include <glm/vec2.hpp>
+#include "SimulationConfig.hpp"
+#include "EmitterInfo.hpp"
+
+// Progress and cancellation of a load or save running on another thread.
+struct IOProgress
+{
+    std::atomic<float> Fraction = 0.0f;
+    std::atomic<bool> CancelRequested = false;
+};
+
+// Thrown by an operation whose IOProgress::CancelRequested was set.
+class IOCanceledError : public std::runtime_error
+{
+public:
+    IOCanceledError()
+        : std::runtime_error("Operation canceled.") { }
+};
+
+std::pair<SimulationConfig, std::vector<EmitterInfo>> LoadSimulationConfigFromFile(
+    const std::string_view filepath,
+    IOProgress *progress = nullptr);
+// Writes to a temporary file that replaces `filepath` only once complete, so a failed or canceled save
+// leaves the previous file intact.
+void SaveSimulationConfigToFile(
+    const std::string_view filepath,
+    const SimulationConfig &config,
+    const std::vector<EmitterInfo> &emitters,
+    IOProgress *progress = nullptr);
+
+// Writes a row-major R32F grid as a Portable Float Map, readable by most image and GIS tools.
+void SaveConcentrationGridToFile(const std::string_view filepath, std::span<const float> grid, const glm::ivec2 &resolution);
+// Header of the Portable Float Map written by SaveConcentrationGridToFile; the samples follow it directly.
+// Its size is a multiple of sizeof(float).
+std::string GetConcentrationGridHeader(const glm::ivec2 &resolution);
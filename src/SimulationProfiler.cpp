@@ -0,0 +1,66 @@
+#include "SimulationProfiler.hpp"
+#include <cmath>
+#include <vector>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+SimulationProfiler::SimulationProfiler(size_t historySize)
+    : historySize_(historySize)
+{
+}
+
+void SimulationProfiler::Push(const SimulationTiming &timing)
+{
+    if (history_.size() >= historySize_)
+        history_.pop_front();
+
+    history_.push_back(timing);
+}
+
+void SimulationProfiler::Clear() noexcept
+{
+    history_.clear();
+}
+
+TimingStats SimulationProfiler::GetStats(double SimulationTiming::*time) const
+{
+    if (history_.empty())
+        return {};
+
+    std::vector<double> samples;
+    samples.reserve(history_.size());
+    for (const auto &timing : history_)
+        samples.push_back(timing.*time);
+
+    // Nearest-rank percentile.
+    const auto p99Idx = (size_t)std::ceil(0.99 * (double)samples.size()) - 1;
+    std::nth_element(samples.begin(), samples.begin() + p99Idx, samples.end());
+
+    return {
+        .Min = *std::min_element(samples.begin(), samples.end()),
+        .Mean = std::accumulate(samples.begin(), samples.end(), 0.0) / (double)samples.size(),
+        .P99 = samples[p99Idx],
+    };
+}
+
+void SimulationProfiler::SaveToCSV(const std::string_view filepath) const
+{
+    std::ofstream file(filepath.data());
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open profiling output file.");
+
+    file << "backend,resolution_x,resolution_y,rows,emitters,incremental,cpu_ms,upload_ms,dispatch_ms\n";
+    for (const auto &timing : history_)
+    {
+        file << (timing.Backend == SimulationBackend::CPU ? "cpu" : "gpu") << ','
+            << timing.Resolution.x << ',' << timing.Resolution.y << ','
+            << timing.RowCount << ','
+            << timing.EmittersCount << ','
+            << (timing.IsIncremental ? 1 : 0) << ','
+            << timing.CPUTime * 1.0e3 << ','
+            << timing.UploadTime * 1.0e3 << ','
+            << timing.DispatchTime * 1.0e3 << '\n';
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <deque>
+#include <string_view>
+#include "SimulationController.hpp"
+
+struct TimingStats
+{
+    double Min;
+    double Mean;
+    double P99;
+};
+
+// Rolling history of simulation timings, used to compare kernel cost across grid sizes and emitter counts.
+class SimulationProfiler
+{
+public:
+    SimulationProfiler(size_t historySize = 512);
+
+    void Push(const SimulationTiming &timing);
+    void Clear() noexcept;
+    TimingStats GetStats(double SimulationTiming::*time) const;
+    void SaveToCSV(const std::string_view filepath) const;
+
+    constexpr const std::deque<SimulationTiming>& GetHistory() const noexcept { return history_; }
+    constexpr size_t GetHistorySize() const noexcept { return historySize_; }
+private:
+    std::deque<SimulationTiming> history_;
+    size_t historySize_;
+};
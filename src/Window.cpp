@@ -64,6 +64,16 @@ void Window::PollEvents() const noexcept
     glfwPollEvents();
 }
 
+void Window::WaitEvents() const noexcept
+{
+    glfwWaitEvents();
+}
+
+void Window::WaitEvents(double timeout) const noexcept
+{
+    glfwWaitEventsTimeout(timeout);
+}
+
 void Window::SwapBuffers() const noexcept
 {
     glfwSwapBuffers(window_);
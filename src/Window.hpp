@@ -17,6 +17,8 @@ public:
 
     bool ShouldClose() const noexcept;
     void PollEvents() const noexcept;
+    void WaitEvents() const noexcept;
+    void WaitEvents(double timeout) const noexcept;
     void SwapBuffers() const noexcept;
     void Close() const noexcept;
 